@@ -0,0 +1,152 @@
+#include "FrameCapture.h"
+#include <Urho3D/Urho3DAll.h>
+#include <cstdio>
+#ifdef URHO3D_OPENGL
+#include <Urho3D/Graphics/OpenGL/OGLTextureReadback.h>
+#endif
+
+namespace Urho3D
+{
+	struct EncodeJob
+	{
+		FrameCapture* owner;
+		SharedPtr<Image> image;
+		String fileName;
+		CaptureFormat format;
+	};
+
+	/*runs on a worker thread; must not copy the image SharedPtr, reference counts are not atomic*/
+	static void EncodeWork(const WorkItem* item, unsigned threadIndex)
+	{
+		EncodeJob* job = static_cast<EncodeJob*>(item->aux_);
+		Image* image = job->image.Get();
+		if (job->format == CAPTURE_PNG)
+		{
+			image->SavePNG(job->fileName);
+			return;
+		}
+
+		File file(image->GetContext(), job->fileName, FILE_WRITE);
+		if (!file.IsOpen())
+			return;
+		file.WriteUInt((unsigned)image->GetWidth());
+		file.WriteUInt((unsigned)image->GetHeight());
+		file.WriteUInt(image->GetComponents());
+		file.Write(image->GetData(), (unsigned)(image->GetWidth() * image->GetHeight()) * image->GetComponents());
+	}
+
+	FrameCapture::FrameCapture(Context* context) : Object(context)
+	{
+#ifdef URHO3D_OPENGL
+		readback_ = MakeShared<TextureReadback>(context);
+#endif
+		SubscribeToEvent(E_BEGINRENDERING, URHO3D_HANDLER(FrameCapture, HandleBeginRendering));
+		SubscribeToEvent(E_WORKITEMCOMPLETED, URHO3D_HANDLER(FrameCapture, HandleWorkItemCompleted));
+	}
+
+	FrameCapture::~FrameCapture()
+	{
+		/*finish encodes still using our images. Complete() sends their E_WORKITEMCOMPLETED right away, while we are
+		still subscribed, so HandleWorkItemCompleted frees them; the subscription ends with this object, so whatever
+		is left in jobs_ is freed here*/
+		if (jobs_.Empty())
+			return;
+		GetSubsystem<WorkQueue>()->Complete(0);
+		for (unsigned i = 0; i < jobs_.Size(); ++i)
+			delete static_cast<EncodeJob*>(jobs_[i]);
+	}
+
+	void FrameCapture::TakeScreenshot(const String& fileName, CaptureFormat format)
+	{
+		Capture(fileName, format);
+	}
+
+	void FrameCapture::StartSequence(const String& directory, CaptureFormat format)
+	{
+		directory_ = AddTrailingSlash(directory);
+		GetSubsystem<FileSystem>()->CreateDir(directory_);
+		format_ = format;
+		frameNumber_ = 0;
+		numCaptured_ = 0;
+		numDropped_ = 0;
+		capturing_ = true;
+	}
+
+	void FrameCapture::StopSequence()
+	{
+		if (!capturing_)
+			return;
+		capturing_ = false;
+		URHO3D_LOGINFO("Frame capture stopped: " + String(frameNumber_) + " frames, " + String(numDropped_) + " dropped");
+	}
+
+	void FrameCapture::Capture(const String& fileName, CaptureFormat format)
+	{
+#ifdef URHO3D_OPENGL
+		/*readback_ is owned by this object, so the callback cannot outlive it*/
+		unsigned id = readback_->RequestBackbuffer([this, fileName, format](Image* image)
+		{
+			--numReadbacks_;
+			if (image)
+				Encode(image, fileName, format);
+			else
+				++numDropped_;
+		});
+		if (id)
+			++numReadbacks_;
+#else
+		SharedPtr<Image> image(new Image(context_));
+		if (GetSubsystem<Graphics>()->TakeScreenShot(*image))
+			Encode(image, fileName, format);
+#endif
+	}
+
+	void FrameCapture::Encode(Image* image, const String& fileName, CaptureFormat format)
+	{
+		EncodeJob* job = new EncodeJob();
+		job->owner = this;
+		job->image = image;
+		job->fileName = fileName;
+		job->format = format;
+
+		auto* queue = GetSubsystem<WorkQueue>();
+		SharedPtr<WorkItem> item = queue->GetFreeItem();
+		item->priority_ = 0;
+		item->workFunction_ = EncodeWork;
+		item->aux_ = job;
+		item->sendEvent_ = true;
+		++numEncodes_;
+		jobs_.Push(job);
+		queue->AddWorkItem(item);
+	}
+
+	void FrameCapture::HandleBeginRendering(StringHash eventType, VariantMap& eventData)
+	{
+		if (!capturing_)
+			return;
+
+		/*String formatting has no field widths*/
+		char name[32];
+		snprintf(name, sizeof(name), "frame_%06u", frameNumber_++);
+		String fileName = directory_ + name + (format_ == CAPTURE_PNG ? ".png" : ".raw");
+		if (GetNumPending() >= maxPendingEncodes)
+		{
+			++numDropped_;
+			return;
+		}
+		Capture(fileName, format_);
+	}
+
+	void FrameCapture::HandleWorkItemCompleted(StringHash eventType, VariantMap& eventData)
+	{
+		auto* item = static_cast<WorkItem*>(eventData[WorkItemCompleted::P_ITEM].GetPtr());
+		if (item->workFunction_ != EncodeWork || static_cast<EncodeJob*>(item->aux_)->owner != this)
+			return;
+
+		jobs_.Remove(item->aux_);
+		delete static_cast<EncodeJob*>(item->aux_);
+		item->aux_ = nullptr;
+		--numEncodes_;
+		++numCaptured_;
+	}
+}
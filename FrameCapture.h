@@ -0,0 +1,60 @@
+#pragma once
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Resource/Image.h>
+
+namespace Urho3D
+{
+	class TextureReadback;
+
+	enum CaptureFormat
+	{
+		CAPTURE_PNG = 0,
+		CAPTURE_RAW
+	};
+
+	/*
+	Screenshots and frame sequences without stalling the render loop: the backbuffer is read through
+	TextureReadback (pixel pack buffers, results arrive a frame or two later) and encoding runs on
+	WorkQueue threads. When the encode queue is full, frames are dropped instead of waiting.
+	Without OpenGL the blocking Graphics::TakeScreenShot is used, but encoding is still off-thread.
+	*/
+	class FrameCapture : public Object
+	{
+		URHO3D_OBJECT(FrameCapture, Object);
+	public:
+		explicit FrameCapture(Context* context);
+		~FrameCapture();
+
+		/*capture the current frame to a file*/
+		void TakeScreenshot(const String& fileName, CaptureFormat format = CAPTURE_PNG);
+		/*capture every frame to directory/frame_NNNNNN.png|raw until StopSequence*/
+		void StartSequence(const String& directory, CaptureFormat format = CAPTURE_PNG);
+		void StopSequence();
+		bool IsCapturingSequence() const { return capturing_; }
+
+		/*frames waiting for readback or encoding*/
+		unsigned GetNumPending() const { return numReadbacks_ + numEncodes_; }
+		unsigned GetNumCaptured() const { return numCaptured_; }
+		unsigned GetNumDropped() const { return numDropped_; }
+
+		/*bounded encode queue; frames beyond it are dropped*/
+		unsigned maxPendingEncodes{ 8 };
+
+	private:
+		void Capture(const String& fileName, CaptureFormat format);
+		void Encode(Image* image, const String& fileName, CaptureFormat format);
+		void HandleBeginRendering(StringHash eventType, VariantMap& eventData);
+		void HandleWorkItemCompleted(StringHash eventType, VariantMap& eventData);
+
+		SharedPtr<TextureReadback> readback_;
+		PODVector<void*> jobs_;
+		bool capturing_{ false };
+		String directory_;
+		CaptureFormat format_{ CAPTURE_PNG };
+		unsigned frameNumber_{ 0 };
+		unsigned numReadbacks_{ 0 };
+		unsigned numEncodes_{ 0 };
+		unsigned numCaptured_{ 0 };
+		unsigned numDropped_{ 0 };
+	};
+}
@@ -0,0 +1,96 @@
+#include "GraphicsStats.h"
+#include <Urho3D/Urho3DAll.h>
+#ifdef URHO3D_OPENGL
+#include <Urho3D/Graphics/OpenGL/OGLGPUTimer.h>
+#include <Urho3D/Graphics/OpenGL/OGLGraphicsStats.h>
+#include <Urho3D/Graphics/OpenGL/OGLUniformRing.h>
+#include <Urho3D/Graphics/OpenGL/OGLVertexArrayCache.h>
+#endif
+
+namespace Urho3D
+{
+	GraphicsStats::GraphicsStats(Context* context) : Object(context)
+	{
+		SubscribeToEvent(E_BEGINRENDERING, URHO3D_HANDLER(GraphicsStats, HandleBeginRendering));
+		SubscribeToEvent(E_ENDRENDERING, URHO3D_HANDLER(GraphicsStats, HandleEndRendering));
+	}
+
+	bool GraphicsStats::StartLog(const String& fileName)
+	{
+		StopLog();
+		SharedPtr<File> file(new File(context_, fileName, FILE_WRITE));
+		if (!file->IsOpen())
+		{
+			URHO3D_LOGERROR("Could not open graphics stats log " + fileName);
+			return false;
+		}
+		log_ = file;
+		numLogged_ = 0;
+		return true;
+	}
+
+	void GraphicsStats::StopLog()
+	{
+		if (!log_)
+			return;
+		log_->Close();
+		log_.Reset();
+		URHO3D_LOGINFO("Graphics stats log stopped: " + String(numLogged_) + " frames");
+	}
+
+	void GraphicsStats::HandleEndRendering(StringHash eventType, VariantMap& eventData)
+	{
+		auto* graphics = GetSubsystem<Graphics>();
+		batches_ = graphics->GetNumBatches();
+		primitives_ = graphics->GetNumPrimitives();
+		renderUs_ = renderTimer_.GetUSec(false);
+	}
+
+	/*E_BEGINRENDERING comes after Graphics::BeginFrame has taken over the counters of the previous frame*/
+	void GraphicsStats::HandleBeginRendering(StringHash eventType, VariantMap& eventData)
+	{
+		const long long renderUs = renderUs_;
+		renderTimer_.Reset();
+		if (!frameNumber_++)
+			return;
+#ifdef URHO3D_OPENGL
+		const GraphicsFrameStats& stats = GetGraphicsFrameStats();
+		auto* hud = GetSubsystem<DebugHud>();
+		if (showInHud && hud)
+		{
+			hud->SetAppStats("State changes", ToString("%u shaders, %u textures, %u FBOs, %u blend, %u depth, %u cull",
+				stats.shaderChanges_, stats.textureBinds_, stats.framebufferBinds_, stats.blendChanges_, stats.depthChanges_,
+				stats.cullChanges_));
+			hud->SetAppStats("Upload bytes", ToString("%u uniform, %u constant buffer, %u vertex/index buffer", stats.uniformBytes_,
+				stats.constantBufferBytes_, stats.bufferUploadBytes_));
+			/*a few frames old, the GPU timer reads its queries only once they are available*/
+			auto* gpuTimer = GetSubsystem<GPUTimer>();
+			if (gpuTimer && gpuTimer->IsSupported())
+				hud->SetAppStats("GPU time", "\n" + gpuTimer->PrintData());
+		}
+#endif
+
+		if (!log_)
+			return;
+#ifdef URHO3D_OPENGL
+		const UniformRingStats& ring = GetUniformRingStats();
+		const VertexArrayStats& vao = GetVertexArrayStats();
+		log_->WriteLine(ToString("{\"frame\":%u,\"renderUs\":%lld,\"batches\":%u,\"primitives\":%u,\"shaderChanges\":%u,"
+			"\"textureBinds\":%u,\"framebufferBinds\":%u,\"blendChanges\":%u,\"depthChanges\":%u,\"cullChanges\":%u,"
+			"\"uniformBytes\":%u,\"constantBufferBytes\":%u,\"bufferUploadBytes\":%u,\"ringCopies\":%u,\"ringBinds\":%u,"
+			"\"ringSlotChecks\":%u,\"attributeCalls\":%u,\"vaoBinds\":%u,\"vaoHits\":%u,\"vaoCreated\":%u}", frameNumber_ - 1, renderUs, stats.batches_, stats.primitives_, stats.shaderChanges_,
+			stats.textureBinds_, stats.framebufferBinds_, stats.blendChanges_, stats.depthChanges_, stats.cullChanges_,
+			stats.uniformBytes_, stats.constantBufferBytes_, stats.bufferUploadBytes_, ring.copies_, ring.rangeBinds_,
+			ring.slotChecks_, vao.attributeCalls_, vao.vaoBinds_, vao.cacheHits_, vao.vaoCreated_));
+#else
+		log_->WriteLine(ToString("{\"frame\":%u,\"renderUs\":%lld,\"batches\":%u,\"primitives\":%u}", frameNumber_ - 1,
+			renderUs, batches_, primitives_));
+#endif
+		++numLogged_;
+		if (exitAfterFrames && numLogged_ >= exitAfterFrames)
+		{
+			StopLog();
+			GetSubsystem<Engine>()->Exit();
+		}
+	}
+}
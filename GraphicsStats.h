@@ -0,0 +1,45 @@
+#pragma once
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/File.h>
+
+namespace Urho3D
+{
+	/*
+	Per-frame renderer counters (state changes, uniform and buffer bytes) on the DebugHud, and optionally one JSON
+	object per frame and line in a file, for comparing runs e.g. in CI. The counters are of the last finished frame;
+	they come from OGLGraphicsStats.h, OGLUniformRing.h and OGLVertexArrayCache.h, so without OpenGL only batches, primitives and the CPU
+	time spent rendering are known. GPU times of the GPUTimer subsystem are shown as well when it is registered.
+	*/
+	class GraphicsStats : public Object
+	{
+		URHO3D_OBJECT(GraphicsStats, Object);
+	public:
+		explicit GraphicsStats(Context* context);
+
+		/*write every frame to fileName until StopLog; an existing file is replaced*/
+		bool StartLog(const String& fileName);
+		void StopLog();
+		bool IsLogging() const { return log_ != nullptr; }
+		unsigned GetNumLogged() const { return numLogged_; }
+
+		/*show the counters as DebugHud app stats*/
+		bool showInHud{ true };
+		/*stop the engine after this many logged frames, 0 runs until closed*/
+		unsigned exitAfterFrames{ 0 };
+
+	private:
+		void HandleBeginRendering(StringHash eventType, VariantMap& eventData);
+		void HandleEndRendering(StringHash eventType, VariantMap& eventData);
+
+		SharedPtr<File> log_;
+		unsigned frameNumber_{ 0 };
+		unsigned numLogged_{ 0 };
+		/*batches and primitives of the frame just rendered, for builds without the OpenGL counters*/
+		unsigned batches_{ 0 };
+		unsigned primitives_{ 0 };
+		/*CPU time from E_BEGINRENDERING to E_ENDRENDERING of that frame: culling, batching and GL calls, no present*/
+		HiresTimer renderTimer_;
+		long long renderUs_{ 0 };
+	};
+}
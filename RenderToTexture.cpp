@@ -20,9 +20,16 @@
 // THE SOFTWARE.
 //
 
+#include <cstdio>
 #include <random>
 #include <Urho3D/Urho3DAll.h>
 #include "RenderToTexture.h"
+#ifdef URHO3D_OPENGL
+#include <Urho3D/Graphics/OpenGL/OGLGPUTimer.h>
+#include <Urho3D/Graphics/OpenGL/OGLProgramBinaryCache.h>
+#include <Urho3D/Graphics/OpenGL/OGLVertexArrayCache.h>
+#include <Urho3D/Graphics/OpenGL/OGLUniformRing.h>
+#endif
 
 static unsigned int generate_random_seed()
 {
@@ -52,6 +59,42 @@ static void addDebugArrow(Urho3D::DebugRenderer * r, const Urho3D::Vector3 &from
 	r->AddLine(to, flip_p - v_expand * degree * arrow_len, color, true);
 }
 
+/*-benchrng: SpaceRandom against the engine's Random(), in nanoseconds per value / per unit vector*/
+static void benchmarkRandom(unsigned count)
+{
+	PODVector<float> values(count);
+	PODVector<Urho3D::Vector3> vectors(count);
+	SpaceRandom rng(1);
+	float sum = 0.0f;
+	Urho3D::HiresTimer timer;
+
+	for (unsigned i = 0; i < count; ++i)
+		sum += Random();
+	const long long engineScalar = timer.GetUSec(true);
+	for (unsigned i = 0; i < count; ++i)
+		sum += rng.Next();
+	const long long scalar = timer.GetUSec(true);
+	rng.FillUniform(&values[0], count);
+	const long long batch = timer.GetUSec(true);
+
+	for (unsigned i = 0; i < count; ++i)
+	{
+		vectors[i] = Urho3D::Vector3(Random(-1.0f, 1.0f), Random(-1.0f, 1.0f), Random(-1.0f, 1.0f));
+		vectors[i].Normalize();
+	}
+	const long long engineVectors = timer.GetUSec(true);
+	rng.FillUnitVectors(&vectors[0], count);
+	const long long batchVectors = timer.GetUSec(true);
+	sum += values[count - 1] + vectors[count - 1].x_;
+
+	const double ns = 1000.0 / count;
+	char text[256];
+	snprintf(text, sizeof(text), "benchrng %u values: Random() %.2f ns, Next() %.2f ns, FillUniform %.2f ns; "
+		"unit vectors: Random() %.2f ns, FillUnitVectors %.2f ns (checksum %g)", count, engineScalar * ns, scalar * ns,
+		batch * ns, engineVectors * ns, batchVectors * ns, sum);
+	URHO3D_LOGINFO(text);
+}
+
 static const StringHash TEXTURECUBE_SIZE("TEXTURECUBE SIZE");
 static const Vector3 default_light_dir(0.5f, -1.0f, 0.5f);
 static const Color default_light_color(0.2f, 0.2f, 0.2f);
@@ -75,6 +118,13 @@ void RenderToTexture::Start()
     // Execute base class startup
     Sample::Start();
 
+#ifdef URHO3D_OPENGL
+	/*linked shader programs are kept for the next run*/
+	context_->RegisterSubsystem(new ProgramBinaryCache(context_, GetSubsystem<FileSystem>()->GetProgramDir() + "Data/ProgramCache"));
+	/*GPU times of the SpaceBox.xml passes and URHO3D_PROFILE_GPU scopes, on the DebugHud next to the profiler*/
+	context_->RegisterSubsystem(new GPUTimer(context_));
+#endif
+
     // Create the scene content
     CreateScene();
 
@@ -87,6 +137,35 @@ void RenderToTexture::Start()
     // Hook up to the frame update events
     SubscribeToEvents();
 
+	capture = MakeShared<FrameCapture>(context_);
+	stats = MakeShared<GraphicsStats>(context_);
+	/*-statslog <file> writes the renderer counters of every frame, -statsframes <n> exits after n of them,
+	-gputrace <file> writes the GPU times as a Chrome trace, -vaocache 0 starts without the vertex array object cache,
+	-benchrng <n> times n random values, -cachecheck <directory> saves and reloads a sky in every mapping, then exits*/
+	const Vector<String>& arguments = GetArguments();
+	for (unsigned i = 0; i + 1 < arguments.Size(); ++i)
+	{
+		if (arguments[i] == "-statslog")
+			stats->StartLog(arguments[i + 1]);
+		else if (arguments[i] == "-statsframes")
+			stats->exitAfterFrames = ToUInt(arguments[i + 1]);
+		else if (arguments[i] == "-benchrng")
+			benchmarkRandom(Max(ToUInt(arguments[i + 1]), 1u));
+		else if (arguments[i] == "-cachecheck")
+		{
+			/*the check drives the generator itself*/
+			scheduler->Cancel(gen);
+			cacheCheck = MakeShared<SpaceBoxCacheCheck>(context_, gen);
+			cacheCheck->Start(arguments[i + 1]);
+		}
+#ifdef URHO3D_OPENGL
+		else if (arguments[i] == "-gputrace")
+			GetSubsystem<GPUTimer>()->StartTrace(arguments[i + 1]);
+		else if (arguments[i] == "-vaocache")
+			SetVertexArrayCacheEnabled(ToBool(arguments[i + 1]));
+#endif
+	}
+
     // Set the mouse mode to use in the sample
     Sample::InitMouseMode(MM_RELATIVE);
 }
@@ -149,18 +228,21 @@ void RenderToTexture::CreateScene()
 			// illusion of the box planes being far away. Use just the ordinary Box model and a suitable material, whose shader will
 			// generate the necessary 3D texture coordinates for cube mapping
 			SubscribeToEvent(E_SPACEBOXGEN, URHO3D_HANDLER(RenderToTexture, ChangeLight));
+			SubscribeToEvent(E_SPACEBOXREADY, URHO3D_HANDLER(RenderToTexture, SwapSpaceBox));
 			Node * space = scene_->CreateChild("Space Box");
 			space->SetScale(500.0f); // The scale actually does not matter
 			auto* spacebox = space->CreateComponent<Skybox>();
 			spacebox->SetModel(cache->GetResource<Model>("Models/Box.mdl"));
-			SharedPtr<Material> space_mat = MakeShared<Material>(GetContext());
-			space_mat->SetCullMode(CULL_NONE);
-			space_mat->SetNumTechniques(1);
-			space_mat->SetTechnique(0, cache->GetResource<Technique>("Techniques/DiffSkybox.xml"), QUALITY_MAX);
+			spaceMat = MakeShared<Material>(GetContext());
+			spaceMat->SetCullMode(CULL_NONE);
+			spaceMat->SetNumTechniques(1);
+			spaceMat->SetTechnique(0, cache->GetResource<Technique>("Techniques/DiffSkybox.xml"), QUALITY_MAX);
 			gen = MakeShared<SpaceBoxGen>(context_);
-			space_mat->SetTexture(TU_DIFFUSE, gen->SpaceCube);
-			gen->Generate();
-			spacebox->SetMaterial(space_mat);
+			gen->PrewarmShaders();
+			scheduler = MakeShared<SpaceBoxScheduler>(context_);
+			spaceMat->SetTexture(TU_DIFFUSE, gen->SpaceCube);
+			scheduler->Request(gen);
+			spacebox->SetMaterial(spaceMat);
         }
 
         // Create the camera which we will move around. Limit far clip distance to match the fog
@@ -181,7 +263,7 @@ void RenderToTexture::CreateInstructions()
 
     // Construct new Text object, set string to display and font to use
     auto* instructionText = ui->GetRoot()->CreateChild<Text>();
-    instructionText->SetText("Use WASD keys to move/ Press Space to toggle free mouse");
+    instructionText->SetText("Use WASD keys to move/ Press Space to toggle free mouse/ Press C to toggle frame capture/ K to save and L to load the sky/ M to switch cube, octahedral and equirect output");
     instructionText->SetFont(cache->GetResource<Font>("Fonts/Anonymous Pro.ttf"), 15);
 
     // Position the text relative to the screen center
@@ -237,6 +319,9 @@ void RenderToTexture::CreateInstructions()
 	CreateCheckbox(String("bright stars"), URHO3D_HANDLER(RenderToTexture, Toggle_Bright_Star));
 	CreateCheckbox(String("nebula"), URHO3D_HANDLER(RenderToTexture, Toggle_Nebula));
 	CreateCheckbox(String("sun"), URHO3D_HANDLER(RenderToTexture, Toggle_Sun));
+	CreateCheckbox(String("animate nebula"), URHO3D_HANDLER(RenderToTexture, Toggle_Animate), false);
+	CreateCheckbox(String("orbit sun"), URHO3D_HANDLER(RenderToTexture, Toggle_Orbit), false);
+	CreateCheckbox(String("live mode"), URHO3D_HANDLER(RenderToTexture, Toggle_Live), false);
 
 	UIElement * uielement_fov = uielement_->CreateChild<UIElement>();
 	uielement_fov->SetAlignment(HA_LEFT, VA_TOP);
@@ -334,11 +419,55 @@ void RenderToTexture::HandleUpdate(StringHash eventType, VariantMap& eventData)
 		else
 			Sample::InitMouseMode(MM_RELATIVE);
 	}
+
+	if (input->GetKeyPress(Key::KEY_C))
+	{
+		if (capture->IsCapturingSequence())
+			capture->StopSequence();
+		else
+			capture->StartSequence(GetSubsystem<FileSystem>()->GetProgramDir() + "Data/Capture_" +
+				Time::GetTimeStamp().Replaced(':', '_').Replaced('.', '_').Replaced(' ', '_'));
+	}
+
+	/*only the regions around the old and new sun position are re-rendered*/
+	if (orbitSun && gen->HasSun())
+		gen->SetSunDirection(Quaternion(10.0f * timeStep, Vector3::UP) * gen->GetSunDirection());
+
+	if (input->GetKeyPress(Key::KEY_K))
+		gen->SaveToCache(GetSubsystem<FileSystem>()->GetProgramDir() + "Data/SpaceBox.sbx");
+	if (input->GetKeyPress(Key::KEY_L))
+		gen->LoadFromCache(GetSubsystem<FileSystem>()->GetProgramDir() + "Data/SpaceBox.sbx");
+	/*cube, octahedral, equirectangular*/
+	if (input->GetKeyPress(Key::KEY_M))
+	{
+		gen->skyOutput = (SkyMapping)((gen->skyOutput + 1) % (SKY_EQUIRECT + 1));
+		scheduler->Request(gen, gen->GetSeed());
+	}
+#ifdef URHO3D_OPENGL
+	if (input->GetKeyPress(Key::KEY_V))
+	{
+		/*compare attribute setup with and without vertex array objects, the counters are of the last frame*/
+		const VertexArrayStats& stats = GetVertexArrayStats();
+		URHO3D_LOGINFO(String("VAO cache ") + (IsVertexArrayCacheEnabled() ? "on" : "off") + ": " + String(stats.attributeCalls_) +
+			" attribute calls, " + String(stats.vaoBinds_) + " binds, " + String(stats.cacheHits_) + " hits, " +
+			String(stats.vaoCreated_) + " created, " + String(stats.numCached_) + " cached");
+		SetVertexArrayCacheEnabled(!IsVertexArrayCacheEnabled());
+	}
+	if (input->GetKeyPress(Key::KEY_U))
+	{
+		/*compare constant buffer streaming through the ring with per-buffer uploads, the counters are of the last frame*/
+		const UniformRingStats& stats = GetUniformRingStats();
+		URHO3D_LOGINFO(String("Uniform ring ") + (IsUniformRingActive() ? (IsUniformRingPersistent() ? "persistent" : "subdata") : "off") +
+			": " + String(stats.copies_) + " copies, " + String(stats.bytes_) + " bytes, " + String(stats.rangeBinds_) + " range binds, " +
+			String(stats.slotChecks_) + " slot checks, " + String(stats.unchangedSets_) + " unchanged sets, " + String(stats.waits_) + " waits");
+		SetUniformRingEnabled(!IsUniformRingEnabled());
+	}
+#endif
 }
 
 void RenderToTexture::GenerateClicked(StringHash eventType, VariantMap& eventData)
 {
-	gen->Generate();
+	scheduler->Request(gen);
 }
 
 void RenderToTexture::SelectSize(StringHash eventType, VariantMap& eventData)
@@ -346,10 +475,10 @@ void RenderToTexture::SelectSize(StringHash eventType, VariantMap& eventData)
 	auto* list = static_cast<DropDownList*>(eventData[Toggled::P_ELEMENT].GetPtr());
 	UIElement * item = list->GetSelectedItem();
 	gen->cubeSize = item->GetVar(TEXTURECUBE_SIZE).GetInt();
-	gen->Generate();
+	scheduler->Request(gen);
 }
 
-void RenderToTexture::CreateCheckbox(const String& label, EventHandler* handler)
+void RenderToTexture::CreateCheckbox(const String& label, EventHandler* handler, bool checked)
 {
 	SharedPtr<UIElement> container(new UIElement(context_));
 	container->SetAlignment(HA_LEFT, VA_TOP);
@@ -359,7 +488,7 @@ void RenderToTexture::CreateCheckbox(const String& label, EventHandler* handler)
 	SharedPtr<CheckBox> box(new CheckBox(context_));
 	container->AddChild(box);
 	box->SetStyleAuto();
-	box->SetChecked(true);
+	box->SetChecked(checked);
 
 	SharedPtr<Text> text(new Text(context_));
 	container->AddChild(text);
@@ -373,33 +502,55 @@ void RenderToTexture::Toggle_Point_Star(StringHash eventType, VariantMap& eventD
 {
 	auto* box = static_cast<CheckBox*>(eventData[Toggled::P_ELEMENT].GetPtr());
 	gen->point_star_enable = box->IsChecked();
-	gen->Generate();
+	scheduler->Request(gen);
 }
 
 void RenderToTexture::Toggle_Bright_Star(StringHash eventType, VariantMap& eventData)
 {
 	auto* box = static_cast<CheckBox*>(eventData[Toggled::P_ELEMENT].GetPtr());
 	gen->bright_star_enable = box->IsChecked();
-	gen->Generate();
+	scheduler->Request(gen);
 }
 
 void RenderToTexture::Toggle_Nebula(StringHash eventType, VariantMap& eventData)
 {
 	auto* box = static_cast<CheckBox*>(eventData[Toggled::P_ELEMENT].GetPtr());
 	gen->nebula_enable = box->IsChecked();
-	gen->Generate();
+	scheduler->Request(gen);
 }
 
 void RenderToTexture::Toggle_Sun(StringHash eventType, VariantMap& eventData)
 {
 	auto* box = static_cast<CheckBox*>(eventData[Toggled::P_ELEMENT].GetPtr());
 	gen->sun_enable = box->IsChecked();
-	gen->Generate();
+	scheduler->Request(gen);
+}
+
+void RenderToTexture::Toggle_Animate(StringHash eventType, VariantMap& eventData)
+{
+	auto* box = static_cast<CheckBox*>(eventData[Toggled::P_ELEMENT].GetPtr());
+	gen->animateNebula = box->IsChecked();
+	scheduler->Request(gen, gen->GetSeed());
+}
+
+void RenderToTexture::Toggle_Orbit(StringHash eventType, VariantMap& eventData)
+{
+	auto* box = static_cast<CheckBox*>(eventData[Toggled::P_ELEMENT].GetPtr());
+	orbitSun = box->IsChecked();
+	gen->dynamicLayers = orbitSun;
+	scheduler->Request(gen, gen->GetSeed());
+}
+
+void RenderToTexture::Toggle_Live(StringHash eventType, VariantMap& eventData)
+{
+	auto* box = static_cast<CheckBox*>(eventData[Toggled::P_ELEMENT].GetPtr());
+	gen->liveMode = box->IsChecked();
+	scheduler->Request(gen, gen->GetSeed());
 }
 
 void RenderToTexture::HandlePostRenderUpdate(StringHash eventType, VariantMap& eventData)
 {
-	if (gen->sun_enable)
+	if (gen->HasSun())
 	{
 		DebugRenderer* debug = scene_->GetComponent<DebugRenderer>();
 		addDebugArrow(debug, Vector3::ZERO, gen->GetSunDirection().Normalized() * 50.0f, Color::GREEN, cameraNode_->GetWorldPosition());
@@ -422,6 +573,16 @@ void RenderToTexture::ChangeLight(StringHash eventType, VariantMap& eventData)
 	}
 }
 
+void RenderToTexture::SwapSpaceBox(StringHash eventType, VariantMap& eventData)
+{
+	auto* texture = static_cast<Texture*>(eventData[SpaceBoxReady::P_TEXTURE].GetPtr());
+	/*live mode and skyOutput hand over a 2D map instead of a cube*/
+	const char* techniques[] = { "Techniques/DiffSkybox.xml", "Techniques/DiffSkyboxOcta.xml", "Techniques/DiffSkyboxEquirect.xml" };
+	const int mapping = Clamp(eventData[SpaceBoxReady::P_MAPPING].GetInt(), (int)SKY_CUBE, (int)SKY_EQUIRECT);
+	spaceMat->SetTechnique(0, GetSubsystem<ResourceCache>()->GetResource<Technique>(techniques[mapping]), QUALITY_MAX);
+	spaceMat->SetTexture(TU_DIFFUSE, texture);
+}
+
 void RenderToTexture::fovSlided(StringHash eventType, VariantMap& eventData)
 {
 	float newValue = eventData[SliderChanged::P_VALUE].GetFloat();
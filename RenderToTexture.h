@@ -24,6 +24,10 @@
 #include <Urho3D/Urho3DAll.h>
 #include "Sample.h"
 #include "SpaceBoxGen.h"
+#include "SpaceBoxScheduler.h"
+#include "SpaceBoxCacheCheck.h"
+#include "FrameCapture.h"
+#include "GraphicsStats.h"
 
 namespace Urho3D
 {
@@ -65,17 +69,28 @@ private:
 	void HandlePostRenderUpdate(StringHash eventType, VariantMap& eventData);
 
 	bool mouseFree{ false };
+	bool orbitSun{ false };
 	SharedPtr<Node> lightNode;
 	SharedPtr<UIElement> uielement_;
 	SharedPtr<SpaceBoxGen> gen;
+	/*UI changes within a frame become one generation*/
+	SharedPtr<SpaceBoxScheduler> scheduler;
+	SharedPtr<Material> spaceMat;
+	SharedPtr<FrameCapture> capture;
+	SharedPtr<GraphicsStats> stats;
+	SharedPtr<SpaceBoxCacheCheck> cacheCheck;
 	SharedPtr<Text> tValue;
-	void CreateCheckbox(const String& label, EventHandler* handler);
+	void CreateCheckbox(const String& label, EventHandler* handler, bool checked = true);
 	void GenerateClicked(StringHash eventType, VariantMap& eventData);
 	void SelectSize(StringHash eventType, VariantMap& eventData);
 	void Toggle_Point_Star(StringHash eventType, VariantMap& eventData);
 	void Toggle_Bright_Star(StringHash eventType, VariantMap& eventData);
 	void Toggle_Nebula(StringHash eventType, VariantMap& eventData);
 	void Toggle_Sun(StringHash eventType, VariantMap& eventData);
+	void Toggle_Animate(StringHash eventType, VariantMap& eventData);
+	void Toggle_Orbit(StringHash eventType, VariantMap& eventData);
+	void Toggle_Live(StringHash eventType, VariantMap& eventData);
 	void ChangeLight(StringHash eventType, VariantMap& eventData);
+	void SwapSpaceBox(StringHash eventType, VariantMap& eventData);
 	void fovSlided(StringHash eventType, VariantMap& eventData);
 };
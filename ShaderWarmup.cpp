@@ -0,0 +1,200 @@
+#include "ShaderWarmup.h"
+#include <Urho3D/Urho3DAll.h>
+#include <Urho3D/Graphics/ShaderProgram.h>
+#ifdef URHO3D_OPENGL
+#include <Urho3D/Graphics/OpenGL/OGLShaderCompile.h>
+#include <Urho3D/Graphics/OpenGL/OGLProgramBinaryCache.h>
+#endif
+
+namespace Urho3D
+{
+	ShaderWarmup::ShaderWarmup(Context* context) : Object(context) {}
+
+	ShaderWarmup::~ShaderWarmup() {}
+
+	ShaderWarmup* ShaderWarmup::Get(Context* context)
+	{
+		auto* warmup = context->GetSubsystem<ShaderWarmup>();
+		if (!warmup)
+		{
+			warmup = new ShaderWarmup(context);
+			context->RegisterSubsystem(warmup);
+		}
+		return warmup;
+	}
+
+	void ShaderWarmup::Submit(Technique* technique)
+	{
+		if (!technique)
+			return;
+		const PODVector<Pass*>& passes = technique->GetPasses();
+		for (unsigned ii = 0; ii < passes.Size(); ++ii)
+			SubmitPass(passes[ii]);
+	}
+
+	void ShaderWarmup::Submit(Technique* technique, const String& passName)
+	{
+		if (technique)
+			SubmitPass(technique->GetPass(passName));
+	}
+
+	void ShaderWarmup::SubmitPass(Pass* pass)
+	{
+		if (!pass)
+			return;
+		auto* graphics = GetSubsystem<Graphics>();
+		Submit(graphics->GetShader(VS, pass->GetVertexShader(), pass->GetVertexShaderDefines()),
+			graphics->GetShader(PS, pass->GetPixelShader(), pass->GetPixelShaderDefines()));
+	}
+
+	void ShaderWarmup::Submit(ShaderVariation* vs, ShaderVariation* ps)
+	{
+		/*a missing shader file was logged by GetShader already*/
+		if (!vs || !ps)
+			return;
+		auto done = linked_.Find(PairKey(vs, ps));
+		if (done != linked_.End() && done->second_)
+			return;
+		for (unsigned ii = 0; ii < pending_.Size(); ++ii)
+		{
+			if (pending_[ii].vs.Get() == vs && pending_[ii].ps.Get() == ps)
+				return;
+		}
+		for (unsigned ii = 0; ii < linking_.Size(); ++ii)
+		{
+			if (linking_[ii].vs.Get() == vs && linking_[ii].ps.Get() == ps)
+				return;
+		}
+		ShaderPair pair;
+		pair.vs = vs;
+		pair.ps = ps;
+		pending_.Push(pair);
+		SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(ShaderWarmup, HandleBeginFrame));
+	}
+
+	bool ShaderWarmup::IsReady(Technique* technique) const
+	{
+		if (!technique)
+			return true;
+		auto* graphics = GetSubsystem<Graphics>();
+		const PODVector<Pass*>& passes = technique->GetPasses();
+		for (unsigned ii = 0; ii < passes.Size(); ++ii)
+		{
+			ShaderVariation* vs = graphics->GetShader(VS, passes[ii]->GetVertexShader(), passes[ii]->GetVertexShaderDefines());
+			ShaderVariation* ps = graphics->GetShader(PS, passes[ii]->GetPixelShader(), passes[ii]->GetPixelShaderDefines());
+			if (!vs || !ps)
+				continue;
+			auto program = linked_.Find(PairKey(vs, ps));
+			if (program == linked_.End() || !program->second_)
+				return false;
+		}
+		return true;
+	}
+
+	bool ShaderWarmup::Finish(const ShaderPair& pair)
+	{
+		auto* graphics = GetSubsystem<Graphics>();
+		/*on OpenGL this finishes the link BeginShaderProgram started, otherwise it compiles and links right here*/
+		graphics->SetShaders(pair.vs, pair.ps);
+		ShaderProgram* program = graphics->GetShaderProgram();
+#ifdef URHO3D_OPENGL
+		if (program && !program->IsLinked())
+			program = nullptr;
+#endif
+		if (!program)
+			return false;
+		linked_[PairKey(pair.vs, pair.ps)] = program;
+		return true;
+	}
+
+	void ShaderWarmup::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+	{
+		auto* graphics = GetSubsystem<Graphics>();
+		/*before the first frame, or with the device lost, try again next frame*/
+		if (!graphics || !graphics->IsInitialized() || graphics->IsDeviceLost())
+			return;
+
+		HiresTimer timer;
+		const long long budget = (long long)(frameBudgetMs * 1000.0f);
+
+		/*take over what the driver finished; what it has not is polled again next frame*/
+		for (unsigned ii = 0; ii < linking_.Size() && timer.GetUSec(false) < budget;)
+		{
+			ShaderPair& pair = linking_[ii];
+#ifdef URHO3D_OPENGL
+			if (!pair.program->IsLinkComplete())
+			{
+				/*SetShaders would wait for the driver here; the first draw with the pair does that instead*/
+				if (++pair.frames >= maxWaitFrames)
+				{
+					URHO3D_LOGWARNING("ShaderWarmup: " + pair.vs->GetFullName() + " and " + pair.ps->GetFullName() +
+						" not linked after " + String(pair.frames) + " frames, left to the first draw");
+					++batchSkipped_;
+					linking_.Erase(ii);
+				}
+				else
+					++ii;
+				continue;
+			}
+#endif
+			if (Finish(pair))
+				++batchCompiled_;
+			else
+				++batchFailed_;
+			linking_.Erase(ii);
+		}
+
+		/*start new pairs with what is left of the budget*/
+		unsigned started = 0;
+		while (started < pending_.Size() && linking_.Size() < maxInFlight && timer.GetUSec(false) < budget)
+		{
+			ShaderPair pair = pending_[started++];
+#ifdef URHO3D_OPENGL
+			/*compiles what is missing and issues the link; without parallel compile both wait for the driver*/
+			pair.program = BeginShaderProgram(graphics, pair.vs, pair.ps);
+			if (pair.program)
+				linking_.Push(pair);
+			else
+				++batchFailed_;
+#else
+			if (Finish(pair))
+				++batchCompiled_;
+			else
+				++batchFailed_;
+#endif
+		}
+		pending_.Erase(0, started);
+		/*nothing stays bound, the next draw sets its own pair*/
+		graphics->SetShaders(nullptr, nullptr);
+		batchTime_ += timer.GetUSec(false);
+
+		if (!IsComplete())
+			return;
+		UnsubscribeFromEvent(E_BEGINFRAME);
+		numCompiled_ += batchCompiled_;
+		numFailed_ += batchFailed_;
+		numSkipped_ += batchSkipped_;
+		compileTime_ += batchTime_;
+		String binaries;
+#ifdef URHO3D_OPENGL
+		/*the first warm-up is the startup cost: a run with an empty program cache is cold, the next one warm*/
+		if (auto* binaryCache = GetSubsystem<ProgramBinaryCache>())
+			binaries = ", " + String(binaryCache->GetNumRestored()) + " restored from program binaries in " +
+				String(binaryCache->GetRestoreTime() / 1000) + " ms";
+#endif
+		URHO3D_LOGINFO("ShaderWarmup: " + String(batchCompiled_) + " shader pairs in " + String(batchTime_ / 1000) +
+			" ms, " + String(batchFailed_) + " failed, " + String(batchSkipped_) + " left to their first draw" + binaries);
+
+		using namespace ShaderWarmupDone;
+		VariantMap& data = GetEventDataMap();
+		data[P_COMPILED] = batchCompiled_;
+		data[P_FAILED] = batchFailed_;
+		data[P_SKIPPED] = batchSkipped_;
+		data[P_TIME] = batchTime_ / 1000.0f;
+		batchCompiled_ = 0;
+		batchFailed_ = 0;
+		batchSkipped_ = 0;
+		batchTime_ = 0;
+		SendEvent(E_SHADERWARMUPDONE, data);
+	}
+}
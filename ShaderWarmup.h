@@ -0,0 +1,94 @@
+#pragma once
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Graphics/ShaderVariation.h>
+
+namespace Urho3D
+{
+	class ShaderProgram;
+	class Technique;
+
+	/*the queue ran empty*/
+	URHO3D_EVENT(E_SHADERWARMUPDONE, ShaderWarmupDone)
+	{
+		URHO3D_PARAM(P_COMPILED, Compiled); // unsigned, pairs compiled and linked since the queue was last empty
+		URHO3D_PARAM(P_FAILED, Failed); // unsigned
+		URHO3D_PARAM(P_SKIPPED, Skipped); // unsigned, left to the first draw after maxWaitFrames
+		URHO3D_PARAM(P_TIME, Time); // float, milliseconds spent in the warm-up
+	}
+
+	/*
+	Compiles and links shader pairs before the first draw that needs them, at E_BEGINFRAME, so the cost is spread over
+	frames instead of stalling one. On OpenGL each pair is started with BeginShaderProgram() and finished through
+	Graphics::SetShaders once ShaderProgram::IsLinkComplete(); with GL_KHR_parallel_shader_compile the driver compiles
+	and links on its own threads meanwhile, up to maxInFlight pairs at a time. Without the extension (and on Direct3D)
+	completion cannot be polled, so each pair still waits for the driver, one at a time. New pairs are started, and
+	finished ones taken over, only while the frame has spent less than frameBudgetMs here. A pair the driver has not
+	finished after maxWaitFrames is left to its first draw, which waits for it. Finished pairs are in the same program
+	cache as drawn ones (and on disk with ProgramBinaryCache). Techniques are submitted with their pass defines, which
+	is what the renderer uses for static geometry in unlit scene passes; other geometry types add defines of their own.
+	Work that needs a shader can wait for IsComplete() / IsReady() and keep showing what it has.
+	*/
+	class ShaderWarmup : public Object
+	{
+		URHO3D_OBJECT(ShaderWarmup, Object);
+	public:
+		explicit ShaderWarmup(Context* context);
+		~ShaderWarmup();
+
+		/*the subsystem, created on first use*/
+		static ShaderWarmup* Get(Context* context);
+
+		/*every pass, or one pass, of a technique*/
+		void Submit(Technique* technique);
+		void Submit(Technique* technique, const String& passName);
+		void Submit(ShaderVariation* vs, ShaderVariation* ps);
+		/*every pass of the technique has a program this warm-up linked, and it is still cached*/
+		bool IsReady(Technique* technique) const;
+		bool IsComplete() const { return pending_.Empty() && linking_.Empty(); }
+
+		unsigned GetNumPending() const { return pending_.Size() + linking_.Size(); }
+		unsigned GetNumCompiled() const { return numCompiled_; }
+		unsigned GetNumFailed() const { return numFailed_; }
+		unsigned GetNumSkipped() const { return numSkipped_; }
+		float GetCompileMs() const { return compileTime_ / 1000.0f; }
+
+		float frameBudgetMs{ 4.0f };
+		/*pairs the driver works on at once*/
+		unsigned maxInFlight{ 16 };
+		/*frames a pair may take before it is left to its first draw*/
+		unsigned maxWaitFrames{ 120 };
+
+	private:
+		typedef Pair<ShaderVariation*, ShaderVariation*> PairKey;
+
+		struct ShaderPair
+		{
+			SharedPtr<ShaderVariation> vs;
+			SharedPtr<ShaderVariation> ps;
+			/*started and not finished yet*/
+			SharedPtr<ShaderProgram> program;
+			unsigned frames{ 0 };
+		};
+
+		void SubmitPass(Pass* pass);
+		/*take the linked program into the graphics cache; false if the pair failed*/
+		bool Finish(const ShaderPair& pair);
+		void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+
+		/*not started*/
+		Vector<ShaderPair> pending_;
+		/*started, polled every frame*/
+		Vector<ShaderPair> linking_;
+		/*finished pairs; expires when the graphics cache drops the program*/
+		HashMap<PairKey, WeakPtr<ShaderProgram> > linked_;
+		unsigned numCompiled_{ 0 };
+		unsigned numFailed_{ 0 };
+		unsigned numSkipped_{ 0 };
+		long long compileTime_{ 0 };
+		/*since the queue was last empty, for E_SHADERWARMUPDONE*/
+		unsigned batchCompiled_{ 0 };
+		unsigned batchFailed_{ 0 };
+		unsigned batchSkipped_{ 0 };
+		long long batchTime_{ 0 };
+	};
+}
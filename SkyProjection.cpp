@@ -0,0 +1,323 @@
+#include "SkyProjection.h"
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Math/MathDefs.h>
+
+#ifdef URHO3D_SSE
+#include <emmintrin.h>
+#endif
+
+namespace Urho3D
+{
+	static const unsigned MAX_SKY_MAP_SIZE = 8192;
+
+	/*direction through face coordinates (s, t) in [-1, 1]: origin + s * right + t * down, the API cube map table*/
+	static const float FACE_BASIS[MAX_CUBEMAP_FACES][3][3] =
+	{
+		{ { 1, 0, 0 }, { 0, 0, -1 }, { 0, -1, 0 } },
+		{ { -1, 0, 0 }, { 0, 0, 1 }, { 0, -1, 0 } },
+		{ { 0, 1, 0 }, { 1, 0, 0 }, { 0, 0, 1 } },
+		{ { 0, -1, 0 }, { 1, 0, 0 }, { 0, 0, -1 } },
+		{ { 0, 0, 1 }, { 1, 0, 0 }, { 0, -1, 0 } },
+		{ { 0, 0, -1 }, { -1, 0, 0 }, { 0, -1, 0 } }
+	};
+
+	void GetSkyMapSize(SkyMapping mapping, int faceSize, int& width, int& height)
+	{
+		/*an octahedral map of 2C has 4C^2 texels against 6C^2 of the cube, a bit less than its density at face centers*/
+		switch (mapping)
+		{
+		case SKY_OCTAHEDRAL:
+			width = height = Min(faceSize * 2, (int)MAX_SKY_MAP_SIZE);
+			break;
+		case SKY_EQUIRECT:
+			width = Min(faceSize * 4, (int)MAX_SKY_MAP_SIZE);
+			height = width / 2;
+			break;
+		default:
+			width = height = faceSize;
+			break;
+		}
+	}
+
+	static inline float OctSign(float v)
+	{
+		return v >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	/*face and texture coordinates textureCube picks for a direction*/
+	static unsigned CubeFace(float x, float y, float z, float& u, float& v)
+	{
+		const float ax = Abs(x);
+		const float ay = Abs(y);
+		const float az = Abs(z);
+		unsigned face;
+		float ma, sc, tc;
+		if (ax >= ay && ax >= az)
+		{
+			face = x >= 0.0f ? FACE_POSITIVE_X : FACE_NEGATIVE_X;
+			ma = ax;
+			sc = x >= 0.0f ? -z : z;
+			tc = -y;
+		}
+		else if (ay >= az)
+		{
+			face = y >= 0.0f ? FACE_POSITIVE_Y : FACE_NEGATIVE_Y;
+			ma = ay;
+			sc = x;
+			tc = y >= 0.0f ? z : -z;
+		}
+		else
+		{
+			face = z >= 0.0f ? FACE_POSITIVE_Z : FACE_NEGATIVE_Z;
+			ma = az;
+			sc = z >= 0.0f ? x : -x;
+			tc = -y;
+		}
+		u = 0.5f * (sc / ma + 1.0f);
+		v = 0.5f * (tc / ma + 1.0f);
+		return face;
+	}
+
+	static void SampleBilinear(const unsigned char* data, int width, int height, float u, float v, bool wrapU, unsigned char* out)
+	{
+		const float x = u * width - 0.5f;
+		const float y = v * height - 0.5f;
+		int x0 = FloorToInt(x);
+		int y0 = FloorToInt(y);
+		const float fx = x - x0;
+		const float fy = y - y0;
+		int x1 = x0 + 1;
+		int y1 = Min(y0 + 1, height - 1);
+		y0 = Max(y0, 0);
+		if (wrapU)
+		{
+			x0 = (x0 + width) % width;
+			x1 = x1 % width;
+		}
+		else
+		{
+			x0 = Max(x0, 0);
+			x1 = Min(x1, width - 1);
+		}
+
+		const unsigned char* t00 = data + (y0 * width + x0) * 4;
+		const unsigned char* t10 = data + (y0 * width + x1) * 4;
+		const unsigned char* t01 = data + (y1 * width + x0) * 4;
+		const unsigned char* t11 = data + (y1 * width + x1) * 4;
+		for (unsigned c = 0; c < 4; ++c)
+		{
+			const float top = t00[c] + (t10[c] - t00[c]) * fx;
+			const float bottom = t01[c] + (t11[c] - t01[c]) * fx;
+			out[c] = (unsigned char)(top + (bottom - top) * fy + 0.5f);
+		}
+	}
+
+#ifdef URHO3D_SSE
+	static inline __m128 AbsPs(__m128 v)
+	{
+		return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+	}
+
+	static inline __m128 SelectPs(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	static inline __m128 OctSignPs(__m128 v)
+	{
+		return SelectPs(_mm_cmpge_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f), _mm_set1_ps(-1.0f));
+	}
+#endif
+
+	/*directions (not normalized) of the texel centers of one map row*/
+	static void MapRowDirections(SkyMapping mapping, int width, int height, int row, const float* sinLon, const float* cosLon,
+		float* x, float* y, float* z)
+	{
+		const float v = (row + 0.5f) / height;
+		int i = 0;
+		if (mapping == SKY_EQUIRECT)
+		{
+			const float lat = (0.5f - v) * M_PI;
+			const float sinLat = sinf(lat);
+			const float cosLat = cosf(lat);
+#ifdef URHO3D_SSE
+			const __m128 c = _mm_set1_ps(cosLat);
+			for (; i + 4 <= width; i += 4)
+			{
+				_mm_storeu_ps(x + i, _mm_mul_ps(c, _mm_loadu_ps(sinLon + i)));
+				_mm_storeu_ps(y + i, _mm_set1_ps(sinLat));
+				_mm_storeu_ps(z + i, _mm_mul_ps(c, _mm_loadu_ps(cosLon + i)));
+			}
+#endif
+			for (; i < width; ++i)
+			{
+				x[i] = cosLat * sinLon[i];
+				y[i] = sinLat;
+				z[i] = cosLat * cosLon[i];
+			}
+			return;
+		}
+
+		const float py = 1.0f - 2.0f * v;
+		const float scale = 2.0f / width;
+#ifdef URHO3D_SSE
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 vy = _mm_set1_ps(py);
+		const __m128 ay = AbsPs(vy);
+		for (; i + 4 <= width; i += 4)
+		{
+			const __m128 px = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)i), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f)), _mm_set1_ps(scale)), one);
+			const __m128 ax = AbsPs(px);
+			const __m128 vz = _mm_sub_ps(_mm_sub_ps(one, ax), ay);
+			const __m128 lower = _mm_cmplt_ps(vz, _mm_setzero_ps());
+			_mm_storeu_ps(x + i, SelectPs(lower, _mm_mul_ps(_mm_sub_ps(one, ay), OctSignPs(px)), px));
+			_mm_storeu_ps(y + i, SelectPs(lower, _mm_mul_ps(_mm_sub_ps(one, ax), OctSignPs(vy)), vy));
+			_mm_storeu_ps(z + i, vz);
+		}
+#endif
+		for (; i < width; ++i)
+		{
+			const float px = (i + 0.5f) * scale - 1.0f;
+			z[i] = 1.0f - Abs(px) - Abs(py);
+			x[i] = z[i] < 0.0f ? (1.0f - Abs(py)) * OctSign(px) : px;
+			y[i] = z[i] < 0.0f ? (1.0f - Abs(px)) * OctSign(py) : py;
+		}
+	}
+
+	/*map texture coordinates of count directions*/
+	static void EncodeDirections(SkyMapping mapping, int count, const float* x, const float* y, const float* z, float* u, float* v)
+	{
+		int i = 0;
+		if (mapping == SKY_EQUIRECT)
+		{
+			for (; i < count; ++i)
+			{
+				const float len = sqrtf(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+				u[i] = 0.5f + atan2f(x[i], z[i]) * (0.5f / M_PI);
+				v[i] = 0.5f - asinf(Clamp(y[i] / len, -1.0f, 1.0f)) * (1.0f / M_PI);
+			}
+			return;
+		}
+
+#ifdef URHO3D_SSE
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 vx = _mm_loadu_ps(x + i);
+			const __m128 vy = _mm_loadu_ps(y + i);
+			const __m128 vz = _mm_loadu_ps(z + i);
+			const __m128 inv = _mm_div_ps(one, _mm_add_ps(_mm_add_ps(AbsPs(vx), AbsPs(vy)), AbsPs(vz)));
+			__m128 px = _mm_mul_ps(vx, inv);
+			__m128 py = _mm_mul_ps(vy, inv);
+			const __m128 lower = _mm_cmplt_ps(vz, _mm_setzero_ps());
+			const __m128 fx = _mm_mul_ps(_mm_sub_ps(one, AbsPs(py)), OctSignPs(px));
+			const __m128 fy = _mm_mul_ps(_mm_sub_ps(one, AbsPs(px)), OctSignPs(py));
+			px = SelectPs(lower, fx, px);
+			py = SelectPs(lower, fy, py);
+			_mm_storeu_ps(u + i, _mm_add_ps(half, _mm_mul_ps(half, px)));
+			_mm_storeu_ps(v + i, _mm_sub_ps(half, _mm_mul_ps(half, py)));
+		}
+#endif
+		for (; i < count; ++i)
+		{
+			const float inv = 1.0f / (Abs(x[i]) + Abs(y[i]) + Abs(z[i]));
+			float px = x[i] * inv;
+			float py = y[i] * inv;
+			if (z[i] < 0.0f)
+			{
+				const float fx = (1.0f - Abs(py)) * OctSign(px);
+				py = (1.0f - Abs(px)) * OctSign(py);
+				px = fx;
+			}
+			u[i] = 0.5f + 0.5f * px;
+			v[i] = 0.5f - 0.5f * py;
+		}
+	}
+
+	/*directions of the texel centers of one face row*/
+	static void FaceRowDirections(unsigned face, int size, int row, float* x, float* y, float* z)
+	{
+		const float (&b)[3][3] = FACE_BASIS[face];
+		const float t = (row + 0.5f) * 2.0f / size - 1.0f;
+		const float scale = 2.0f / size;
+		int i = 0;
+#ifdef URHO3D_SSE
+		const __m128 ox = _mm_set1_ps(b[0][0] + t * b[2][0]);
+		const __m128 oy = _mm_set1_ps(b[0][1] + t * b[2][1]);
+		const __m128 oz = _mm_set1_ps(b[0][2] + t * b[2][2]);
+		for (; i + 4 <= size; i += 4)
+		{
+			const __m128 s = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)i), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f)), _mm_set1_ps(scale)),
+				_mm_set1_ps(1.0f));
+			_mm_storeu_ps(x + i, _mm_add_ps(ox, _mm_mul_ps(s, _mm_set1_ps(b[1][0]))));
+			_mm_storeu_ps(y + i, _mm_add_ps(oy, _mm_mul_ps(s, _mm_set1_ps(b[1][1]))));
+			_mm_storeu_ps(z + i, _mm_add_ps(oz, _mm_mul_ps(s, _mm_set1_ps(b[1][2]))));
+		}
+#endif
+		for (; i < size; ++i)
+		{
+			const float s = (i + 0.5f) * scale - 1.0f;
+			x[i] = b[0][0] + s * b[1][0] + t * b[2][0];
+			y[i] = b[0][1] + s * b[1][1] + t * b[2][1];
+			z[i] = b[0][2] + s * b[1][2] + t * b[2][2];
+		}
+	}
+
+	void CubeToSkyMap(const unsigned char* const faces[MAX_CUBEMAP_FACES], int faceSize, SkyMapping mapping,
+		unsigned char* map, int width, int height)
+	{
+		PODVector<float> buffer(width * 5);
+		float* x = &buffer[0];
+		float* y = x + width;
+		float* z = y + width;
+		/*longitude only depends on the column*/
+		float* sinLon = z + width;
+		float* cosLon = sinLon + width;
+		if (mapping == SKY_EQUIRECT)
+		{
+			for (int i = 0; i < width; ++i)
+			{
+				const float lon = ((i + 0.5f) / width - 0.5f) * 2.0f * M_PI;
+				sinLon[i] = sinf(lon);
+				cosLon[i] = cosf(lon);
+			}
+		}
+
+		for (int row = 0; row < height; ++row)
+		{
+			MapRowDirections(mapping, width, height, row, sinLon, cosLon, x, y, z);
+			unsigned char* out = map + row * width * 4;
+			for (int i = 0; i < width; ++i)
+			{
+				float u, v;
+				const unsigned face = CubeFace(x[i], y[i], z[i], u, v);
+				SampleBilinear(faces[face], faceSize, faceSize, u, v, false, out + i * 4);
+			}
+		}
+	}
+
+	void SkyMapToCube(const unsigned char* map, int width, int height, SkyMapping mapping,
+		unsigned char* const faces[MAX_CUBEMAP_FACES], int faceSize)
+	{
+		PODVector<float> buffer(faceSize * 5);
+		float* x = &buffer[0];
+		float* y = x + faceSize;
+		float* z = y + faceSize;
+		float* u = z + faceSize;
+		float* v = u + faceSize;
+		const bool wrapU = mapping == SKY_EQUIRECT;
+
+		for (unsigned face = 0; face < MAX_CUBEMAP_FACES; ++face)
+		{
+			for (int row = 0; row < faceSize; ++row)
+			{
+				FaceRowDirections(face, faceSize, row, x, y, z);
+				EncodeDirections(mapping, faceSize, x, y, z, u, v);
+				unsigned char* out = faces[face] + row * faceSize * 4;
+				for (int i = 0; i < faceSize; ++i)
+					SampleBilinear(map, width, height, u[i], v[i], wrapU, out + i * 4);
+			}
+		}
+	}
+}
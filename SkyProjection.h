@@ -0,0 +1,30 @@
+#pragma once
+#include <Urho3D/Urho3D.h>
+#include <Urho3D/Graphics/GraphicsDefs.h>
+
+namespace Urho3D
+{
+	/*how a sky is stored: six faces, or one 2D map*/
+	enum SkyMapping
+	{
+		SKY_CUBE = 0,
+		/*square, the upper hemisphere (z >= 0) in the inner diamond; see octahedral.glsl*/
+		SKY_OCTAHEDRAL,
+		/*2:1, longitude atan2(x, z) along u, +y on row 0; see equirect.glsl*/
+		SKY_EQUIRECT
+	};
+
+	/*
+	RGBA8 conversions between cube faces and 2D sky maps, bilinear, for worker threads.
+	Faces follow the cube map convention of the graphics APIs (the layout textureCube samples and
+	GetData returns), maps have row 0 at the top like rendered textures, matching the shaders.
+	Directions are computed 4 texels at a time with SSE2 where the math allows; the texel fetches are scalar.
+	*/
+
+	/*map size giving about the texel density of a cube with faceSize faces*/
+	void GetSkyMapSize(SkyMapping mapping, int faceSize, int& width, int& height);
+	void CubeToSkyMap(const unsigned char* const faces[MAX_CUBEMAP_FACES], int faceSize, SkyMapping mapping,
+		unsigned char* map, int width, int height);
+	void SkyMapToCube(const unsigned char* map, int width, int height, SkyMapping mapping,
+		unsigned char* const faces[MAX_CUBEMAP_FACES], int faceSize);
+}
@@ -0,0 +1,587 @@
+#include "SpaceBoxCache.h"
+#include <Urho3D/Urho3DAll.h>
+#ifdef URHO3D_OPENGL
+#include <Urho3D/Graphics/OpenGL/OGLTextureReadback.h>
+#include <Urho3D/Graphics/OpenGL/OGLTextureUploader.h>
+#endif
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Urho3D
+{
+	static const char CACHE_MAGIC[4] = { 'S', 'B', 'X', 'C' };
+	static const unsigned CACHE_VERSION = 1;
+	static const unsigned MAX_CACHE_SIZE = 16384;
+
+	struct CacheHeader
+	{
+		char magic[4];
+		unsigned version;
+		unsigned size;
+		unsigned seed;
+		unsigned sunEnable;
+		float sunDir[3];
+		float sunColor[3];
+		unsigned reserved;
+	};
+	static_assert(sizeof(CacheHeader) == 48, "cache header layout");
+
+	static unsigned FaceBytes(unsigned size)
+	{
+		return size * size * 4;
+	}
+
+	/*read-only view of a whole file; falls back to reading into memory when it can not be mapped (packages, APK assets)*/
+	struct MappedFile
+	{
+		const unsigned char* data{ nullptr };
+		unsigned size{ 0 };
+		PODVector<unsigned char> buffer;
+#ifdef _WIN32
+		HANDLE file{ INVALID_HANDLE_VALUE };
+		HANDLE mapping{ nullptr };
+#else
+		bool mapped{ false };
+#endif
+	};
+
+	static bool MapFile(Context* context, const String& fileName, MappedFile& out)
+	{
+#ifdef _WIN32
+		out.file = CreateFileW(WString(GetNativePath(fileName)).CString(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (out.file != INVALID_HANDLE_VALUE)
+		{
+			LARGE_INTEGER size;
+			if (GetFileSizeEx(out.file, &size) && size.QuadPart > 0 && size.QuadPart < M_MAX_UNSIGNED)
+			{
+				out.mapping = CreateFileMappingW(out.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				if (out.mapping)
+				{
+					out.data = static_cast<const unsigned char*>(MapViewOfFile(out.mapping, FILE_MAP_READ, 0, 0, 0));
+					if (out.data)
+					{
+						out.size = (unsigned)size.QuadPart;
+						return true;
+					}
+					CloseHandle(out.mapping);
+					out.mapping = nullptr;
+				}
+			}
+			CloseHandle(out.file);
+			out.file = INVALID_HANDLE_VALUE;
+		}
+#else
+		int fd = open(GetNativePath(fileName).CString(), O_RDONLY);
+		if (fd >= 0)
+		{
+			struct stat st;
+			if (fstat(fd, &st) == 0 && st.st_size > 0 && (unsigned long long)st.st_size < M_MAX_UNSIGNED)
+			{
+				void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (data != MAP_FAILED)
+				{
+					madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+					close(fd);
+					out.data = static_cast<const unsigned char*>(data);
+					out.size = (unsigned)st.st_size;
+					out.mapped = true;
+					return true;
+				}
+			}
+			close(fd);
+		}
+#endif
+
+		File file(context, fileName);
+		if (!file.IsOpen() || !file.GetSize())
+			return false;
+		out.buffer.Resize(file.GetSize());
+		if (file.Read(&out.buffer[0], out.buffer.Size()) != out.buffer.Size())
+			return false;
+		out.data = &out.buffer[0];
+		out.size = out.buffer.Size();
+		return true;
+	}
+
+	static void UnmapFile(MappedFile& file)
+	{
+#ifdef _WIN32
+		if (file.mapping)
+		{
+			UnmapViewOfFile(file.data);
+			CloseHandle(file.mapping);
+			CloseHandle(file.file);
+			file.mapping = nullptr;
+			file.file = INVALID_HANDLE_VALUE;
+		}
+#else
+		if (file.mapped)
+		{
+			munmap(const_cast<unsigned char*>(file.data), file.size);
+			file.mapped = false;
+		}
+#endif
+		file.buffer.Clear();
+		file.data = nullptr;
+		file.size = 0;
+	}
+
+	struct SpaceBoxCacheLoad
+	{
+		Context* context;
+		String fileName;
+		MappedFile file;
+		CacheHeader header;
+		bool valid{ false };
+		/*the map converted from the faces, for any mapping other than SKY_CUBE*/
+		SkyMapping mapping{ SKY_CUBE };
+		int mapWidth{ 0 };
+		int mapHeight{ 0 };
+		PODVector<unsigned char> map;
+		bool cancelled{ false };
+		/*work items still using the file*/
+		unsigned pendingWork{ 0 };
+	};
+
+	struct SpaceBoxFaceCopy
+	{
+		SpaceBoxCacheLoad* load;
+		unsigned face;
+		/*uploader handle, 0 when copying into staging*/
+		unsigned handle;
+		unsigned char* dest;
+		SharedArrayPtr<unsigned char> staging;
+	};
+
+	struct SpaceBoxCacheSave
+	{
+		Context* context;
+		String fileName;
+		CacheHeader header;
+		/*must not be copied on the worker, reference counts are not atomic*/
+		SharedPtr<Image> faces[MAX_CUBEMAP_FACES];
+		/*or one sky map in faces[0]*/
+		SkyMapping mapping;
+	};
+
+	/*worker: map and validate the file*/
+	static void OpenWork(const WorkItem* item, unsigned threadIndex)
+	{
+		auto* load = static_cast<SpaceBoxCacheLoad*>(item->aux_);
+		if (!MapFile(load->context, load->fileName, load->file))
+			return;
+
+		if (load->file.size < sizeof(CacheHeader))
+			return;
+		memcpy(&load->header, load->file.data, sizeof(CacheHeader));
+		const CacheHeader& h = load->header;
+		load->valid = memcmp(h.magic, CACHE_MAGIC, 4) == 0 && h.version == CACHE_VERSION && h.size > 0 && h.size <= MAX_CACHE_SIZE &&
+			load->file.size == sizeof(CacheHeader) + FaceBytes(h.size) * MAX_CUBEMAP_FACES;
+		if (!load->valid || load->mapping == SKY_CUBE)
+			return;
+
+		const unsigned char* faces[MAX_CUBEMAP_FACES];
+		for (unsigned ii = 0; ii < MAX_CUBEMAP_FACES; ++ii)
+			faces[ii] = load->file.data + sizeof(CacheHeader) + ii * FaceBytes(h.size);
+		GetSkyMapSize(load->mapping, (int)h.size, load->mapWidth, load->mapHeight);
+		load->map.Resize((unsigned)(load->mapWidth * load->mapHeight * 4));
+		CubeToSkyMap(faces, (int)h.size, load->mapping, &load->map[0], load->mapWidth, load->mapHeight);
+	}
+
+	/*worker: copy one face out of the mapping, page faults and disk reads happen here*/
+	static void CopyFaceWork(const WorkItem* item, unsigned threadIndex)
+	{
+		auto* copy = static_cast<SpaceBoxFaceCopy*>(item->aux_);
+		const unsigned faceBytes = FaceBytes(copy->load->header.size);
+		memcpy(copy->dest, copy->load->file.data + sizeof(CacheHeader) + copy->face * faceBytes, faceBytes);
+	}
+
+	/*worker: write header and faces*/
+	static void SaveWork(const WorkItem* item, unsigned threadIndex)
+	{
+		auto* save = static_cast<SpaceBoxCacheSave*>(item->aux_);
+		File file(save->context, save->fileName, FILE_WRITE);
+		if (!file.IsOpen())
+			return;
+		file.Write(&save->header, sizeof(CacheHeader));
+		const unsigned faceBytes = FaceBytes(save->header.size);
+		if (save->mapping == SKY_CUBE)
+		{
+			for (unsigned ii = 0; ii < MAX_CUBEMAP_FACES; ++ii)
+				file.Write(save->faces[ii]->GetData(), faceBytes);
+			return;
+		}
+
+		PODVector<unsigned char> buffer(faceBytes * MAX_CUBEMAP_FACES);
+		unsigned char* faces[MAX_CUBEMAP_FACES];
+		for (unsigned ii = 0; ii < MAX_CUBEMAP_FACES; ++ii)
+			faces[ii] = &buffer[ii * faceBytes];
+		const Image* map = save->faces[0].Get();
+		SkyMapToCube(map->GetData(), map->GetWidth(), map->GetHeight(), save->mapping, faces, (int)save->header.size);
+		file.Write(&buffer[0], buffer.Size());
+	}
+
+	SpaceBoxCache::SpaceBoxCache(Context* context) : Object(context)
+	{
+#ifdef URHO3D_OPENGL
+		readback_ = MakeShared<TextureReadback>(context);
+		uploader_ = MakeShared<TextureUploader>(context);
+#endif
+		SubscribeToEvent(E_WORKITEMCOMPLETED, URHO3D_HANDLER(SpaceBoxCache, HandleWorkItemCompleted));
+	}
+
+	SpaceBoxCache::~SpaceBoxCache()
+	{
+		if (loads_.Empty() && copies_.Empty() && saves_.Empty())
+			return;
+		/*let running copies finish before their source and destination go away*/
+		UnsubscribeFromEvent(E_WORKITEMCOMPLETED);
+		GetSubsystem<WorkQueue>()->Complete(0);
+		for (unsigned i = 0; i < copies_.Size(); ++i)
+		{
+			if (copies_[i]->handle)
+				uploader_->Abort(copies_[i]->handle);
+			delete copies_[i];
+		}
+		for (unsigned i = 0; i < loads_.Size(); ++i)
+		{
+			UnmapFile(loads_[i]->file);
+			delete loads_[i];
+		}
+		for (unsigned i = 0; i < saves_.Size(); ++i)
+			delete saves_[i];
+	}
+
+	bool SpaceBoxCache::Save(TextureCube* cube, const String& fileName, const SpaceBoxCacheInfo& info)
+	{
+		if (saving_ || !cube || cube->GetWidth() <= 0 || (unsigned)cube->GetWidth() > MAX_CACHE_SIZE ||
+			cube->GetFormat() != Graphics::GetRGBAFormat())
+			return false;
+
+		saving_ = true;
+		saveFileName_ = fileName;
+		saveInfo_ = info;
+		saveMapping_ = SKY_CUBE;
+		numSaveFaces_ = 0;
+		for (unsigned ii = 0; ii < MAX_CUBEMAP_FACES; ++ii)
+			saveFaces_[ii].Reset();
+
+		for (unsigned ii = 0; ii < MAX_CUBEMAP_FACES; ++ii)
+		{
+#ifdef URHO3D_OPENGL
+			/*readback_ is owned by this object, so the callback cannot outlive it*/
+			if (!readback_->Request(cube, (CubeMapFace)ii, [this, ii](Image* image) { HandleFaceRead(ii, image); }))
+				HandleFaceRead(ii, nullptr);
+#else
+			SharedPtr<Image> image(new Image(context_));
+			image->SetSize(cube->GetWidth(), cube->GetHeight(), 4);
+			HandleFaceRead(ii, cube->GetData((CubeMapFace)ii, 0, image->GetData()) ? image.Get() : nullptr);
+#endif
+		}
+		return true;
+	}
+
+	bool SpaceBoxCache::Save(Texture2D* map, SkyMapping mapping, const String& fileName, const SpaceBoxCacheInfo& info)
+	{
+		if (saving_ || !map || mapping == SKY_CUBE || map->GetWidth() <= 0 || map->GetFormat() != Graphics::GetRGBAFormat())
+			return false;
+
+		saving_ = true;
+		saveFileName_ = fileName;
+		saveInfo_ = info;
+		saveMapping_ = mapping;
+		for (unsigned ii = 0; ii < MAX_CUBEMAP_FACES; ++ii)
+			saveFaces_[ii].Reset();
+		/*the map stands in for all faces*/
+		numSaveFaces_ = MAX_CUBEMAP_FACES - 1;
+
+#ifdef URHO3D_OPENGL
+		if (!readback_->Request(map, [this](Image* image) { HandleFaceRead(0, image); }))
+			HandleFaceRead(0, nullptr);
+#else
+		SharedPtr<Image> image(new Image(context_));
+		image->SetSize(map->GetWidth(), map->GetHeight(), 4);
+		HandleFaceRead(0, map->GetData(0, image->GetData()) ? image.Get() : nullptr);
+#endif
+		return true;
+	}
+
+	void SpaceBoxCache::HandleFaceRead(unsigned face, Image* image)
+	{
+		if (image && image->GetComponents() == 4)
+			saveFaces_[face] = image;
+		if (++numSaveFaces_ < MAX_CUBEMAP_FACES)
+			return;
+
+		const unsigned numImages = saveMapping_ == SKY_CUBE ? MAX_CUBEMAP_FACES : 1;
+		for (unsigned ii = 0; ii < numImages; ++ii)
+		{
+			if (!saveFaces_[ii])
+			{
+				URHO3D_LOGERROR("SpaceBoxCache: reading back " + saveFileName_ + " failed");
+				saving_ = false;
+				return;
+			}
+		}
+
+		auto* save = new SpaceBoxCacheSave();
+		save->context = context_;
+		save->fileName = saveFileName_;
+		save->mapping = saveMapping_;
+		CacheHeader& h = save->header;
+		memcpy(h.magic, CACHE_MAGIC, 4);
+		h.version = CACHE_VERSION;
+		/*about the texel density of the map, see GetSkyMapSize*/
+		const int width = saveFaces_[0]->GetWidth();
+		h.size = (unsigned)Clamp(saveMapping_ == SKY_EQUIRECT ? width / 4 : saveMapping_ == SKY_OCTAHEDRAL ? width / 2 : width,
+			1, (int)MAX_CACHE_SIZE);
+		h.seed = saveInfo_.seed;
+		h.sunEnable = saveInfo_.sunEnable ? 1 : 0;
+		memcpy(h.sunDir, saveInfo_.sunDirection.Data(), sizeof(h.sunDir));
+		memcpy(h.sunColor, saveInfo_.sunColor.Data(), sizeof(h.sunColor));
+		h.reserved = 0;
+		for (unsigned ii = 0; ii < MAX_CUBEMAP_FACES; ++ii)
+		{
+			save->faces[ii] = saveFaces_[ii];
+			saveFaces_[ii].Reset();
+		}
+		saves_.Push(save);
+		QueueWork(SaveWork, save);
+	}
+
+	void SpaceBoxCache::Load(const String& fileName, SkyMapping mapping)
+	{
+		Cancel();
+
+		load_ = new SpaceBoxCacheLoad();
+		load_->context = context_;
+		load_->fileName = fileName;
+		load_->mapping = mapping;
+		load_->pendingWork = 1;
+		loads_.Push(load_);
+		loadTimer_.Reset();
+		loadFrames_ = 0;
+		QueueWork(OpenWork, load_);
+	}
+
+	void SpaceBoxCache::Cancel()
+	{
+		if (!load_)
+			return;
+
+		UnsubscribeFromEvent(E_BEGINFRAME);
+		texture_.Reset();
+		load_->cancelled = true;
+		if (!load_->pendingWork)
+			ReleaseLoad(load_);
+		load_ = nullptr;
+	}
+
+	void SpaceBoxCache::QueueWork(void(*work)(const WorkItem*, unsigned), void* aux)
+	{
+		auto* queue = GetSubsystem<WorkQueue>();
+		SharedPtr<WorkItem> item = queue->GetFreeItem();
+		item->priority_ = 0;
+		item->workFunction_ = work;
+		item->aux_ = aux;
+		item->sendEvent_ = true;
+		queue->AddWorkItem(item);
+	}
+
+	void SpaceBoxCache::QueueFaces()
+	{
+		const unsigned faceBytes = FaceBytes(load_->header.size);
+		unsigned bytes = 0;
+		while (nextFace_ < MAX_CUBEMAP_FACES && (bytes == 0 || bytes + faceBytes <= uploadBudget))
+		{
+			auto* copy = new SpaceBoxFaceCopy();
+			copy->load = load_;
+			copy->face = nextFace_;
+			copy->handle = 0;
+			copy->dest = nullptr;
+#ifdef URHO3D_OPENGL
+			copy->handle = uploader_->Map(faceBytes);
+			copy->dest = uploader_->GetData(copy->handle);
+#endif
+			if (!copy->dest)
+			{
+				copy->staging = new unsigned char[faceBytes];
+				copy->dest = copy->staging.Get();
+			}
+
+			++load_->pendingWork;
+			copies_.Push(copy);
+			QueueWork(CopyFaceWork, copy);
+			bytes += faceBytes;
+			++nextFace_;
+		}
+
+		if (nextFace_ == MAX_CUBEMAP_FACES)
+			UnsubscribeFromEvent(E_BEGINFRAME);
+	}
+
+	void SpaceBoxCache::FinishLoad(bool success)
+	{
+		SpaceBoxCacheLoad* load = load_;
+		SharedPtr<Texture> texture(texture_);
+		load_ = nullptr;
+		texture_.Reset();
+		UnsubscribeFromEvent(E_BEGINFRAME);
+
+		if (success)
+			URHO3D_LOGINFO("SpaceBoxCache: loaded " + load->fileName + " in " + String(loadTimer_.GetUSec(false) / 1000) + " ms over " +
+				String(loadFrames_) + " frames");
+		else
+			URHO3D_LOGERROR("SpaceBoxCache: loading " + load->fileName + " failed");
+
+		using namespace SpaceBoxCacheLoaded;
+		const CacheHeader& h = load->header;
+		VariantMap& data = GetEventDataMap();
+		data[P_SUCCESS] = success;
+		data[P_TEXTURE] = success ? texture.Get() : nullptr;
+		data[P_MAPPING] = success ? (int)load->mapping : (int)SKY_CUBE;
+		data[P_SEED] = success ? h.seed : 0;
+		data[P_SUN_ENABLE] = success && h.sunEnable != 0;
+		data[P_SUN_DIR] = success ? Vector3(h.sunDir) : Vector3::ZERO;
+		data[P_SUN_COLOR] = success ? Color(h.sunColor[0], h.sunColor[1], h.sunColor[2]) : Color::BLACK;
+
+		load->cancelled = true;
+		if (!load->pendingWork)
+			ReleaseLoad(load);
+
+		SendEvent(E_SPACEBOXCACHELOADED, data);
+	}
+
+	void SpaceBoxCache::ReleaseLoad(SpaceBoxCacheLoad* load)
+	{
+		UnmapFile(load->file);
+		loads_.Remove(load);
+		delete load;
+	}
+
+	void SpaceBoxCache::ReleaseCopy(SpaceBoxFaceCopy* copy)
+	{
+		SpaceBoxCacheLoad* load = copy->load;
+		copies_.Remove(copy);
+		delete copy;
+		if (!--load->pendingWork && load->cancelled)
+			ReleaseLoad(load);
+	}
+
+	void SpaceBoxCache::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+	{
+		++loadFrames_;
+		QueueFaces();
+	}
+
+	void SpaceBoxCache::HandleWorkItemCompleted(StringHash eventType, VariantMap& eventData)
+	{
+		auto* item = static_cast<WorkItem*>(eventData[WorkItemCompleted::P_ITEM].GetPtr());
+
+		if (item->workFunction_ == SaveWork)
+		{
+			auto* save = static_cast<SpaceBoxCacheSave*>(item->aux_);
+			if (!saves_.Remove(save))
+				return;
+			URHO3D_LOGINFO("SpaceBoxCache: saved " + save->fileName);
+			delete save;
+			item->aux_ = nullptr;
+			saving_ = false;
+		}
+		else if (item->workFunction_ == OpenWork)
+		{
+			auto* load = static_cast<SpaceBoxCacheLoad*>(item->aux_);
+			if (!loads_.Contains(load))
+				return;
+			item->aux_ = nullptr;
+			--load->pendingWork;
+			if (load->cancelled)
+			{
+				if (!load->pendingWork)
+					ReleaseLoad(load);
+				return;
+			}
+			if (!load->valid)
+			{
+				FinishLoad(false);
+				return;
+			}
+
+			/*a map was converted on the worker, it goes up in one piece*/
+			if (load->mapping != SKY_CUBE)
+			{
+				SharedPtr<Texture2D> map = MakeShared<Texture2D>(context_);
+				map->SetNumLevels(1);
+				map->SetFilterMode(FILTER_BILINEAR);
+				map->SetAddressMode(COORD_U, load->mapping == SKY_EQUIRECT ? ADDRESS_WRAP : ADDRESS_CLAMP);
+				map->SetAddressMode(COORD_V, ADDRESS_CLAMP);
+				texture_ = map;
+				FinishLoad(map->SetSize(load->mapWidth, load->mapHeight, Graphics::GetRGBAFormat(), TEXTURE_STATIC) &&
+					map->SetData(0, 0, 0, load->mapWidth, load->mapHeight, &load->map[0]));
+				return;
+			}
+
+			/*storage is allocated now, the faces follow over the next frames*/
+			SharedPtr<TextureCube> cube = MakeShared<TextureCube>(context_);
+			cube->SetNumLevels(1);
+			texture_ = cube;
+			if (!cube->SetSize(load->header.size, Graphics::GetRGBAFormat(), TEXTURE_STATIC))
+			{
+				FinishLoad(false);
+				return;
+			}
+			nextFace_ = 0;
+			facesUploaded_ = 0;
+			QueueFaces();
+			if (nextFace_ < MAX_CUBEMAP_FACES)
+				SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(SpaceBoxCache, HandleBeginFrame));
+		}
+		else if (item->workFunction_ == CopyFaceWork)
+		{
+			auto* copy = static_cast<SpaceBoxFaceCopy*>(item->aux_);
+			if (!copies_.Contains(copy))
+				return;
+			item->aux_ = nullptr;
+
+			if (copy->load->cancelled)
+			{
+#ifdef URHO3D_OPENGL
+				if (copy->handle)
+					uploader_->Abort(copy->handle);
+#endif
+				ReleaseCopy(copy);
+				return;
+			}
+
+			const unsigned size = copy->load->header.size;
+			auto* cube = static_cast<TextureCube*>(texture_.Get());
+			bool uploaded;
+#ifdef URHO3D_OPENGL
+			if (copy->handle)
+				uploaded = uploader_->Upload(copy->handle, cube, (CubeMapFace)copy->face);
+			else
+#endif
+				uploaded = cube->SetData((CubeMapFace)copy->face, 0, 0, 0, size, size, copy->dest);
+			ReleaseCopy(copy);
+
+			if (!uploaded)
+				FinishLoad(false);
+			else if (++facesUploaded_ == MAX_CUBEMAP_FACES)
+				FinishLoad(true);
+		}
+	}
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Graphics/TextureCube.h>
+#include <Urho3D/Graphics/Texture2D.h>
+#include <Urho3D/Resource/Image.h>
+#include "SkyProjection.h"
+
+namespace Urho3D
+{
+	class TextureReadback;
+	class TextureUploader;
+	struct SpaceBoxCacheLoad;
+	struct SpaceBoxFaceCopy;
+	struct SpaceBoxCacheSave;
+
+	URHO3D_EVENT(E_SPACEBOXCACHELOADED, SpaceBoxCacheLoaded)
+	{
+		URHO3D_PARAM(P_SUCCESS, Success); // bool
+		URHO3D_PARAM(P_TEXTURE, Texture); // TextureCube ptr or Texture2D sky map, null on failure
+		URHO3D_PARAM(P_MAPPING, Mapping); // int SkyMapping of the texture
+		URHO3D_PARAM(P_SEED, Seed); // unsigned
+		URHO3D_PARAM(P_SUN_ENABLE, SunEnable); // bool
+		URHO3D_PARAM(P_SUN_DIR, SunDir); // vector3
+		URHO3D_PARAM(P_SUN_COLOR, SunColor); // color
+	}
+
+	/*what is stored next to the faces, so a loaded sky can restore the light*/
+	struct SpaceBoxCacheInfo
+	{
+		unsigned seed{ 0 };
+		bool sunEnable{ false };
+		Vector3 sunDirection;
+		Color sunColor;
+	};
+
+	/*
+	Baked skyboxes on disk: a small header followed by the six RGBA faces, uncompressed.
+	Load() memory-maps the file on a WorkQueue thread, then every frame maps pixel unpack buffers for
+	as many faces as fit in uploadBudget, copies the faces into them on worker threads and uploads
+	them when the copy completes. The new cube is only handed out (E_SPACEBOXCACHELOADED) when all six
+	faces are in, so the old sky stays visible until then. Without OpenGL faces go through SetData().
+	Files always hold a cube; 2D sky maps are converted on the worker when saving and loading (SkyProjection.h).
+	*/
+	class SpaceBoxCache : public Object
+	{
+		URHO3D_OBJECT(SpaceBoxCache, Object);
+	public:
+		explicit SpaceBoxCache(Context* context);
+		~SpaceBoxCache();
+
+		/*read back the cube faces and write them on a worker; returns false if a save is in progress*/
+		bool Save(TextureCube* cube, const String& fileName, const SpaceBoxCacheInfo& info);
+		/*read back a sky map, it is converted to cube faces on the worker*/
+		bool Save(Texture2D* map, SkyMapping mapping, const String& fileName, const SpaceBoxCacheInfo& info);
+		/*start loading, cancels a previous load; any other mapping than SKY_CUBE hands out a Texture2D, uploaded at once*/
+		void Load(const String& fileName, SkyMapping mapping = SKY_CUBE);
+		void Cancel();
+		bool IsLoading() const { return load_ != nullptr; }
+		bool IsSaving() const { return saving_; }
+
+		/*bytes mapped and uploaded per frame, at least one face is always taken*/
+		unsigned uploadBudget{ 16 * 1024 * 1024 };
+
+	private:
+		void QueueWork(void(*work)(const WorkItem*, unsigned), void* aux);
+		void QueueFaces();
+		void FinishLoad(bool success);
+		void ReleaseLoad(SpaceBoxCacheLoad* load);
+		void ReleaseCopy(SpaceBoxFaceCopy* copy);
+		void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+		void HandleWorkItemCompleted(StringHash eventType, VariantMap& eventData);
+		void HandleFaceRead(unsigned face, Image* image);
+
+		SharedPtr<TextureReadback> readback_;
+		SharedPtr<TextureUploader> uploader_;
+		/*jobs handed to the WorkQueue, also used to recognize our completions; loads_ keeps cancelled loads until their work is done*/
+		PODVector<SpaceBoxCacheLoad*> loads_;
+		PODVector<SpaceBoxFaceCopy*> copies_;
+		PODVector<SpaceBoxCacheSave*> saves_;
+
+		SpaceBoxCacheLoad* load_{ nullptr };
+		SharedPtr<Texture> texture_;
+		unsigned nextFace_{ 0 };
+		unsigned facesUploaded_{ 0 };
+		unsigned loadFrames_{ 0 };
+		HiresTimer loadTimer_;
+
+		bool saving_{ false };
+		String saveFileName_;
+		SpaceBoxCacheInfo saveInfo_;
+		SharedPtr<Image> saveFaces_[MAX_CUBEMAP_FACES];
+		SkyMapping saveMapping_{ SKY_CUBE };
+		unsigned numSaveFaces_{ 0 };
+	};
+}
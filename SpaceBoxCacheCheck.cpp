@@ -0,0 +1,187 @@
+#include "SpaceBoxCacheCheck.h"
+#include "SpaceBoxGen.h"
+#include <cstdio>
+#include <Urho3D/Urho3DAll.h>
+
+namespace Urho3D
+{
+	static const SkyMapping CHECK_MAPPINGS[] = { SKY_CUBE, SKY_OCTAHEDRAL, SKY_EQUIRECT };
+	static const char* MAPPING_NAMES[] = { "cube", "octahedral", "equirect" };
+	static const unsigned NUM_CHECK_MAPPINGS = sizeof(CHECK_MAPPINGS) / sizeof(CHECK_MAPPINGS[0]);
+	/*any seed, fixed so a failure can be reproduced*/
+	static const unsigned CHECK_SEED = 0x5b0c4e11;
+	/*CacheHeader in SpaceBoxCache.cpp: size, seed and sun, compared byte for byte*/
+	static const unsigned CACHE_HEADER_BYTES = 48;
+
+	SpaceBoxCacheCheck::SpaceBoxCacheCheck(Context* context, SpaceBoxGen* gen) : Object(context), gen_(gen)
+	{
+	}
+
+	void SpaceBoxCacheCheck::Start(const String& directory)
+	{
+		if (IsRunning() || !gen_)
+			return;
+		directory_ = AddTrailingSlash(directory);
+		GetSubsystem<FileSystem>()->CreateDir(directory_);
+		skyOutput_ = gen_->skyOutput;
+		liveMode_ = gen_->liveMode;
+		/*live mode always gives an octahedral map*/
+		gen_->liveMode = false;
+		index_ = 0;
+		numFailed_ = 0;
+		SubscribeToEvent(gen_, E_SPACEBOXREADY, URHO3D_HANDLER(SpaceBoxCacheCheck, HandleReady));
+		SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(SpaceBoxCacheCheck, HandleUpdate));
+		state_ = CHECK_STARTING;
+	}
+
+	String SpaceBoxCacheCheck::GetFileName(const char* suffix) const
+	{
+		return directory_ + "CacheCheck_" + MAPPING_NAMES[index_] + suffix + ".sbx";
+	}
+
+	void SpaceBoxCacheCheck::StartMapping()
+	{
+		gen_->skyOutput = CHECK_MAPPINGS[index_];
+		state_ = CHECK_GENERATING;
+		frames_ = 0;
+		gen_->Generate(CHECK_SEED);
+	}
+
+	void SpaceBoxCacheCheck::NextMapping(bool passed, const String& result)
+	{
+		const String text = String("SpaceBoxCacheCheck: ") + MAPPING_NAMES[index_] + (passed ? " passed, " : " FAILED, ") + result;
+		if (passed)
+			URHO3D_LOGINFO(text);
+		else
+		{
+			URHO3D_LOGERROR(text);
+			++numFailed_;
+		}
+
+		if (++index_ < NUM_CHECK_MAPPINGS)
+		{
+			state_ = CHECK_STARTING;
+			return;
+		}
+
+		state_ = CHECK_IDLE;
+		UnsubscribeFromEvent(gen_, E_SPACEBOXREADY);
+		UnsubscribeFromEvent(E_UPDATE);
+		gen_->skyOutput = skyOutput_;
+		gen_->liveMode = liveMode_;
+		if (numFailed_)
+			URHO3D_LOGERROR("SpaceBoxCacheCheck: " + String(numFailed_) + " of " + String(NUM_CHECK_MAPPINGS) + " mappings failed");
+		else
+			URHO3D_LOGINFO("SpaceBoxCacheCheck: all " + String(NUM_CHECK_MAPPINGS) + " mappings passed");
+		if (exitWhenDone)
+			GetSubsystem<Engine>()->Exit();
+	}
+
+	/*the final level of the generated sky, or the loaded sky*/
+	void SpaceBoxCacheCheck::HandleReady(StringHash eventType, VariantMap& eventData)
+	{
+		using namespace SpaceBoxReady;
+		if (!eventData[P_FINAL].GetBool())
+			return;
+
+		if (state_ == CHECK_GENERATING)
+		{
+			sun_ = gen_->HasSun();
+			sunDirection_ = gen_->GetSunDirection();
+			if (!gen_->SaveToCache(GetFileName("_A")))
+			{
+				NextMapping(false, "could not start saving the generated sky");
+				return;
+			}
+			state_ = CHECK_SAVING_GENERATED;
+			frames_ = 0;
+		}
+		else if (state_ == CHECK_LOADING)
+		{
+			const SkyMapping mapping = (SkyMapping)eventData[P_MAPPING].GetInt();
+			if (mapping != CHECK_MAPPINGS[index_] || gen_->GetSkyMapping() != mapping)
+			{
+				NextMapping(false, String("loaded as mapping ") + String((int)mapping));
+				return;
+			}
+			if (gen_->GetSeed() != CHECK_SEED || gen_->HasSun() != sun_ || gen_->GetSunDirection() != sunDirection_)
+			{
+				NextMapping(false, "seed or sun differ after loading");
+				return;
+			}
+			/*also goes through ReleaseScene and the readback of a static texture*/
+			if (!gen_->SaveToCache(GetFileName("_B")))
+			{
+				NextMapping(false, "could not start saving the loaded sky");
+				return;
+			}
+			state_ = CHECK_SAVING_LOADED;
+			frames_ = 0;
+		}
+	}
+
+	void SpaceBoxCacheCheck::HandleUpdate(StringHash eventType, VariantMap& eventData)
+	{
+		if (state_ == CHECK_STARTING)
+		{
+			StartMapping();
+			return;
+		}
+		if (++frames_ > timeoutFrames)
+		{
+			NextMapping(false, "timed out in step " + String((int)state_));
+			return;
+		}
+
+		if (state_ == CHECK_SAVING_GENERATED && !gen_->IsSaving())
+		{
+			state_ = CHECK_LOADING;
+			frames_ = 0;
+			gen_->LoadFromCache(GetFileName("_A"));
+		}
+		else if (state_ == CHECK_SAVING_LOADED && !gen_->IsSaving())
+		{
+			String result;
+			const bool passed = CompareFiles(result);
+			NextMapping(passed, result);
+		}
+	}
+
+	static bool ReadAll(Context* context, const String& fileName, PODVector<unsigned char>& out)
+	{
+		File file(context, fileName);
+		if (!file.IsOpen() || !file.GetSize())
+			return false;
+		out.Resize(file.GetSize());
+		return file.Read(&out[0], out.Size()) == out.Size();
+	}
+
+	bool SpaceBoxCacheCheck::CompareFiles(String& result) const
+	{
+		PODVector<unsigned char> a, b;
+		if (!ReadAll(context_, GetFileName("_A"), a) || !ReadAll(context_, GetFileName("_B"), b))
+		{
+			result = "a file was not written";
+			return false;
+		}
+		if (a.Size() != b.Size() || a.Size() < CACHE_HEADER_BYTES || memcmp(&a[0], &b[0], CACHE_HEADER_BYTES) != 0)
+		{
+			result = "headers or sizes differ (" + String(a.Size()) + " and " + String(b.Size()) + " bytes)";
+			return false;
+		}
+
+		unsigned long long sum = 0;
+		int maxDifference = 0;
+		for (unsigned ii = CACHE_HEADER_BYTES; ii < a.Size(); ++ii)
+		{
+			const int d = Abs((int)a[ii] - (int)b[ii]);
+			sum += d;
+			maxDifference = Max(maxDifference, d);
+		}
+		const double mean = (double)sum / (a.Size() - CACHE_HEADER_BYTES);
+		char text[128];
+		snprintf(text, sizeof(text), "%u bytes, mean difference %.3f, max %d", a.Size(), mean, maxDifference);
+		result = text;
+		return CHECK_MAPPINGS[index_] == SKY_CUBE ? sum == 0 : mean <= maxMeanDifference;
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <Urho3D/Core/Object.h>
+#include "SkyProjection.h"
+
+namespace Urho3D
+{
+	class SpaceBoxGen;
+
+	/*
+	Saves and reloads a generated sky once per mapping (cube, octahedral, equirectangular) and checks the round trip:
+	generate with a fixed seed, save to A, load A, compare seed, sun and mapping, save the loaded sky to B, compare
+	A and B. Cube files must be identical; maps are resampled on both save and load, so their faces may differ by a
+	small mean. Runs on the generator of the sample, which should not be asked for other skies meanwhile.
+	*/
+	class SpaceBoxCacheCheck : public Object
+	{
+		URHO3D_OBJECT(SpaceBoxCacheCheck, Object);
+	public:
+		SpaceBoxCacheCheck(Context* context, SpaceBoxGen* gen);
+
+		/*files are written to directory; results are logged, the engine stops when done if exitWhenDone*/
+		void Start(const String& directory);
+		bool IsRunning() const { return state_ != CHECK_IDLE; }
+		unsigned GetNumFailed() const { return numFailed_; }
+
+		bool exitWhenDone{ true };
+		/*mean absolute difference per channel allowed between A and B of a map, in 8 bit steps*/
+		float maxMeanDifference{ 2.0f };
+		/*frames a step may take before the mapping counts as failed*/
+		unsigned timeoutFrames{ 1200 };
+
+	private:
+		enum CheckState
+		{
+			CHECK_IDLE = 0,
+			/*the next mapping starts on the next update, never from inside the generator's events*/
+			CHECK_STARTING,
+			CHECK_GENERATING,
+			CHECK_SAVING_GENERATED,
+			CHECK_LOADING,
+			CHECK_SAVING_LOADED
+		};
+
+		void StartMapping();
+		void NextMapping(bool passed, const String& result);
+		bool CompareFiles(String& result) const;
+		String GetFileName(const char* suffix) const;
+		void HandleReady(StringHash eventType, VariantMap& eventData);
+		void HandleUpdate(StringHash eventType, VariantMap& eventData);
+
+		WeakPtr<SpaceBoxGen> gen_;
+		String directory_;
+		CheckState state_{ CHECK_IDLE };
+		unsigned index_{ 0 };
+		unsigned frames_{ 0 };
+		unsigned numFailed_{ 0 };
+		/*the generator's switches before the check, restored after it*/
+		SkyMapping skyOutput_{ SKY_CUBE };
+		bool liveMode_{ false };
+		/*what the generated sky had, the loaded one must match*/
+		bool sun_{ false };
+		Vector3 sunDirection_;
+	};
+}
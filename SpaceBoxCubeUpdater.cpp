@@ -0,0 +1,306 @@
+#include "SpaceBoxCubeUpdater.h"
+#include "SpaceBoxMapRenderer.h"
+#include "SpaceBoxPool.h"
+#include <Urho3D/Urho3DAll.h>
+
+namespace Urho3D
+{
+	/*boundary samples when projecting a cap onto a face, and texels added around the result*/
+	static const unsigned CAP_SAMPLES = 64;
+	static const int DIRTY_PADDING = 2;
+
+	SpaceBoxCubeUpdater::SpaceBoxCubeUpdater(Context* context, Scene* scene, TextureCube* cube, const SharedPtr<Node>* cameraNodes) :
+		Object(context),
+		scene_(scene),
+		cube_(cube)
+	{
+		for (unsigned ii = 0; ii < MAX_CUBEMAP_FACES; ++ii)
+			cameraNodes_[ii] = cameraNodes[ii];
+	}
+
+	void SpaceBoxCubeUpdater::StartAnimation(int grid)
+	{
+		auto* cache = GetSubsystem<ResourceCache>();
+		const int tileSize = cube_->GetWidth() / grid;
+		for (unsigned ii = 0; ii < MAX_CUBEMAP_FACES; ++ii)
+		{
+			tiles_[ii].Clear();
+			for (int y = 0; y < grid; ++y)
+			{
+				for (int x = 0; x < grid; ++x)
+				{
+					/*zoom in on the tile and shift it to the center of its viewport*/
+					Camera* camera = cameraNodes_[ii]->GetComponent<Camera>();
+					if (grid > 1)
+					{
+						camera = cameraNodes_[ii]->CreateComponent<Camera>();
+						camera->SetFarClip(256.0f);
+						camera->SetAspectRatio(1.0f);
+						camera->SetFov(90.0f);
+						camera->SetZoom((float)grid);
+#ifdef URHO3D_OPENGL
+						/*texture rendering is vertically flipped on OpenGL, the top viewport row holds the bottom of the image*/
+						const float centerY = -1.0f + (2.0f * y + 1.0f) / grid;
+#else
+						const float centerY = 1.0f - (2.0f * y + 1.0f) / grid;
+#endif
+						const Vector2 center(-1.0f + (2.0f * x + 1.0f) / grid, centerY);
+						camera->SetProjectionOffset(-center * (0.5f * grid));
+					}
+					SharedPtr<Viewport> v(new Viewport(context_, scene_, camera,
+						IntRect(x * tileSize, y * tileSize, (x + 1) * tileSize, (y + 1) * tileSize)));
+					v->SetRenderPath(cache->GetResource<XMLFile>("RenderPaths/SpaceBox.xml"));
+					tiles_[ii].Push(v);
+				}
+			}
+			cube_->GetRenderSurface((CubeMapFace)ii)->SetUpdateMode(SURFACE_MANUALUPDATE);
+		}
+		nextTile_ = 0;
+	}
+
+	/*cache the point stars in their own cube, so changed regions can be recomposited without them*/
+	bool SpaceBoxCubeUpdater::StartLayers(SpaceBoxPool* pool, Model* box)
+	{
+		auto* cache = GetSubsystem<ResourceCache>();
+		SharedPtr<TextureCube> base = pool->AcquireCube(cube_->GetWidth(), Graphics::GetRGBAFormat(), false);
+		if (!base)
+		{
+			URHO3D_LOGERROR(String("SpaceBoxCubeUpdater: base cube SetSize fail: size=") + String(cube_->GetWidth()));
+			return false;
+		}
+		baseCube_ = base;
+		baseCube_->SetFilterMode(FILTER_NEAREST);
+		for (unsigned ii = 0; ii < MAX_CUBEMAP_FACES; ++ii)
+		{
+			RenderSurface* s = baseCube_->GetRenderSurface((CubeMapFace)ii);
+			s->SetUpdateMode(SURFACE_MANUALUPDATE);
+			SharedPtr<Viewport> v(new Viewport(context_, scene_, cameraNodes_[ii]->GetComponent<Camera>()));
+			v->SetRenderPath(cache->GetResource<XMLFile>("RenderPaths/SpaceBoxBase.xml"));
+			s->SetNumViewports(1);
+			s->SetViewport(0, v);
+			s->QueueUpdate();
+			cube_->GetRenderSurface((CubeMapFace)ii)->SetUpdateMode(SURFACE_MANUALUPDATE);
+			dirty_[ii].Clear();
+		}
+
+		/*a box showing the cached layer, drawn by the base pass of SpaceBoxLayered.xml in place of the point stars*/
+		baseNode_ = scene_->CreateChild(String("base layer"));
+		StaticModel* baseObject = baseNode_->CreateComponent<StaticModel>();
+		baseObject->SetModel(box);
+		SharedPtr<Material> m = MakeShared<Material>(context_);
+		m->SetCullMode(CULL_NONE);
+		m->SetNumTechniques(1);
+		m->SetTechnique(0, cache->GetResource<Technique>("Techniques/SpaceBoxBase.xml"));
+		m->SetTexture(TU_DIFFUSE, baseCube_);
+		baseObject->SetMaterial(m);
+		return true;
+	}
+
+	static bool Overlaps(const IntRect& a, const IntRect& b)
+	{
+		return a.left_ < b.right_ && b.left_ < a.right_ && a.top_ < b.bottom_ && b.top_ < a.bottom_;
+	}
+
+	static void MergeRect(IntRect& a, const IntRect& b)
+	{
+		a.left_ = Min(a.left_, b.left_);
+		a.top_ = Min(a.top_, b.top_);
+		a.right_ = Max(a.right_, b.right_);
+		a.bottom_ = Max(a.bottom_, b.bottom_);
+	}
+
+	/*add the rectangles a cap of directions covers on each face*/
+	void SpaceBoxCubeUpdater::MarkDirty(const Vector3& direction, float radius)
+	{
+		if (!baseCube_)
+			return;
+		const int size = cube_->GetWidth();
+		for (unsigned ii = 0; ii < MAX_CUBEMAP_FACES; ++ii)
+		{
+			IntRect rect;
+			if (!ProjectCap(ii, direction, radius, size, rect))
+				continue;
+
+			/*merge with an overlapping rectangle; keep at most two per face*/
+			bool merged = false;
+			for (unsigned jj = 0; jj < dirty_[ii].Size() && !merged; ++jj)
+			{
+				if (Overlaps(dirty_[ii][jj], rect))
+				{
+					MergeRect(dirty_[ii][jj], rect);
+					merged = true;
+				}
+			}
+			if (!merged)
+			{
+				if (dirty_[ii].Size() < MAX_DIRTY_RECTS)
+					dirty_[ii].Push(rect);
+				else
+					MergeRect(dirty_[ii].Back(), rect);
+			}
+		}
+	}
+
+	/*radius in degrees*/
+	bool SpaceBoxCubeUpdater::ProjectCap(unsigned face, const Vector3& direction, float radius, int size, IntRect& rect) const
+	{
+		const float cosRadius = Cos(radius);
+		const Matrix3 view = cameraNodes_[face]->GetWorldRotation().Inverse().RotationMatrix();
+		const Vector3 dir = direction.Normalized();
+
+		if (radius >= 90.0f)
+		{
+			/*a hemisphere or more: do not bother*/
+			rect = IntRect(0, 0, size, size);
+			return true;
+		}
+
+		/*a face corner or the face center inside the cap*/
+		bool intersects = false;
+		const Vector3 corners[5] = { Vector3(-1, -1, 1), Vector3(1, -1, 1), Vector3(-1, 1, 1), Vector3(1, 1, 1), Vector3(0, 0, 1) };
+		const Matrix3 toWorld = view.Transpose();
+		for (unsigned ii = 0; ii < 5 && !intersects; ++ii)
+			intersects = (toWorld * corners[ii]).Normalized().DotProduct(dir) >= cosRadius;
+
+		/*boundary circle of the cap*/
+		const Vector3 t1 = dir.CrossProduct(Abs(dir.y_) < 0.9f ? Vector3::UP : Vector3::RIGHT).Normalized();
+		const Vector3 t2 = dir.CrossProduct(t1);
+		const float sinRadius = Sin(radius);
+		bool behind = false;
+		Rect bounds(M_INFINITY, M_INFINITY, -M_INFINITY, -M_INFINITY);
+
+		Vector3 center = view * dir;
+		if (center.z_ > M_EPSILON)
+		{
+			const Vector2 p(center.x_ / center.z_, center.y_ / center.z_);
+			bounds.Merge(p);
+			intersects = intersects || (Abs(p.x_) <= 1.0f && Abs(p.y_) <= 1.0f);
+		}
+		for (unsigned ii = 0; ii < CAP_SAMPLES; ++ii)
+		{
+			const float angle = 360.0f * ii / CAP_SAMPLES;
+			const Vector3 b = view * (dir * cosRadius + (t1 * Cos(angle) + t2 * Sin(angle)) * sinRadius);
+			if (b.z_ <= M_EPSILON)
+			{
+				behind = true;
+				continue;
+			}
+			const Vector2 p(b.x_ / b.z_, b.y_ / b.z_);
+			bounds.Merge(p);
+			intersects = intersects || (Abs(p.x_) <= 1.0f && Abs(p.y_) <= 1.0f);
+		}
+
+		if (!intersects)
+			return false;
+		/*part of the cap is behind the face plane, its projection is unbounded*/
+		if (behind)
+		{
+			rect = IntRect(0, 0, size, size);
+			return true;
+		}
+
+		bounds.min_.x_ = Clamp(bounds.min_.x_, -1.0f, 1.0f);
+		bounds.min_.y_ = Clamp(bounds.min_.y_, -1.0f, 1.0f);
+		bounds.max_.x_ = Clamp(bounds.max_.x_, -1.0f, 1.0f);
+		bounds.max_.y_ = Clamp(bounds.max_.y_, -1.0f, 1.0f);
+		const float half = 0.5f * size;
+		rect.left_ = FloorToInt((bounds.min_.x_ + 1.0f) * half) - DIRTY_PADDING;
+		rect.right_ = CeilToInt((bounds.max_.x_ + 1.0f) * half) + DIRTY_PADDING;
+#ifdef URHO3D_OPENGL
+		/*texture rendering is vertically flipped on OpenGL, the top viewport row holds the bottom of the image*/
+		rect.top_ = FloorToInt((bounds.min_.y_ + 1.0f) * half) - DIRTY_PADDING;
+		rect.bottom_ = CeilToInt((bounds.max_.y_ + 1.0f) * half) + DIRTY_PADDING;
+#else
+		rect.top_ = FloorToInt((1.0f - bounds.max_.y_) * half) - DIRTY_PADDING;
+		rect.bottom_ = CeilToInt((1.0f - bounds.min_.y_) * half) + DIRTY_PADDING;
+#endif
+		rect.left_ = Max(rect.left_, 0);
+		rect.top_ = Max(rect.top_, 0);
+		rect.right_ = Min(rect.right_, size);
+		rect.bottom_ = Min(rect.bottom_, size);
+		return rect.Width() > 0 && rect.Height() > 0;
+	}
+
+	bool SpaceBoxCubeUpdater::Collect(unsigned tilesPerFrame)
+	{
+		bool roundStart = false;
+		if (IsAnimating())
+		{
+			const unsigned numTiles = tiles_[0].Size() * MAX_CUBEMAP_FACES;
+			roundStart = nextTile_ == 0;
+			/*consecutive tiles are on different faces, so up to six tiles fit in one update of each surface*/
+			for (unsigned ii = 0; ii < tilesPerFrame && nextTile_ < numTiles; ++ii, ++nextTile_)
+				faceViews_[nextTile_ % MAX_CUBEMAP_FACES].Push(tiles_[nextTile_ % MAX_CUBEMAP_FACES][nextTile_ / MAX_CUBEMAP_FACES]);
+			if (nextTile_ == numTiles)
+				nextTile_ = 0;
+		}
+
+		if (!baseCube_)
+			return roundStart;
+		auto* cache = GetSubsystem<ResourceCache>();
+		const int size = cube_->GetWidth();
+		for (unsigned ii = 0; ii < MAX_CUBEMAP_FACES; ++ii)
+		{
+			for (unsigned jj = 0; jj < dirty_[ii].Size(); ++jj)
+			{
+				const unsigned slot = ii * MAX_DIRTY_RECTS + jj;
+				if (!dirtyViews_[slot])
+				{
+					Camera* camera = cameraNodes_[ii]->CreateComponent<Camera>();
+					dirtyViews_[slot] = new Viewport(context_, scene_, camera);
+					dirtyViews_[slot]->SetRenderPath(cache->GetResource<XMLFile>("RenderPaths/SpaceBoxLayered.xml"));
+				}
+				FitCameraToRect(dirtyViews_[slot]->GetCamera(), dirty_[ii][jj], size);
+				dirtyViews_[slot]->SetRect(dirty_[ii][jj]);
+				faceViews_[ii].Push(dirtyViews_[slot]);
+			}
+			dirty_[ii].Clear();
+		}
+		return roundStart;
+	}
+
+	bool SpaceBoxCubeUpdater::HasViews() const
+	{
+		for (unsigned ii = 0; ii < MAX_CUBEMAP_FACES; ++ii)
+		{
+			if (!faceViews_[ii].Empty())
+				return true;
+		}
+		return false;
+	}
+
+	void SpaceBoxCubeUpdater::Submit()
+	{
+		for (unsigned ii = 0; ii < MAX_CUBEMAP_FACES; ++ii)
+		{
+			RenderSurface* s = cube_->GetRenderSurface((CubeMapFace)ii);
+			s->SetNumViewports(faceViews_[ii].Size());
+			for (unsigned jj = 0; jj < faceViews_[ii].Size(); ++jj)
+				s->SetViewport(jj, faceViews_[ii][jj]);
+			if (!faceViews_[ii].Empty())
+				s->QueueUpdate();
+			faceViews_[ii].Clear();
+		}
+	}
+
+	void SpaceBoxCubeUpdater::Release()
+	{
+		/*only this object's viewports are on the faces, also when the generator has replaced SpaceCube meanwhile*/
+		for (unsigned ii = 0; ii < MAX_CUBEMAP_FACES; ++ii)
+		{
+			cube_->GetRenderSurface((CubeMapFace)ii)->SetNumViewports(0);
+			if (baseCube_)
+				baseCube_->GetRenderSurface((CubeMapFace)ii)->SetNumViewports(0);
+			tiles_[ii].Clear();
+			dirty_[ii].Clear();
+			faceViews_[ii].Clear();
+		}
+		for (unsigned ii = 0; ii < MAX_CUBEMAP_FACES * MAX_DIRTY_RECTS; ++ii)
+			dirtyViews_[ii] = nullptr;
+		baseCube_ = nullptr;
+		if (baseNode_)
+			baseNode_->Remove();
+		baseNode_ = nullptr;
+		nextTile_ = 0;
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Graphics/TextureCube.h>
+
+namespace Urho3D
+{
+	class Model;
+	class Node;
+	class Scene;
+	class SpaceBoxPool;
+	class Viewport;
+
+	/*separate rectangles kept per face for partial updates, more are merged*/
+	static const unsigned MAX_DIRTY_RECTS = 2;
+
+	/*
+	Keeps a finished cube up to date from the generator's scene: animateNebula re-renders it a few tiles per frame,
+	dynamicLayers caches the point stars in a base cube so a moved sun or star re-renders only the rectangles it
+	covers. It holds the cube it was started on and owns every viewport on its faces, the base cube and its box;
+	Release() detaches them, the cube itself stays valid as the sky.
+	*/
+	class SpaceBoxCubeUpdater : public Object
+	{
+		URHO3D_OBJECT(SpaceBoxCubeUpdater, Object);
+	public:
+		/*cameraNodes look at the six faces in the scene, as set up by the generator*/
+		SpaceBoxCubeUpdater(Context* context, Scene* scene, TextureCube* cube, const SharedPtr<Node>* cameraNodes);
+
+		/*split every face into grid^2 tiles, refreshed in turn by Collect*/
+		void StartAnimation(int grid);
+		/*render the point stars once into a cube from pool, drawn in their place by a box of the given model*/
+		bool StartLayers(SpaceBoxPool* pool, Model* box);
+		/*re-render the rectangles a cap of directions covers on each face; radius in degrees*/
+		void MarkDirty(const Vector3& direction, float radius);
+		/*the next tiles and the dirty rectangles become the views of the next frame; true when the tiles start a new
+		round, the caller sets the time of that round before the frame renders*/
+		bool Collect(unsigned tilesPerFrame);
+		bool HasViews() const;
+		/*queue the collected views on the faces*/
+		void Submit();
+		void Release();
+
+		bool IsAnimating() const { return !tiles_[0].Empty(); }
+		bool HasLayers() const { return baseCube_ != nullptr; }
+
+	private:
+		bool ProjectCap(unsigned face, const Vector3& direction, float radius, int size, IntRect& rect) const;
+
+		WeakPtr<Scene> scene_;
+		SharedPtr<TextureCube> cube_;
+		SharedPtr<Node> cameraNodes_[MAX_CUBEMAP_FACES];
+		Vector<SharedPtr<Viewport> > tiles_[MAX_CUBEMAP_FACES];
+		unsigned nextTile_{ 0 };
+		SharedPtr<TextureCube> baseCube_;
+		SharedPtr<Node> baseNode_;
+		PODVector<IntRect> dirty_[MAX_CUBEMAP_FACES];
+		SharedPtr<Viewport> dirtyViews_[MAX_CUBEMAP_FACES * MAX_DIRTY_RECTS];
+		/*what Collect gathered for Submit*/
+		PODVector<Viewport*> faceViews_[MAX_CUBEMAP_FACES];
+	};
+}
@@ -1,5 +1,9 @@
 #include "SpaceBoxGen.h"
+#include "ShaderWarmup.h"
 #include <Urho3D/Urho3DAll.h>
+#ifdef URHO3D_OPENGL
+#include <Urho3D/Graphics/OpenGL/OGLGPUMemory.h>
+#endif
 
 namespace Urho3D
 {
@@ -9,7 +13,34 @@ namespace Urho3D
 		unsigned color;
 	}vertex_data;
 
-	static void buildStar(float size, const Vector3 &pos, float dist, vertex_data * vertexBufferOut)
+	/*independent stream per layer, so toggling one layer does not change the others*/
+	enum SpaceRandomStream
+	{
+		STREAM_POINT_STARS = 0,
+		STREAM_BRIGHT_STARS,
+		STREAM_NEBULA,
+		STREAM_SUN
+	};
+
+	/*parameter names built once; a literal would construct a String on every set, NebularTime and the positions are set per frame*/
+	static const String PARAM_STAR_POSITION("StarPosition");
+	static const String PARAM_STAR_COLOR("StarColor");
+	static const String PARAM_STAR_SIZE("StarSize");
+	static const String PARAM_STAR_FALLOFF("StarFalloff");
+	static const String PARAM_NEBULAR_COLOR("NebularColor");
+	static const String PARAM_NEBULAR_OFFSET("NebularOffset");
+	static const String PARAM_NEBULAR_SCALE("NebularScale");
+	static const String PARAM_NEBULAR_INTENSITY("NebularIntensity");
+	static const String PARAM_NEBULAR_FALLOFF("NebularFalloff");
+	static const String PARAM_NEBULAR_TIME("NebularTime");
+	static const String PARAM_NEBULA_SIZE("NebulaSize");
+	static const String PARAM_SUN_POSITION("SunPosition");
+	static const String PARAM_SUN_COLOR("SunColor");
+	static const String PARAM_SUN_SIZE("SunSize");
+	static const String PARAM_SUN_FALLOFF("SunFalloff");
+	static const String SUN_MATERIAL("Materials/sun.xml");
+
+	static void buildStar(float size, const Vector3 &pos, float dist, float brightness, vertex_data * vertexBufferOut)
 	{
 		const Vector3 vertexes[6] =
 		{
@@ -32,7 +63,7 @@ namespace Urho3D
 			v = (q * vertexes[ii]) + (pos * dist);
 		}
 
-		float c = Pow(Random(1.0f), 4.0f);
+		float c = Pow(brightness, 4.0f);
 		Color allColor(c, c, c, 1.0f);
 		for (unsigned ii = 0; ii < 6; ++ii)
 		{
@@ -40,22 +71,133 @@ namespace Urho3D
 		}
 	}
 
-	static Model * Create_Point_Stars(Context* ctx)
+	static const unsigned NUM_POINT_STARS = 100000;
+	/*vertex and index data of the point star model*/
+	static const unsigned long long POINT_STAR_BYTES = NUM_POINT_STARS * 6ULL * (sizeof(vertex_data) + sizeof(unsigned));
+	/*the budget never shrinks a sky below this*/
+	static const int MIN_BUDGET_SIZE = 64;
+
+	/*everything Generate() derives from the seed; filled by a worker, Urho3D objects are only created on the main thread*/
+	struct PrepStar
+	{
+		Vector3 direction;
+		float falloff;
+	};
+
+	struct PrepNebula
+	{
+		/*color, offset, scale, intensity, falloff in [0, 1)*/
+		float r[9];
+	};
+
+	struct SpaceBoxPrep
+	{
+		unsigned seed;
+		bool point_star_enable;
+		bool bright_star_enable;
+		bool nebula_enable;
+		bool sun_enable;
+		/*read at Generate() like the layer switches; ChooseSize() used the same values*/
+		bool liveMode;
+		float nebulaResolution;
+		int nebulaSteps;
+		int previewSize;
+
+		PODVector<vertex_data> starVertices;
+		PODVector<unsigned> starIndices;
+		BoundingBox starBounds;
+		/*one rotated copy of the point stars each*/
+		PODVector<Quaternion> starLayers;
+		PODVector<PrepStar> brightStars;
+		PODVector<PrepNebula> nebulae;
+		Vector3 sunDirection;
+		Color sunColor;
+		float sunSize{ 0.0f };
+		float sunFalloff{ 0.0f };
+	};
+
+	static void Build_Point_Stars(SpaceRandom& rng, SpaceBoxPrep& prep)
+	{
+		const unsigned numVertices = NUM_POINT_STARS * 6;
+		prep.starVertices.Resize(numVertices);
+		prep.starIndices.Resize(numVertices);
+		PODVector<Vector3> positions(NUM_POINT_STARS);
+		PODVector<float> brightness(NUM_POINT_STARS);
+
+		rng.FillUnitVectors(&positions[0], NUM_POINT_STARS);
+		rng.FillUniform(&brightness[0], NUM_POINT_STARS);
+		for (unsigned int i = 0; i < NUM_POINT_STARS; ++i)
+			buildStar(0.05f, positions[i], 128.0f, brightness[i], &prep.starVertices[i * 6]);
+
+		for (unsigned int i = 0; i < numVertices; ++i)
+			prep.starIndices[i] = i;
+
+		prep.starBounds.Define(prep.starVertices[0].position);
+		for (unsigned int i = 1; i < numVertices; ++i)
+			prep.starBounds.Merge(prep.starVertices[i].position);
+	}
+
+	/*worker: the same random streams in the same order as always, so a seed still gives the same sky*/
+	static void PrepareWork(const WorkItem* item, unsigned threadIndex)
 	{
-		const unsigned int NSTARS = 100000;
-		const unsigned numVertices = NSTARS * 6;
-		vertex_data * vertexData = new vertex_data[numVertices];
-		unsigned  * indexData = new unsigned[numVertices];
+		auto* prep = static_cast<SpaceBoxPrep*>(item->aux_);
+		SpaceRandom rng(prep->seed, STREAM_POINT_STARS);
+		Build_Point_Stars(rng, *prep);
+		Quaternion accumulate(Quaternion::IDENTITY);
+		while (prep->point_star_enable)
+		{
+			Quaternion x_rotate(rng.Next(0.0f, 180.0f), Vector3::RIGHT);
+			Quaternion y_rotate(rng.Next(0.0f, 180.0f), Vector3::UP);
+			Quaternion z_rotate(rng.Next(0.0f, 180.0f), Vector3::FORWARD);
+			Quaternion q(x_rotate * y_rotate * z_rotate);
+
+			accumulate = q * accumulate;
+			prep->starLayers.Push(accumulate);
 
-		for (unsigned int i = 0; i < NSTARS; ++i)
+			if (rng.Next(1.0f) < 0.2f)
+				break;
+		}
+
+		rng.Seed(prep->seed, STREAM_BRIGHT_STARS);
+		while (prep->bright_star_enable)
 		{
-			Vector3 pos(Random(-1.0f, 1.0f), Random(-1.0f, 1.0f), Random(-1.0f, 1.0f));
-			pos.Normalize();
-			buildStar(0.05f, pos, 128.0f, &(vertexData[i * 6]));
+			PrepStar star;
+			rng.FillUnitVectors(&star.direction, 1);
+			star.falloff = rng.Next(1.0f) * Pow(2, 20) + Pow(2, 20);
+			prep->brightStars.Push(star);
+
+			if (rng.Next(1.0f) < 0.01f)
+				break;
 		}
 
-		for (unsigned int i = 0; i < numVertices; ++i)
-			indexData[i] = i;
+		rng.Seed(prep->seed, STREAM_NEBULA);
+		while (prep->nebula_enable)
+		{
+			/*draw in a fixed order, argument evaluation order is unspecified*/
+			PrepNebula nebula;
+			rng.FillUniform(nebula.r, 9);
+			prep->nebulae.Push(nebula);
+
+			if (rng.Next(1.0f) < 0.5f)
+				break;
+		}
+
+		if (prep->sun_enable)
+		{
+			rng.Seed(prep->seed, STREAM_SUN);
+			rng.FillUnitVectors(&prep->sunDirection, 1);
+			float c[3];
+			rng.FillUniform(c, 3);
+			prep->sunColor = Color(c[0], c[1], c[2]);
+			prep->sunSize = rng.Next(1.0f) * 0.0001f + 0.0001f;
+			prep->sunFalloff = rng.Next(1.0f) * 16 + 8;
+		}
+	}
+
+	/*main thread: only the upload is left*/
+	static Model * Create_Point_Stars(Context* ctx, const SpaceBoxPrep& prep)
+	{
+		const unsigned numVertices = prep.starVertices.Size();
 
 		Model * fromScratchModel(new Model(ctx));
 		VertexBuffer * vb(new VertexBuffer(ctx));
@@ -70,11 +212,11 @@ namespace Urho3D
 		elements.Push(VertexElement(TYPE_VECTOR3, SEM_POSITION));
 		elements.Push(VertexElement(TYPE_UBYTE4_NORM, SEM_COLOR));
 		vb->SetSize(numVertices, elements);
-		vb->SetData(vertexData);
+		vb->SetData(&prep.starVertices[0]);
 
 		ib->SetShadowed(true);
 		ib->SetSize(numVertices, true);
-		ib->SetData(indexData);
+		ib->SetData(&prep.starIndices[0]);
 
 		geom->SetVertexBuffer(0, vb);
 		geom->SetIndexBuffer(ib);
@@ -82,14 +224,7 @@ namespace Urho3D
 
 		fromScratchModel->SetNumGeometries(1);
 		fromScratchModel->SetGeometry(0, 0, geom);
-		BoundingBox BB;
-		BB.Define(vertexData[0].position);
-		for (unsigned int i = 1; i < numVertices; ++i)
-			BB.Merge(vertexData[i].position);
-		fromScratchModel->SetBoundingBox(BB);
-
-		delete[] vertexData;
-		delete[] indexData;
+		fromScratchModel->SetBoundingBox(prep.starBounds);
 
 		return fromScratchModel;
 	}
@@ -178,12 +313,82 @@ namespace Urho3D
 		return fromScratchModel;
 	}
 
-	SpaceBoxGen::SpaceBoxGen(Context* context) : Object(context), SpaceCube(MakeShared<TextureCube>(context)) {}
+	SpaceBoxGen::SpaceBoxGen(Context* context) : Object(context), SpaceCube(MakeShared<TextureCube>(context)),
+		pool_(SpaceBoxPool::Get(context)), seedSource_(Rand(), Rand())
+	{
+		SubscribeToEvent(E_WORKITEMCOMPLETED, URHO3D_HANDLER(SpaceBoxGen, HandleWorkItemCompleted));
+	}
 
-	SpaceBoxGen::~SpaceBoxGen(){}
+	SpaceBoxGen::~SpaceBoxGen()
+	{
+		/*workers may still be filling the packages*/
+		if (preps_.Empty())
+			return;
+		GetSubsystem<WorkQueue>()->Complete(0);
+		for (unsigned i = 0; i < preps_.Size(); ++i)
+			delete preps_[i];
+	}
 
 	void SpaceBoxGen::Generate()
 	{
+		Generate(seedSource_.NextUInt());
+	}
+
+	void SpaceBoxGen::Generate(unsigned seed)
+	{
+		if (cache_)
+			cache_->Cancel();
+		ReleaseScene();
+		genTimer_.Reset();
+		seed_ = seed;
+		ChooseSize();
+
+		/*geometry and parameters are derived on a worker, the scene is built when they are ready*/
+		prep_ = new SpaceBoxPrep();
+		prep_->seed = seed;
+		prep_->point_star_enable = point_star_enable;
+		prep_->bright_star_enable = bright_star_enable;
+		prep_->nebula_enable = nebula_enable;
+		prep_->sun_enable = sun_enable;
+		prep_->liveMode = liveMode;
+		prep_->nebulaResolution = nebulaResolution;
+		prep_->nebulaSteps = nebulaSteps;
+		prep_->previewSize = previewSize;
+		preps_.Push(prep_);
+
+		auto* queue = GetSubsystem<WorkQueue>();
+		SharedPtr<WorkItem> item = queue->GetFreeItem();
+		item->priority_ = 0;
+		item->workFunction_ = PrepareWork;
+		item->aux_ = prep_;
+		item->sendEvent_ = true;
+		queue->AddWorkItem(item);
+	}
+
+	void SpaceBoxGen::HandleWorkItemCompleted(StringHash eventType, VariantMap& eventData)
+	{
+		auto* item = static_cast<WorkItem*>(eventData[WorkItemCompleted::P_ITEM].GetPtr());
+		if (item->workFunction_ != PrepareWork)
+			return;
+		auto* prep = static_cast<SpaceBoxPrep*>(item->aux_);
+		if (!preps_.Remove(prep))
+			return;
+		item->aux_ = nullptr;
+
+		/*an older Generate() or a Cancel() superseded it*/
+		if (prep == prep_)
+		{
+			prep_ = nullptr;
+			BuildScene(*prep);
+		}
+		delete prep;
+	}
+
+	/*main thread: upload the buffers, create nodes, materials and cameras, queue the first surfaces*/
+	void SpaceBoxGen::BuildScene(const SpaceBoxPrep& prep)
+	{
+		timeToPrepare_ = genTimer_.GetUSec(false);
+		const int size = budget_.size;
 		auto* cache = GetSubsystem<ResourceCache>();
 		// Create the scene which will be rendered to a texture
 		rttScene_ = new Scene(context_);
@@ -201,77 +406,112 @@ namespace Urho3D
 		zone->SetFogStart(10.0f);
 		zone->SetFogEnd(100.0f);
 
-		point_stars = Create_Point_Stars(GetContext());
-		Quaternion accumulate(Quaternion::IDENTITY);
-		while (point_star_enable)
+		point_stars = Create_Point_Stars(GetContext(), prep);
+		for (unsigned ii = 0; ii < prep.starLayers.Size(); ++ii)
 		{
-			Quaternion x_rotate(Random(0.0f, 180.0f), Vector3::RIGHT);
-			Quaternion y_rotate(Random(0.0f, 180.0f), Vector3::UP);
-			Quaternion z_rotate(Random(0.0f, 180.0f), Vector3::FORWARD);
-			Quaternion q(x_rotate * y_rotate * z_rotate);
-
-			accumulate = q * accumulate;
 			Node * pstar = rttScene_->CreateChild(String("point stars"));
-			pstar->SetTransform(Vector3::ZERO, accumulate);
+			pstar->SetTransform(Vector3::ZERO, prep.starLayers[ii]);
 			StaticModel* pstarObject = pstar->CreateComponent<StaticModel>();
 			pstarObject->SetModel(point_stars);
 			pstarObject->SetMaterial(cache->GetResource<Material>("Materials/point_stars.xml"));
-
-			if (Random(1.0f) < 0.2f)
-				break;
 		}
 
-		box = Create_Box(GetContext());
+		box = prep.liveMode ? SpaceBoxMapRenderer::CreateQuad(GetContext()) : Create_Box(GetContext());
 		Material * star_mat = cache->GetResource<Material>("Materials/star.xml");
-		while (bright_star_enable)
+		for (unsigned ii = 0; ii < prep.brightStars.Size(); ++ii)
 		{
+			/*StarPosition is a world direction, the node is not rotated*/
 			Node * star = rttScene_->CreateChild(String("bright star"));
-			star->SetTransform(Vector3::ZERO, accumulate);
+			star->SetTransform(Vector3::ZERO, Quaternion::IDENTITY);
 			StaticModel* starObject = star->CreateComponent<StaticModel>();
 			starObject->SetModel(box);
 			SharedPtr<Material> m = star_mat->Clone();
-			m->SetShaderParameter("StarPosition", Vector3(Random(-1.0f, 1.0f), Random(-1.0f, 1.0f), Random(-1.0f, 1.0f)).Normalized());
-			m->SetShaderParameter("StarColor", Vector3::ONE);
-			m->SetShaderParameter("StarSize", 0.0f);
-			m->SetShaderParameter("StarFalloff", Random(1.0f) * Pow(2, 20) + Pow(2, 20));
+			const Vector3& starPos = prep.brightStars[ii].direction;
+			const float falloff = prep.brightStars[ii].falloff;
+			m->SetShaderParameter(PARAM_STAR_POSITION, starPos);
+			m->SetShaderParameter(PARAM_STAR_COLOR, Vector3::ONE);
+			m->SetShaderParameter(PARAM_STAR_SIZE, 0.0f);
+			m->SetShaderParameter(PARAM_STAR_FALLOFF, falloff);
 			starObject->SetMaterial(m);
-
-			if (Random(1.0f) < 0.01f)
-				break;
+			BrightStar bs;
+			bs.material = m;
+			bs.direction = starPos;
+			/*exp(-d * falloff) falls below half a color step*/
+			bs.radius = Acos(1.0f - Ln(510.0f) / falloff);
+			brightStars_.Push(bs);
 		}
 
 		Material * nebula_mat = cache->GetResource<Material>("Materials/nebular.xml");
-		while (nebula_enable)
+		/*low frequency content: render it at a fraction of the size and upsample when compositing*/
+		const int nebulaSize = Max(16, (int)(size * Clamp(prep.nebulaResolution, 0.0f, 1.0f)));
+		const bool nebulaLowRes = !prep.liveMode && prep.nebula_enable && nebulaSize < size;
+		for (unsigned ii = 0; ii < prep.nebulae.Size(); ++ii)
 		{
 			Node * nebula = rttScene_->CreateChild(String("nebula"));
 			nebula->SetTransform(Vector3::ZERO, Quaternion::IDENTITY);
 			StaticModel* nebulaObject = nebula->CreateComponent<StaticModel>();
 			nebulaObject->SetModel(box);
 			SharedPtr<Material> m = nebula_mat->Clone();
-			m->SetShaderParameter("NebularColor", Vector3(Random(1.0f), Random(1.0f), Random(1.0f)));
-			m->SetShaderParameter("NebularOffset", Vector3(Random(1.0f) * 2000 - 1000, Random(1.0f) * 2000 - 1000, Random(1.0f) * 2000 - 1000));
-			m->SetShaderParameter("NebularScale", Random(1.0f) * 0.5f + 0.25f);
-			m->SetShaderParameter("NebularIntensity", Random(1.0f) * 0.2f + 0.9f);
-			m->SetShaderParameter("NebularFalloff", Random(1.0f) * 3 + 3);
+			const float* r = prep.nebulae[ii].r;
+			m->SetShaderParameter(PARAM_NEBULAR_COLOR, Vector3(r[0], r[1], r[2]));
+			m->SetShaderParameter(PARAM_NEBULAR_OFFSET, Vector3(r[3] * 2000 - 1000, r[4] * 2000 - 1000, r[5] * 2000 - 1000));
+			m->SetShaderParameter(PARAM_NEBULAR_SCALE, r[6] * 0.5f + 0.25f);
+			m->SetShaderParameter(PARAM_NEBULAR_INTENSITY, r[7] * 0.2f + 0.9f);
+			m->SetShaderParameter(PARAM_NEBULAR_FALLOFF, r[8] * 3 + 3);
 			nebulaObject->SetMaterial(m);
+			nebulaMats_.Push(m);
+		}
 
-			if (Random(1.0f) < 0.5f)
-				break;
+		if (!nebulaMats_.Empty())
+		{
+			const int nebulaPixels = prep.liveMode ? size * size : 6 * nebulaSize * nebulaSize;
+			nebulaSteps_ = prep.nebulaSteps ? Clamp(prep.nebulaSteps, MIN_NEBULA_STEPS, MAX_NEBULA_STEPS) :
+				ChooseNebulaSteps(nebulaPixels, nebulaMats_.Size());
+			Technique* nebulaTech = GetNebulaTechnique(nebulaLowRes, nebulaSteps_);
+			for (unsigned ii = 0; ii < nebulaMats_.Size(); ++ii)
+				nebulaMats_[ii]->SetTechnique(0, nebulaTech);
+		}
+
+		if (nebulaLowRes)
+		{
+			nebulaCube_ = pool_->AcquireCube(nebulaSize, Graphics::GetRGBAFormat(), false);
+			if (nebulaCube_)
+				nebulaCube_->SetFilterMode(FILTER_BILINEAR);
+			else
+				URHO3D_LOGERROR(String("nebulaCube_->SetSize fail: size=") + String(nebulaSize));
+
+			/*all layers meet in the low resolution cube as premultiplied color and coverage, one box blends it in*/
+			Node * composite = rttScene_->CreateChild(String("nebula composite"));
+			composite->SetTransform(Vector3::ZERO, Quaternion::IDENTITY);
+			StaticModel* compositeObject = composite->CreateComponent<StaticModel>();
+			compositeObject->SetModel(box);
+			SharedPtr<Material> m = MakeShared<Material>(context_);
+			m->SetCullMode(CULL_NONE);
+			m->SetNumTechniques(1);
+			m->SetTechnique(0, cache->GetResource<Technique>("Techniques/NebulaComposite.xml"));
+			m->SetTexture(TU_DIFFUSE, nebulaCube_);
+			m->SetShaderParameter(PARAM_NEBULA_SIZE, (float)nebulaSize);
+			compositeObject->SetMaterial(m);
 		}
 
-		if (sun_enable)
+		sun_ = prep.sun_enable;
+		if (sun_)
 		{
-			Material * sun_mat = cache->GetResource<Material>("Materials/sun.xml");
+			Material * sun_mat = cache->GetResource<Material>(SUN_MATERIAL);
 			Node * sun = rttScene_->CreateChild(String("sun"));
 			sun->SetTransform(Vector3::ZERO, Quaternion::IDENTITY);
 			StaticModel* sunObject = sun->CreateComponent<StaticModel>();
 			sunObject->SetModel(box);
-			SunDirection = Vector3(Random(-1.0f, 1.0f), Random(-1.0f, 1.0f), Random(-1.0f, 1.0f));
-			SunColor = Color(Random(1.0f), Random(1.0f), Random(1.0f));
-			sun_mat->SetShaderParameter("SunPosition", SunDirection);
-			sun_mat->SetShaderParameter("SunColor", SunColor.ToVector3());
-			sun_mat->SetShaderParameter("SunSize", Random(1.0f) * 0.0001f + 0.0001f);
-			sun_mat->SetShaderParameter("SunFalloff", Random(1.0f) * 16 + 8);
+			SunDirection = prep.sunDirection;
+			SunColor = prep.sunColor;
+			sun_mat->SetShaderParameter(PARAM_SUN_POSITION, SunDirection);
+			sun_mat->SetShaderParameter(PARAM_SUN_COLOR, SunColor.ToVector3());
+			const float sunSize = prep.sunSize;
+			const float sunFalloff = prep.sunFalloff;
+			sun_mat->SetShaderParameter(PARAM_SUN_SIZE, sunSize);
+			sun_mat->SetShaderParameter(PARAM_SUN_FALLOFF, sunFalloff);
+			/*pow(d, falloff) * 0.5 falls below half a color step; the disc itself is much smaller*/
+			sunRadius_ = Max(Acos(Pow(1.0f / 255.0f, 1.0f / sunFalloff)), Acos(1.0f - sunSize * 32.0f));
 			sunObject->SetMaterial(sun_mat);
 		}
 
@@ -304,46 +544,586 @@ namespace Urho3D
 			CameraNodes[ii]->LookAt(dir[ii], up[ii]);
 		}
 
-		if(SpaceCube->SetSize(cubeSize, Graphics::GetRGBAFormat(), TEXTURE_RENDERTARGET) == false)
-			URHO3D_LOGERROR(String("SpaceCube->SetSize fail: cubeSize=") + String(cubeSize));
+		/*notify sun position*/
+		{
+			using namespace SpaceBoxGenEvt;
+			VariantMap &data = GetEventDataMap();
+			data[P_SUN_ENABLE] = sun_;
+			data[P_SUN_DIR] = SunDirection;
+			data[P_SUN_COLOR] = SunColor;
+			SendEvent(E_SPACEBOXGEN, data);
+		}
+
+		timeToFirst_ = 0;
+		timeToFull_ = 0;
+		if (prep.liveMode)
+		{
+			StartLive();
+			if (mapRenderer_)
+				SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(SpaceBoxGen, HandleEndFrame));
+			else
+				ReleaseScene();
+			return;
+		}
+		/*previews are cubes, a map output replaces them once the last level is converted*/
+		skyMap_ = nullptr;
+
+		/*preview first, then every power of two up to the budgeted size, all from the same scene*/
+		levels_.Clear();
+		if (prep.previewSize > 0 && prep.previewSize < size)
+		{
+			for (int levelSize = prep.previewSize; levelSize < size; levelSize *= 2)
+				levels_.Push(levelSize);
+		}
+		levels_.Push(size);
+		level_ = 0;
+		StartLevel();
+		if (!pending_)
+			return;
+		/*the first level is queued for all faces and renders this frame*/
+		QueueFaces(MAX_CUBEMAP_FACES);
+		/*shared by all levels. Queued after the faces on purpose: the renderer draws queued views from last to first*/
+		if (nebulaCube_)
+		{
+			for (unsigned ii = 0; ii < MAX_CUBEMAP_FACES; ++ii)
+			{
+				RenderSurface* s = nebulaCube_->GetRenderSurface((CubeMapFace)ii);
+				s->SetUpdateMode(SURFACE_MANUALUPDATE);
+				SharedPtr<Viewport> v(new Viewport(context_, rttScene_, CameraNodes[ii]->GetComponent<Camera>()));
+				v->SetRenderPath(cache->GetResource<XMLFile>("RenderPaths/SpaceBoxNebula.xml"));
+				s->SetNumViewports(1);
+				s->SetViewport(0, v);
+				s->QueueUpdate();
+			}
+		}
+
+		SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(SpaceBoxGen, HandleEndFrame));
+	}
+
+	static unsigned long long CubeBytes(int size, bool mips)
+	{
+		const unsigned long long bytes = 6ULL * size * size * 4;
+		return mips ? bytes * 4 / 3 : bytes;
+	}
+
+	static String ToMB(unsigned long long bytes)
+	{
+		return String((unsigned)((bytes + (1 << 19)) >> 20)) + " MB";
+	}
+
+	/*the largest size, with mips if allowed, whose projected peak fits the budget; the smallest one when nothing fits*/
+	void SpaceBoxGen::ChooseSize()
+	{
+		const int requested = liveMode ? Clamp(liveCacheSize, MIN_BUDGET_SIZE, 4096) : Max(cubeSize, 1);
+		const bool mips = cubeMips && !liveMode;
+		String source("off");
+		const unsigned long long budget = fitToBudget ? GetBudgetBytes(source) : 0;
+		const unsigned long long requestedBytes = Project(requested, mips).peakBytes;
+
+		bool fits = budget == 0 || requestedBytes <= budget;
+		budget_ = Project(requested, mips);
+		for (int size = requested; !fits && size >= Min(requested, MIN_BUDGET_SIZE); size /= 2)
+		{
+			for (int m = mips ? 1 : 0; m >= 0 && !fits; --m)
+			{
+				budget_ = Project(size, m != 0);
+				fits = budget_.peakBytes <= budget;
+			}
+		}
+		budget_.budget = budget;
+		budget_.source = source;
+		budget_.requestedSize = requested;
+		budget_.requestedBytes = requestedBytes;
+
+		const String decision = "SpaceBoxGen: budget " + (budget ? ToMB(budget) : String("none")) + " (" + source + "), " +
+			String(budget_.size) + (liveMode ? " live map" : budget_.mips ? " cube with mips" : " cube without mips") + ", peak " +
+			ToMB(budget_.peakBytes) + ", resident " + ToMB(budget_.residentBytes) +
+			(budget_.size != requested ? ", " + String(requested) + " requested needs " + ToMB(requestedBytes) : String::EMPTY);
+		if (fits)
+			URHO3D_LOGINFO(decision);
+		else
+			URHO3D_LOGWARNING(decision + ", nothing fits");
+	}
+
+	/*textures and buffers one Generate() allocates with the current switches*/
+	SpaceBoxBudget SpaceBoxGen::Project(int size, bool mips) const
+	{
+		SpaceBoxBudget p;
+		p.size = size;
+		p.mips = mips;
+		/*the point star model is built even when the layer is off*/
+		const unsigned long long scene = POINT_STAR_BYTES;
+		/*render targets of one size share a depth buffer, the largest dominates*/
+		const unsigned long long depth = 4ULL * size * size;
+		if (liveMode)
+		{
+			const unsigned long long map = 4ULL * size * size;
+			p.peakBytes = map + depth + scene;
+			p.residentBytes = (animateNebula && nebula_enable) || dynamicLayers ? p.peakBytes : map;
+			return p;
+		}
+
+		const int nebulaSize = Max(16, (int)(size * Clamp(nebulaResolution, 0.0f, 1.0f)));
+		const unsigned long long nebula = nebula_enable && nebulaSize < size ? 6ULL * nebulaSize * nebulaSize * 4 : 0;
+		/*the previous level is shown while the final one renders*/
+		const unsigned long long previous = previewSize > 0 && previewSize < size ? CubeBytes(size / 2, mips) : 0;
+		const unsigned long long base = dynamicLayers ? 6ULL * size * size * 4 : 0;
+		const unsigned long long cube = CubeBytes(size, mips);
+		unsigned long long map = 0;
+		if (skyOutput != SKY_CUBE)
+		{
+			int width, height;
+			GetSkyMapSize(skyOutput, size, width, height);
+			map = 4ULL * width * height;
+		}
+
+		p.peakBytes = cube + map + Max(previous, base) + nebula + depth + scene;
+		if (dynamicLayers || (animateNebula && nebula_enable))
+			p.residentBytes = cube + map + base + nebula + depth + scene;
+		else
+			p.residentBytes = map ? map : cube;
+		return p;
+	}
+
+	/*in bytes, 0 when unknown*/
+	unsigned long long SpaceBoxGen::GetBudgetBytes(String& source) const
+	{
+		if (memoryBudgetMB > 0)
+		{
+			source = "configured";
+			return (unsigned long long)memoryBudgetMB << 20;
+		}
+#ifdef URHO3D_OPENGL
+		GPUMemoryInfo info;
+		if (QueryGPUMemory(info))
+		{
+			/*the current sky is replaced and free pooled cubes can be evicted, their memory counts as free*/
+			unsigned long long current = pool_->GetBytesFree();
+			if (SpaceCube && SpaceCube->GetWidth())
+				current += CubeBytes(SpaceCube->GetWidth(), SpaceCube->GetLevels() > 1);
+			if (skyMap_)
+				current += 4ULL * skyMap_->GetWidth() * skyMap_->GetHeight();
+			const float fraction = Clamp(budgetFraction, 0.0f, 1.0f);
+			source = info.source_ + ", " + String(RoundToInt(fraction * 100.0f)) + "% of " + ToMB(info.free_ + current) + " free";
+			return (unsigned long long)((double)(info.free_ + current) * fraction);
+		}
+#endif
+		source = "none";
+		return 0;
+	}
+
+	void SpaceBoxGen::Cancel()
+	{
+		if (cache_)
+			cache_->Cancel();
+		ReleaseScene();
+	}
+
+	int SpaceBoxGen::ChooseNebulaSteps(int pixels, unsigned layers) const
+	{
+		/*every step is 3 noise evaluations, plus the final one*/
+		const double evalsPerStep = 3.0 * pixels * layers;
+		const double budget = (double)nebulaBudgetMs * noiseEvalsPerMs;
+		int steps = MAX_NEBULA_STEPS;
+		while (steps > MIN_NEBULA_STEPS && evalsPerStep * steps + (double)pixels * layers > budget)
+			--steps;
+		return steps;
+	}
+
+	Technique* SpaceBoxGen::GetNebulaTechnique(bool lowRes, int steps)
+	{
+		Technique* base = GetSubsystem<ResourceCache>()->GetResource<Technique>(
+			lowRes ? "Techniques/NoTextureAlphaNebularLowRes.xml" : "Techniques/NoTextureAlphaNebular.xml");
+		if (!base)
+			return nullptr;
+		/*clones are cached by the technique, so every tier is one shader variant*/
+		return base->CloneWithDefines(String::EMPTY, "NEBULA_STEPS=" + String(steps));
+	}
+
+	void SpaceBoxGen::PrewarmNebulaTiers()
+	{
+		ShaderWarmup* warmup = ShaderWarmup::Get(context_);
+		for (int lowRes = 0; lowRes < 2; ++lowRes)
+		{
+			for (int steps = MIN_NEBULA_STEPS; steps <= MAX_NEBULA_STEPS; ++steps)
+				warmup->Submit(GetNebulaTechnique(lowRes != 0, steps));
+		}
+	}
+
+	void SpaceBoxGen::PrewarmShaders()
+	{
+		auto* cache = GetSubsystem<ResourceCache>();
+		ShaderWarmup* warmup = ShaderWarmup::Get(context_);
+		/*the layers, cube and live passes*/
+		warmup->Submit(cache->GetResource<Technique>("Techniques/NoTextureAlphaPointStar.xml"));
+		warmup->Submit(cache->GetResource<Technique>("Techniques/NoTextureAlphaStar.xml"));
+		warmup->Submit(cache->GetResource<Technique>("Techniques/NoTextureAlphaSun.xml"));
+		PrewarmNebulaTiers();
+		warmup->Submit(cache->GetResource<Technique>("Techniques/NebulaComposite.xml"));
+		warmup->Submit(cache->GetResource<Technique>("Techniques/SpaceBoxBase.xml"));
+		Technique* convert = cache->GetResource<Technique>("Techniques/SkyConvert.xml");
+		if (convert)
+		{
+			warmup->Submit(convert->CloneWithDefines(String::EMPTY, "OCTAHEDRAL"));
+			warmup->Submit(convert->CloneWithDefines(String::EMPTY, "EQUIRECT"));
+		}
+	}
+
+	void SpaceBoxGen::StartLevel()
+	{
+		auto* cache = GetSubsystem<ResourceCache>();
+		const int size = levels_[level_];
+		/*a new texture each level, the one being shown is never rendered into*/
+		pending_ = pool_->AcquireCube(size, Graphics::GetRGBAFormat(), budget_.mips);
+		if (!pending_)
+		{
+			URHO3D_LOGERROR(String("SpaceCube->SetSize fail: cubeSize=") + String(size));
+			ReleaseScene();
+			return;
+		}
 		for (unsigned ii = 0; ii < MAX_CUBEMAP_FACES; ++ii)
 		{
-			RenderSurface* s = SpaceCube->GetRenderSurface((CubeMapFace)ii);
+			RenderSurface* s = pending_->GetRenderSurface((CubeMapFace)ii);
 			s->SetUpdateMode(SURFACE_MANUALUPDATE);
-			s->QueueUpdate();
 			SharedPtr<Viewport> v(new Viewport(context_, rttScene_, CameraNodes[ii]->GetComponent<Camera>()));
 			v->SetRenderPath(cache->GetResource<XMLFile>("RenderPaths/SpaceBox.xml"));
 			s->SetNumViewports(1);
 			s->SetViewport(0, v);
 		}
+		nextFace_ = 0;
+	}
 
-		/*notify sun position*/
+	void SpaceBoxGen::QueueFaces(unsigned count)
+	{
+		if (!pending_)
+			return;
+		/*queued before the last faces of the final level, so it renders after them*/
+		if (skyOutput != SKY_CUBE && level_ + 1 == levels_.Size() && nextFace_ < MAX_CUBEMAP_FACES &&
+			nextFace_ + count >= MAX_CUBEMAP_FACES)
+			QueueConversion(pending_);
+		for (unsigned ii = 0; ii < count && nextFace_ < MAX_CUBEMAP_FACES; ++ii)
+			pending_->GetRenderSurface((CubeMapFace)nextFace_++)->QueueUpdate();
+	}
+
+	/*draw the cube into a new skyOutput map; it becomes the sky when the level is swapped in*/
+	void SpaceBoxGen::QueueConversion(TextureCube* source)
+	{
+		mapRenderer_ = MakeShared<SpaceBoxMapRenderer>(context_);
+		if (!mapRenderer_->StartConversion(rttScene_, source, skyOutput))
+			mapRenderer_ = nullptr;
+	}
+
+	void SpaceBoxGen::ReleasePending()
+	{
+		if (!pending_)
+			return;
+		for (unsigned ii = 0; ii < MAX_CUBEMAP_FACES; ++ii)
+			pending_->GetRenderSurface((CubeMapFace)ii)->SetNumViewports(0);
+		pending_ = nullptr;
+	}
+
+	/*faces queued last frame have been rendered*/
+	void SpaceBoxGen::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+	{
+		if (IsLive())
 		{
-			using namespace SpaceBoxGenEvt;
-			VariantMap &data = GetEventDataMap();
-			data[P_SUN_ENABLE] = sun_enable;
-			data[P_SUN_DIR] = SunDirection;
-			data[P_SUN_COLOR] = SunColor;
-			SendEvent(E_SPACEBOXGEN, data);
+			UpdateLive(GetSubsystem<Time>()->GetTimeStep());
+			return;
 		}
 
-		/*auto destroy scene*/
-		SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(SpaceBoxGen, HandleEndFrame));
+		if (updater_)
+		{
+			if (updater_->IsAnimating())
+				nebulaTime_ += GetSubsystem<Time>()->GetTimeStep() * nebulaDriftSpeed;
+			if (updater_->HasLayers())
+				ApplyPositions();
+			const bool roundStart = updater_->Collect(animTilesPerFrame);
+			/*one time value per round, so tiles of the same round always match*/
+			if (roundStart)
+				SetNebulaTime();
+			/*queued first, so the map is converted after the faces are rendered*/
+			if (mapRenderer_ && updater_->HasViews())
+				mapRenderer_->QueueUpdate();
+			updater_->Submit();
+			/*the low resolution nebula is cheap, refresh all of it when a round starts; queued last so it renders first*/
+			if (nebulaCube_ && roundStart)
+			{
+				for (unsigned ii = 0; ii < MAX_CUBEMAP_FACES; ++ii)
+					nebulaCube_->GetRenderSurface((CubeMapFace)ii)->QueueUpdate();
+			}
+			return;
+		}
+
+		if (nextFace_ < MAX_CUBEMAP_FACES)
+		{
+			QueueFaces(upgradeFacesPerFrame);
+			return;
+		}
+
+		/*level complete, swap it in*/
+		SpaceCube = pending_;
+		ReleasePending();
+		const long long elapsed = genTimer_.GetUSec(false);
+		if (level_ == 0)
+			timeToFirst_ = elapsed;
+		const bool isFinal = ++level_ == levels_.Size();
+		if (isFinal && mapRenderer_)
+		{
+			skyMap_ = mapRenderer_->GetMap();
+			skyMapping_ = mapRenderer_->GetMapping();
+		}
+		SendReady(isFinal);
+
+		if (!isFinal)
+		{
+			StartLevel();
+			QueueFaces(upgradeFacesPerFrame);
+			return;
+		}
+
+		timeToFull_ = elapsed;
+		URHO3D_LOGINFO("SpaceBoxGen: prepared in " + String(timeToPrepare_ / 1000) + " ms, first " + String(levels_[0]) +
+			" cube in " + String(timeToFirst_ / 1000) + " ms, full " +
+			String(levels_.Back()) + " cube in " + String(timeToFull_ / 1000) + " ms, nebula steps " + String(nebulaSteps_));
+		if (dynamicLayers || (animateNebula && !nebulaMats_.Empty()))
+		{
+			updater_ = MakeShared<SpaceBoxCubeUpdater>(context_, rttScene_, SpaceCube, CameraNodes);
+			if (dynamicLayers)
+				updater_->StartLayers(pool_, box);
+			if (animateNebula && !nebulaMats_.Empty())
+			{
+				updater_->StartAnimation(Clamp(animTileGrid, 1, 8));
+				nebulaTime_ = 0.0f;
+			}
+			/*nothing was started on the cube, there are no viewports to release*/
+			if (!updater_->HasLayers() && !updater_->IsAnimating())
+				updater_ = nullptr;
+		}
+		if (!updater_)
+		{
+			ReleaseScene();
+			/*the map is the sky now, the cube is only kept while it is still updated*/
+			if (skyMap_)
+				SpaceCube = nullptr;
+		}
+	}
+
+	bool SpaceBoxGen::SetSunDirection(const Vector3& direction)
+	{
+		if (!(HasLayers() || IsLive()) || !sun_)
+			return false;
+		const Vector3 dir = direction.Normalized();
+		if (IsLive())
+			liveDirty_ = true;
+		else
+		{
+			updater_->MarkDirty(SunDirection, sunRadius_);
+			updater_->MarkDirty(dir, sunRadius_);
+		}
+		SunDirection = dir;
+
+		using namespace SpaceBoxGenEvt;
+		VariantMap &data = GetEventDataMap();
+		data[P_SUN_ENABLE] = sun_;
+		data[P_SUN_DIR] = SunDirection;
+		data[P_SUN_COLOR] = SunColor;
+		SendEvent(E_SPACEBOXGEN, data);
+		return true;
+	}
+
+	bool SpaceBoxGen::SetBrightStarDirection(unsigned index, const Vector3& direction)
+	{
+		if (!(HasLayers() || IsLive()) || index >= brightStars_.Size())
+			return false;
+		BrightStar& bs = brightStars_[index];
+		const Vector3 dir = direction.Normalized();
+		if (IsLive())
+			liveDirty_ = true;
+		else
+		{
+			updater_->MarkDirty(bs.direction, bs.radius);
+			updater_->MarkDirty(dir, bs.radius);
+		}
+		bs.direction = dir;
+		return true;
+	}
+
+	/*positions are applied only when queuing, so what renders next frame matches the regions marked for it*/
+	void SpaceBoxGen::ApplyPositions()
+	{
+		if (sun_)
+			GetSubsystem<ResourceCache>()->GetResource<Material>(SUN_MATERIAL)->SetShaderParameter(PARAM_SUN_POSITION, SunDirection);
+		for (unsigned ii = 0; ii < brightStars_.Size(); ++ii)
+			brightStars_[ii].material->SetShaderParameter(PARAM_STAR_POSITION, brightStars_[ii].direction);
+	}
+
+	void SpaceBoxGen::SetNebulaTime()
+	{
+		for (unsigned ii = 0; ii < nebulaMats_.Size(); ++ii)
+			nebulaMats_[ii]->SetShaderParameter(PARAM_NEBULAR_TIME, nebulaTime_);
+	}
+
+	/*render the layers into an octahedral map instead of six faces; SpaceCube is released*/
+	void SpaceBoxGen::StartLive()
+	{
+		const int tileGrid = animateNebula && !nebulaMats_.Empty() ? Clamp(animTileGrid, 1, 8) : 0;
+		mapRenderer_ = MakeShared<SpaceBoxMapRenderer>(context_);
+		if (!mapRenderer_->StartLive(rttScene_, budget_.size, tileGrid))
+		{
+			mapRenderer_ = nullptr;
+			return;
+		}
+		skyMap_ = mapRenderer_->GetMap();
+		skyMapping_ = SKY_OCTAHEDRAL;
+		nebulaTime_ = 0.0f;
+		liveDirty_ = false;
+		SpaceCube = nullptr;
+	}
+
+	/*the map queued last frame has been rendered*/
+	void SpaceBoxGen::UpdateLive(float timeStep)
+	{
+		if (!timeToFull_)
+		{
+			timeToFirst_ = timeToFull_ = genTimer_.GetUSec(false);
+			const int size = skyMap_->GetWidth();
+			URHO3D_LOGINFO("SpaceBoxGen: live " + String(size) + "^2 octahedral map (" + String(size * size * 4 / 1024) +
+				" KB) in " + String(timeToFull_ / 1000) + " ms, nebula steps " + String(nebulaSteps_));
+			SendReady(true);
+			/*a receiver started another sky*/
+			if (!IsLive())
+				return;
+			/*nothing will change, the scene is not needed anymore*/
+			if (!mapRenderer_->HasTiles() && !dynamicLayers)
+			{
+				ReleaseScene();
+				return;
+			}
+		}
+
+		/*a moved sun or star invalidates everything, the map is small enough to redo at once*/
+		if (liveDirty_)
+		{
+			ApplyPositions();
+			mapRenderer_->QueueUpdate();
+			liveDirty_ = false;
+		}
+		else if (mapRenderer_->HasTiles())
+		{
+			nebulaTime_ += timeStep * nebulaDriftSpeed;
+			if (mapRenderer_->QueueTiles(animTilesPerFrame))
+				SetNebulaTime();
+		}
 	}
 
 	/*destroy scene*/
-	void SpaceBoxGen::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+	void SpaceBoxGen::ReleaseScene()
 	{
+		/*a preparation still on a worker is dropped when it completes*/
+		prep_ = nullptr;
 		UnsubscribeFromEvent(E_ENDFRAME);
+		ReleasePending();
+		if (updater_)
+		{
+			/*detaches only its own viewports, from the cube it was started on*/
+			updater_->Release();
+			updater_ = nullptr;
+		}
+		if (mapRenderer_)
+		{
+			/*detaches only its own viewports; a map it rendered stays if it is the sky*/
+			mapRenderer_->Release();
+			mapRenderer_ = nullptr;
+		}
+		liveDirty_ = false;
+		nebulaMats_.Clear();
+		brightStars_.Clear();
+		if (nebulaCube_)
+		{
+			for (unsigned ii = 0; ii < MAX_CUBEMAP_FACES; ++ii)
+				nebulaCube_->GetRenderSurface((CubeMapFace)ii)->SetNumViewports(0);
+			nebulaCube_ = nullptr;
+		}
 		for (unsigned ii = 0; ii < MAX_CUBEMAP_FACES; ++ii)
 		{
-			CameraNodes[ii]->Remove();
+			if (CameraNodes[ii])
+				CameraNodes[ii]->Remove();
 			CameraNodes[ii] = nullptr;
-			RenderSurface* s = SpaceCube->GetRenderSurface((CubeMapFace)ii);
-			s->SetNumViewports(0);
 		}
 		rttScene_ = nullptr;
 		point_stars = nullptr;
 		box = nullptr;
+		pool_->Trim();
+	}
+
+	bool SpaceBoxGen::SaveToCache(const String& fileName)
+	{
+		if (!cache_)
+			cache_ = MakeShared<SpaceBoxCache>(context_);
+		SpaceBoxCacheInfo info;
+		info.seed = seed_;
+		info.sunEnable = sun_;
+		info.sunDirection = SunDirection;
+		info.sunColor = SunColor;
+		return skyMap_ ? cache_->Save(skyMap_, skyMapping_, fileName, info) : cache_->Save(SpaceCube, fileName, info);
+	}
+
+	void SpaceBoxGen::LoadFromCache(const String& fileName)
+	{
+		if (!cache_)
+			cache_ = MakeShared<SpaceBoxCache>(context_);
+		/*stop upgrading a generated sky, the loaded one replaces it*/
+		ReleaseScene();
+		SubscribeToEvent(cache_, E_SPACEBOXCACHELOADED, URHO3D_HANDLER(SpaceBoxGen, HandleCacheLoaded));
+		cache_->Load(fileName, skyOutput);
+	}
+
+	void SpaceBoxGen::HandleCacheLoaded(StringHash eventType, VariantMap& eventData)
+	{
+		using namespace SpaceBoxCacheLoaded;
+		if (!eventData[P_SUCCESS].GetBool())
+			return;
+
+		/*swap in one step, the old cube was shown until now. The switches are left alone, they are what the next
+		Generate() uses; the loaded size and sun are in E_SPACEBOXREADY and E_SPACEBOXGEN*/
+		const SkyMapping mapping = (SkyMapping)eventData[P_MAPPING].GetInt();
+		if (mapping == SKY_CUBE)
+		{
+			SpaceCube = static_cast<TextureCube*>(eventData[P_TEXTURE].GetPtr());
+			skyMap_ = nullptr;
+		}
+		else
+		{
+			skyMap_ = static_cast<Texture2D*>(eventData[P_TEXTURE].GetPtr());
+			skyMapping_ = mapping;
+			SpaceCube = nullptr;
+		}
+		seed_ = eventData[P_SEED].GetUInt();
+		SunDirection = eventData[P_SUN_DIR].GetVector3();
+		SunColor = eventData[P_SUN_COLOR].GetColor();
+		ReleaseScene();
+		sun_ = eventData[P_SUN_ENABLE].GetBool();
+
+		{
+			using namespace SpaceBoxGenEvt;
+			VariantMap &data = GetEventDataMap();
+			data[P_SUN_ENABLE] = sun_;
+			data[P_SUN_DIR] = SunDirection;
+			data[P_SUN_COLOR] = SunColor;
+			SendEvent(E_SPACEBOXGEN, data);
+		}
+		SendReady(true);
+	}
+
+	void SpaceBoxGen::SendReady(bool isFinal)
+	{
+		using namespace SpaceBoxReady;
+		VariantMap &data = GetEventDataMap();
+		Texture* texture = skyMap_ ? static_cast<Texture*>(skyMap_.Get()) : static_cast<Texture*>(SpaceCube.Get());
+		data[P_TEXTURE] = texture;
+		data[P_MAPPING] = (int)GetSkyMapping();
+		data[P_SIZE] = texture->GetWidth();
+		data[P_FINAL] = isFinal;
+		SendEvent(E_SPACEBOXREADY, data);
 	}
 }
@@ -1,9 +1,20 @@
 #pragma once
 #include <Urho3D/Graphics/TextureCube.h>
+#include <Urho3D/Graphics/Texture2D.h>
 #include <Urho3D/Graphics/Model.h>
+#include "SpaceRandom.h"
+#include "SpaceBoxCache.h"
+#include "SkyProjection.h"
+#include "SpaceBoxMapRenderer.h"
+#include "SpaceBoxCubeUpdater.h"
+#include "SpaceBoxPool.h"
 
 namespace Urho3D
 {
+	class Material;
+	class Technique;
+	class Viewport;
+	struct SpaceBoxPrep;
 
 	URHO3D_EVENT(E_SPACEBOXGEN, SpaceBoxGenEvt)
 	{
@@ -12,13 +23,78 @@ namespace Urho3D
 		URHO3D_PARAM(P_SUN_COLOR, SunColor); // color
 	}
 
+	/*SpaceCube may have been replaced by another texture, rebind it*/
+	URHO3D_EVENT(E_SPACEBOXREADY, SpaceBoxReady)
+	{
+		URHO3D_PARAM(P_TEXTURE, Texture); // TextureCube ptr, or a Texture2D sky map
+		URHO3D_PARAM(P_MAPPING, Mapping); // int SkyMapping of the texture
+		URHO3D_PARAM(P_SIZE, Size); // int
+		URHO3D_PARAM(P_FINAL, Final); // bool, false for the lower resolution steps
+	}
+
+	/*nebula quality tiers are the domain warp step counts, see NEBULA_STEPS in nebula.glsl*/
+	static const int MIN_NEBULA_STEPS = 3;
+	static const int MAX_NEBULA_STEPS = 6;
+
+	/*what Generate() chose under the memory budget; bytes are projected from the texture and buffer sizes, not measured*/
+	struct SpaceBoxBudget
+	{
+		/*0 when no budget is known, the requested size is used then*/
+		unsigned long long budget{ 0 };
+		/*"configured", the extension the free memory came from, or "none"*/
+		String source;
+		int requestedSize{ 0 };
+		/*cube size, or the octahedral map size in live mode*/
+		int size{ 0 };
+		bool mips{ false };
+		/*while the final level renders next to the previous one, and what stays allocated afterwards*/
+		unsigned long long peakBytes{ 0 };
+		unsigned long long residentBytes{ 0 };
+		/*peak of the requested size*/
+		unsigned long long requestedBytes{ 0 };
+	};
+
 	class SpaceBoxGen : public Object
 	{
 		URHO3D_OBJECT(SpaceBoxGen, Object);
 	public:
 		explicit SpaceBoxGen(Context* context);
 		~SpaceBoxGen();
+		/*generate with a new seed*/
 		void Generate();
+		/*same seed and switches always give the same sky*/
+		void Generate(unsigned seed);
+		unsigned GetSeed() const { return seed_; }
+		/*from Generate() until the final level is ready, including the preparation on a worker*/
+		bool IsGenerating() const { return prep_ || (rttScene_ && !timeToFull_); }
+		/*stop generating or loading, whatever was swapped in so far stays*/
+		void Cancel();
+		/*microseconds from Generate() until the first / the cubeSize cube was rendered, 0 while pending*/
+		long long GetTimeToFirst() const { return timeToFirst_; }
+		long long GetTimeToFull() const { return timeToFull_; }
+		/*write the current sky to disk without blocking*/
+		bool SaveToCache(const String& fileName);
+		/*load a saved sky in the background; SpaceCube is swapped when all faces are uploaded*/
+		void LoadFromCache(const String& fileName);
+		bool IsLoading() const { return cache_ && cache_->IsLoading(); }
+		bool IsSaving() const { return cache_ && cache_->IsSaving(); }
+		/*move the sun / a bright star without regenerating; needs dynamicLayers and a finished Generate()*/
+		bool SetSunDirection(const Vector3& direction);
+		bool SetBrightStarDirection(unsigned index, const Vector3& direction);
+		unsigned GetNumBrightStars() const { return brightStars_.Size(); }
+		/*steps used by the last Generate()*/
+		int GetNebulaSteps() const { return nebulaSteps_; }
+		/*queue the shader variant of every nebula tier on ShaderWarmup, so switching tiers never compiles mid-game*/
+		void PrewarmNebulaTiers();
+		/*queue every shader pair the generator draws with on ShaderWarmup; the scheduler starts no generation before they are done*/
+		void PrewarmShaders();
+		/*the size, mips and projected memory the last Generate() used*/
+		const SpaceBoxBudget& GetBudget() const { return budget_; }
+		/*the 2D sky of live mode or skyOutput, null for a cube sky*/
+		Texture2D* GetSkyMap() const { return skyMap_; }
+		SkyMapping GetSkyMapping() const { return skyMap_ ? skyMapping_ : SKY_CUBE; }
+		/*whether the current sky has a sun, generated or loaded; sun_enable only applies to the next Generate()*/
+		bool HasSun() const { return sun_; }
 		const Vector3& GetSunDirection() const { return SunDirection; }
 		const Color& GetSunColor() const { return SunColor; }
 
@@ -27,16 +103,113 @@ namespace Urho3D
 		bool nebula_enable{ true };
 		bool sun_enable{ true };
 		int cubeSize{ 1024 };
+		/*full mip chain on the generated cube*/
+		bool cubeMips{ true };
+		/*VRAM the sky may take in MB, e.g. a fleet-wide setting. 0 takes budgetFraction of the free memory the driver
+		reports (OpenGL with GL_NVX_gpu_memory_info or GL_ATI_meminfo); with neither, cubeSize is used as set.
+		Generate() drops the mips first, then halves the size until the projected peak fits*/
+		bool fitToBudget{ true };
+		int memoryBudgetMB{ 0 };
+		float budgetFraction{ 0.5f };
+		/*rendered first and shown next frame, then doubled up to cubeSize; 0 renders cubeSize directly*/
+		int previewSize{ 256 };
+		/*faces rendered per frame while upgrading*/
+		unsigned upgradeFacesPerFrame{ 1 };
+		/*nebula cube size relative to cubeSize, 0.25 or 0.125 are good; 1 renders the nebula at full size*/
+		float nebulaResolution{ 0.25f };
+		/*fixed nebula tier (3..6 steps), or 0 to pick the highest tier that fits nebulaBudgetMs*/
+		int nebulaSteps{ 0 };
+		float nebulaBudgetMs{ 4.0f };
+		/*device class estimate of 4D noise evaluations per millisecond, used with nebulaBudgetMs*/
+		float noiseEvalsPerMs{ 2.0e7f };
+		/*after generation keep re-rendering SpaceCube with the nebula drifting along the 4th noise dimension*/
+		bool animateNebula{ false };
+		/*noise units per second*/
+		float nebulaDriftSpeed{ 0.05f };
+		/*each face is split into animTileGrid^2 tiles, animTilesPerFrame of them are refreshed per frame*/
+		int animTileGrid{ 2 };
+		unsigned animTilesPerFrame{ 1 };
+		/*after generation keep the point stars cached in their own cube, so SetSunDirection and
+		SetBrightStarDirection re-render only the rectangles around the old and new position*/
+		bool dynamicLayers{ false };
+		/*no SpaceCube: every layer is evaluated per texel of a liveCacheSize^2 octahedral map instead, which
+		stays valid for any camera rotation. animateNebula and dynamicLayers refresh the map in place*/
+		bool liveMode{ false };
+		int liveCacheSize{ 1024 };
+		/*the final sky as one 2D map converted from the cube, SpaceCube is released unless it is still updated.
+		Previews stay cubes; live mode is always octahedral*/
+		SkyMapping skyOutput{ SKY_CUBE };
 		SharedPtr<TextureCube> SpaceCube;
 
 	private:
 		void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+		void HandleCacheLoaded(StringHash eventType, VariantMap& eventData);
+		void HandleWorkItemCompleted(StringHash eventType, VariantMap& eventData);
+		void BuildScene(const SpaceBoxPrep& prep);
+		int ChooseNebulaSteps(int pixels, unsigned layers) const;
+		Technique* GetNebulaTechnique(bool lowRes, int steps);
+		void ChooseSize();
+		SpaceBoxBudget Project(int size, bool mips) const;
+		unsigned long long GetBudgetBytes(String& source) const;
+		struct BrightStar
+		{
+			SharedPtr<Material> material;
+			Vector3 direction;
+			/*degrees*/
+			float radius;
+		};
+
+		void ApplyPositions();
+		void SetNebulaTime();
+		void StartLive();
+		void UpdateLive(float timeStep);
+		bool IsLive() const { return mapRenderer_ && mapRenderer_->IsLive(); }
+		bool HasLayers() const { return updater_ && updater_->HasLayers(); }
+		void StartLevel();
+		void QueueFaces(unsigned count);
+		void QueueConversion(TextureCube* source);
+		void ReleasePending();
+		void ReleaseScene();
+		void SendReady(bool isFinal);
 
 		SharedPtr<Scene> rttScene_;
 		SharedPtr<Model> point_stars;
 		SharedPtr<Model> box;
 		SharedPtr<Node> CameraNodes[MAX_CUBEMAP_FACES];
+		SharedPtr<TextureCube> pending_;
+		SharedPtr<TextureCube> nebulaCube_;
+		PODVector<int> levels_;
+		unsigned level_{ 0 };
+		unsigned nextFace_{ 0 };
+		HiresTimer genTimer_;
+		long long timeToFirst_{ 0 };
+		long long timeToFull_{ 0 };
+		long long timeToPrepare_{ 0 };
+		/*the preparation the scene will be built from; superseded ones stay in preps_ until their worker is done*/
+		SpaceBoxPrep* prep_{ nullptr };
+		PODVector<SpaceBoxPrep*> preps_;
+		int nebulaSteps_{ MAX_NEBULA_STEPS };
+		SpaceBoxBudget budget_;
+		Vector<SharedPtr<Material> > nebulaMats_;
+		float nebulaTime_{ 0.0f };
+		/*animates or recomposites the final cube; only exists with the scene*/
+		SharedPtr<SpaceBoxCubeUpdater> updater_;
+		Vector<BrightStar> brightStars_;
+		float sunRadius_{ 90.0f };
+		/*the sky has a sun: set by BuildScene and by a loaded sky, kept after the scene is released*/
+		bool sun_{ false };
+		/*the 2D sky being shown: rendered by mapRenderer_, or loaded*/
+		SharedPtr<Texture2D> skyMap_;
+		SkyMapping skyMapping_{ SKY_CUBE };
+		/*the live map, or the conversion of the final level; only exists with the scene*/
+		SharedPtr<SpaceBoxMapRenderer> mapRenderer_;
+		bool liveDirty_{ false };
 		Vector3 SunDirection;
 		Color SunColor;
+		SharedPtr<SpaceBoxCache> cache_;
+		/*shared by all generators*/
+		SharedPtr<SpaceBoxPool> pool_;
+		SpaceRandom seedSource_;
+		unsigned seed_{ 0 };
 	};
 }
@@ -0,0 +1,209 @@
+#include "SpaceBoxMapRenderer.h"
+#include <Urho3D/Urho3DAll.h>
+
+namespace Urho3D
+{
+	/*orthographic over [-1, 1]^2, stretched to the viewport whatever its aspect*/
+	static Camera* CreateMapCamera(Node* node)
+	{
+		Camera* camera = node->CreateComponent<Camera>();
+		camera->SetOrthographic(true);
+		camera->SetOrthoSize(2.0f);
+		camera->SetAspectRatio(1.0f);
+		camera->SetFarClip(2.0f);
+		return camera;
+	}
+
+	void FitCameraToRect(Camera* camera, const IntRect& rect, int size)
+	{
+		const float x0 = -1.0f + 2.0f * rect.left_ / size;
+		const float x1 = -1.0f + 2.0f * rect.right_ / size;
+#ifdef URHO3D_OPENGL
+		const float y0 = -1.0f + 2.0f * rect.top_ / size;
+		const float y1 = -1.0f + 2.0f * rect.bottom_ / size;
+#else
+		const float y0 = 1.0f - 2.0f * rect.bottom_ / size;
+		const float y1 = 1.0f - 2.0f * rect.top_ / size;
+#endif
+		const float sx = 2.0f / (x1 - x0);
+		const float sy = 2.0f / (y1 - y0);
+		camera->SetFarClip(256.0f);
+		camera->SetFov(90.0f);
+		camera->SetZoom(sy);
+		camera->SetAspectRatio(sy / sx);
+		camera->SetAutoAspectRatio(false);
+		camera->SetProjectionOffset(Vector2(-sx * 0.5f * (x0 + x1) * 0.5f, -sy * 0.5f * (y0 + y1) * 0.5f));
+	}
+
+	Model* SpaceBoxMapRenderer::CreateQuad(Context* context)
+	{
+		const unsigned quadVertexNum = 6;
+		const Vector3 vertexes[quadVertexNum] =
+		{
+			Vector3(-1, -1, 1),
+			Vector3(-1,  1, 1),
+			Vector3(1,  1, 1),
+			Vector3(-1, -1, 1),
+			Vector3(1,  1, 1),
+			Vector3(1, -1, 1)
+		};
+		unsigned short indexData[quadVertexNum];
+		for (unsigned ii = 0; ii < quadVertexNum; ++ii)
+			indexData[ii] = ii;
+
+		Model * fromScratchModel(new Model(context));
+		VertexBuffer * vb(new VertexBuffer(context));
+		IndexBuffer * ib(new IndexBuffer(context));
+		Geometry * geom(new Geometry(context));
+
+		vb->SetShadowed(true);
+		PODVector<VertexElement> elements;
+		elements.Push(VertexElement(TYPE_VECTOR3, SEM_POSITION));
+		vb->SetSize(quadVertexNum, elements);
+		vb->SetData(vertexes);
+
+		ib->SetShadowed(true);
+		ib->SetSize(quadVertexNum, false);
+		ib->SetData(indexData);
+
+		geom->SetVertexBuffer(0, vb);
+		geom->SetIndexBuffer(ib);
+		geom->SetDrawRange(TRIANGLE_LIST, 0, quadVertexNum);
+
+		fromScratchModel->SetNumGeometries(1);
+		fromScratchModel->SetGeometry(0, 0, geom);
+		/*never culled, the quad is not where the camera thinks it is*/
+		fromScratchModel->SetBoundingBox(BoundingBox(-1000.0f, 1000.0f));
+
+		return fromScratchModel;
+	}
+
+	SpaceBoxMapRenderer::SpaceBoxMapRenderer(Context* context) : Object(context)
+	{
+	}
+
+	bool SpaceBoxMapRenderer::CreateMap(int width, int height, SkyMapping mapping)
+	{
+		map_ = MakeShared<Texture2D>(context_);
+		map_->SetNumLevels(1);
+		map_->SetFilterMode(FILTER_BILINEAR);
+		map_->SetAddressMode(COORD_U, mapping == SKY_EQUIRECT ? ADDRESS_WRAP : ADDRESS_CLAMP);
+		map_->SetAddressMode(COORD_V, ADDRESS_CLAMP);
+		if (map_->SetSize(width, height, Graphics::GetRGBAFormat(), TEXTURE_RENDERTARGET) == false)
+		{
+			URHO3D_LOGERROR(String("SpaceBoxMapRenderer: SetSize fail: ") + String(width) + "x" + String(height));
+			map_ = nullptr;
+			return false;
+		}
+		map_->GetRenderSurface()->SetUpdateMode(SURFACE_MANUALUPDATE);
+		mapping_ = mapping;
+		return true;
+	}
+
+	bool SpaceBoxMapRenderer::StartConversion(Scene* scene, TextureCube* source, SkyMapping mapping)
+	{
+		auto* cache = GetSubsystem<ResourceCache>();
+		Release();
+		int width, height;
+		GetSkyMapSize(mapping, source->GetWidth(), width, height);
+		if (!CreateMap(width, height, mapping))
+			return false;
+		live_ = false;
+
+		/*a quad at z = 1 in front of an orthographic camera, stretched over the whole map*/
+		node_ = scene->CreateChild("sky map");
+		StaticModel* quad = node_->CreateComponent<StaticModel>();
+		quad->SetModel(CreateQuad(context_));
+		SharedPtr<Material> m = MakeShared<Material>(context_);
+		m->SetCullMode(CULL_NONE);
+		m->SetNumTechniques(1);
+		m->SetTechnique(0, cache->GetResource<Technique>("Techniques/SkyConvert.xml")->CloneWithDefines(String::EMPTY,
+			mapping == SKY_EQUIRECT ? "EQUIRECT" : "OCTAHEDRAL"));
+		m->SetTexture(TU_DIFFUSE, source);
+		quad->SetMaterial(m);
+
+		view_ = new Viewport(context_, scene, CreateMapCamera(node_));
+		view_->SetRenderPath(cache->GetResource<XMLFile>("RenderPaths/SpaceBoxConvert.xml"));
+		QueueUpdate();
+		return true;
+	}
+
+	bool SpaceBoxMapRenderer::StartLive(Scene* scene, int size, int tileGrid)
+	{
+		auto* cache = GetSubsystem<ResourceCache>();
+		Release();
+		if (!CreateMap(size, size, SKY_OCTAHEDRAL))
+			return false;
+		live_ = true;
+
+		/*the layer quads sit at z = 1 in front of an orthographic camera covering [-1, 1]^2*/
+		node_ = scene->CreateChild("Live camera");
+		XMLFile* renderPath = cache->GetResource<XMLFile>("RenderPaths/SpaceBoxLive.xml");
+		view_ = new Viewport(context_, scene, CreateMapCamera(node_));
+		view_->SetRenderPath(renderPath);
+
+		if (tileGrid > 0)
+		{
+			const int tileSize = size / tileGrid;
+			for (int y = 0; y < tileGrid; ++y)
+			{
+				for (int x = 0; x < tileGrid; ++x)
+				{
+					const IntRect rect(x * tileSize, y * tileSize, (x + 1) * tileSize, (y + 1) * tileSize);
+					Camera* camera = CreateMapCamera(node_);
+					FitCameraToRect(camera, rect, tileSize * tileGrid);
+					SharedPtr<Viewport> v(new Viewport(context_, scene, camera, rect));
+					v->SetRenderPath(renderPath);
+					tiles_.Push(v);
+				}
+			}
+		}
+		QueueUpdate();
+		return true;
+	}
+
+	void SpaceBoxMapRenderer::SetViews(Viewport* const* views, unsigned count)
+	{
+		RenderSurface* s = map_->GetRenderSurface();
+		s->SetNumViewports(count);
+		for (unsigned ii = 0; ii < count; ++ii)
+			s->SetViewport(ii, views[ii]);
+		if (count)
+			s->QueueUpdate();
+	}
+
+	void SpaceBoxMapRenderer::QueueUpdate()
+	{
+		if (!view_)
+			return;
+		Viewport* view = view_;
+		SetViews(&view, 1);
+	}
+
+	bool SpaceBoxMapRenderer::QueueTiles(unsigned count)
+	{
+		if (tiles_.Empty())
+			return false;
+		const bool roundStart = nextTile_ == 0;
+		PODVector<Viewport*> views;
+		for (unsigned ii = 0; ii < count && nextTile_ < tiles_.Size(); ++ii)
+			views.Push(tiles_[nextTile_++]);
+		if (nextTile_ == tiles_.Size())
+			nextTile_ = 0;
+		SetViews(views.Buffer(), views.Size());
+		return roundStart;
+	}
+
+	void SpaceBoxMapRenderer::Release()
+	{
+		/*only this object's viewports are on the map*/
+		if (map_)
+			map_->GetRenderSurface()->SetNumViewports(0);
+		if (node_)
+			node_->Remove();
+		node_ = nullptr;
+		view_ = nullptr;
+		tiles_.Clear();
+		nextTile_ = 0;
+	}
+}
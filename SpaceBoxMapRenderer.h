@@ -0,0 +1,60 @@
+#pragma once
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Graphics/Texture2D.h>
+#include "SkyProjection.h"
+
+namespace Urho3D
+{
+	class Camera;
+	class Model;
+	class Node;
+	class Scene;
+	class TextureCube;
+	class Viewport;
+
+	/*
+	Draws a 2D sky map (SkyProjection.h) with the generator's scene: a cube converted by one quad for skyOutput,
+	or every layer evaluated per texel of an octahedral map in live mode. It owns the map's render target and the
+	viewports drawing into it; Release() detaches them, the map itself stays valid as the sky.
+	*/
+	class SpaceBoxMapRenderer : public Object
+	{
+		URHO3D_OBJECT(SpaceBoxMapRenderer, Object);
+	public:
+		explicit SpaceBoxMapRenderer(Context* context);
+
+		/*a map of about the texel density of source, drawn from it once per QueueUpdate(); queued once now*/
+		bool StartConversion(Scene* scene, TextureCube* source, SkyMapping mapping);
+		/*a size^2 octahedral map of the scene's live passes, queued whole now; tileGrid > 0 also splits it into
+		tileGrid^2 tiles for QueueTiles*/
+		bool StartLive(Scene* scene, int size, int tileGrid);
+		/*render the whole map next frame*/
+		void QueueUpdate();
+		/*render the next tiles next frame; true when they start a new round over the map*/
+		bool QueueTiles(unsigned count);
+		void Release();
+
+		Texture2D* GetMap() const { return map_; }
+		SkyMapping GetMapping() const { return mapping_; }
+		bool IsLive() const { return live_; }
+		bool HasTiles() const { return !tiles_.Empty(); }
+
+		/*a quad at z = 1 filling the orthographic map camera; never culled*/
+		static Model* CreateQuad(Context* context);
+
+	private:
+		bool CreateMap(int width, int height, SkyMapping mapping);
+		void SetViews(Viewport* const* views, unsigned count);
+
+		SharedPtr<Texture2D> map_;
+		SkyMapping mapping_{ SKY_CUBE };
+		bool live_{ false };
+		SharedPtr<Node> node_;
+		SharedPtr<Viewport> view_;
+		Vector<SharedPtr<Viewport> > tiles_;
+		unsigned nextTile_{ 0 };
+	};
+
+	/*point a camera at a pixel rectangle of a size^2 target: zoom to its size and shift its center to the middle*/
+	void FitCameraToRect(Camera* camera, const IntRect& rect, int size);
+}
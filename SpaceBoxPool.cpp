@@ -0,0 +1,121 @@
+#include "SpaceBoxPool.h"
+#include <Urho3D/Urho3DAll.h>
+
+namespace Urho3D
+{
+	SpaceBoxPool::SpaceBoxPool(Context* context) : Object(context) {}
+
+	SpaceBoxPool::~SpaceBoxPool() {}
+
+	SpaceBoxPool* SpaceBoxPool::Get(Context* context)
+	{
+		auto* pool = context->GetSubsystem<SpaceBoxPool>();
+		if (!pool)
+		{
+			pool = new SpaceBoxPool(context);
+			context->RegisterSubsystem(pool);
+		}
+		return pool;
+	}
+
+	TextureCube* SpaceBoxPool::AcquireCube(int size, unsigned format, bool mips)
+	{
+		for (unsigned ii = 0; ii < entries_.Size(); ++ii)
+		{
+			Entry& e = entries_[ii];
+			if (!IsFree(e) || e.texture->GetWidth() != size || e.format != format || e.mips != mips)
+				continue;
+			/*drop what the last user left on the surfaces, a viewport would keep its scene alive*/
+			for (unsigned face = 0; face < MAX_CUBEMAP_FACES; ++face)
+			{
+				RenderSurface* s = e.texture->GetRenderSurface((CubeMapFace)face);
+				s->SetNumViewports(0);
+				s->SetUpdateMode(SURFACE_MANUALUPDATE);
+			}
+			e.lastUse = ++clock_;
+			++numReuses_;
+			SendPoolEvent(POOL_REUSE, e);
+			return e.texture;
+		}
+
+		Entry e;
+		e.texture = MakeShared<TextureCube>(context_);
+		e.texture->SetNumLevels(mips ? 0 : 1);
+		if (!e.texture->SetSize(size, format, TEXTURE_RENDERTARGET))
+			return nullptr;
+		e.format = format;
+		e.mips = mips;
+		e.bytes = 0;
+		for (unsigned level = 0; level < e.texture->GetLevels(); ++level)
+		{
+			const int levelSize = e.texture->GetLevelWidth(level);
+			e.bytes += (unsigned long long)e.texture->GetDataSize(levelSize, levelSize) * MAX_CUBEMAP_FACES;
+		}
+		for (unsigned face = 0; face < MAX_CUBEMAP_FACES; ++face)
+			e.texture->GetRenderSurface((CubeMapFace)face)->SetUpdateMode(SURFACE_MANUALUPDATE);
+		e.lastUse = ++clock_;
+
+		/*make room first, the new cube is not free yet*/
+		const unsigned long long cap = (unsigned long long)Max(memoryCapMB, 0) << 20;
+		Evict(cap > e.bytes ? cap - e.bytes : 0);
+		entries_.Push(e);
+		bytesHeld_ += e.bytes;
+		++numAllocations_;
+		SendPoolEvent(POOL_ALLOCATE, e);
+		return e.texture;
+	}
+
+	void SpaceBoxPool::Trim()
+	{
+		Evict((unsigned long long)Max(memoryCapMB, 0) << 20);
+	}
+
+	void SpaceBoxPool::ReleaseFree()
+	{
+		Evict(0);
+	}
+
+	unsigned long long SpaceBoxPool::GetBytesFree() const
+	{
+		unsigned long long bytes = 0;
+		for (unsigned ii = 0; ii < entries_.Size(); ++ii)
+		{
+			if (IsFree(entries_[ii]))
+				bytes += entries_[ii].bytes;
+		}
+		return bytes;
+	}
+
+	/*least recently used free cubes first; cubes in use are never evicted, so the pool may stay above the limit*/
+	void SpaceBoxPool::Evict(unsigned long long limit)
+	{
+		while (bytesHeld_ > limit)
+		{
+			unsigned oldest = M_MAX_UNSIGNED;
+			for (unsigned ii = 0; ii < entries_.Size(); ++ii)
+			{
+				if (IsFree(entries_[ii]) && (oldest == M_MAX_UNSIGNED || entries_[ii].lastUse < entries_[oldest].lastUse))
+					oldest = ii;
+			}
+			if (oldest == M_MAX_UNSIGNED)
+				return;
+
+			const Entry e = entries_[oldest];
+			entries_.Erase(oldest);
+			bytesHeld_ -= e.bytes;
+			++numEvictions_;
+			SendPoolEvent(POOL_EVICT, e);
+		}
+	}
+
+	void SpaceBoxPool::SendPoolEvent(SpaceBoxPoolAction action, const Entry& entry)
+	{
+		using namespace SpaceBoxPoolEvt;
+		VariantMap& data = GetEventDataMap();
+		data[P_ACTION] = (int)action;
+		data[P_SIZE] = entry.texture->GetWidth();
+		data[P_BYTES] = entry.bytes;
+		data[P_HELD] = bytesHeld_;
+		SendEvent(E_SPACEBOXPOOL, data);
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Graphics/TextureCube.h>
+
+namespace Urho3D
+{
+	enum SpaceBoxPoolAction
+	{
+		POOL_ALLOCATE = 0,
+		POOL_REUSE,
+		POOL_EVICT
+	};
+
+	/*a cube was created, handed out again or destroyed*/
+	URHO3D_EVENT(E_SPACEBOXPOOL, SpaceBoxPoolEvt)
+	{
+		URHO3D_PARAM(P_ACTION, Action); // int SpaceBoxPoolAction
+		URHO3D_PARAM(P_SIZE, Size); // int
+		URHO3D_PARAM(P_BYTES, Bytes); // unsigned long long, of this cube
+		URHO3D_PARAM(P_HELD, Held); // unsigned long long, all cubes of the pool after the action
+	}
+
+	/*
+	Cube render targets shared by all generators, keyed by size, format and mips, so a new sky or another
+	size step does not destroy and recreate textures, framebuffer attachments and surfaces.
+	A cube is free again when only the pool references it; free cubes are evicted least recently used
+	first whenever the pool holds more than memoryCapMB.
+	*/
+	class SpaceBoxPool : public Object
+	{
+		URHO3D_OBJECT(SpaceBoxPool, Object);
+	public:
+		explicit SpaceBoxPool(Context* context);
+		~SpaceBoxPool();
+
+		/*the subsystem, created on first use*/
+		static SpaceBoxPool* Get(Context* context);
+
+		/*a free cube of that kind, or a new one; its surfaces are manual and have no viewports. Null on failure*/
+		TextureCube* AcquireCube(int size, unsigned format, bool mips);
+		/*evict free cubes until the pool is within memoryCapMB*/
+		void Trim();
+		/*drop every free cube*/
+		void ReleaseFree();
+
+		unsigned long long GetBytesHeld() const { return bytesHeld_; }
+		unsigned long long GetBytesFree() const;
+		unsigned GetNumCubes() const { return entries_.Size(); }
+		unsigned GetNumAllocations() const { return numAllocations_; }
+		unsigned GetNumReuses() const { return numReuses_; }
+		unsigned GetNumEvictions() const { return numEvictions_; }
+
+		int memoryCapMB{ 256 };
+
+	private:
+		struct Entry
+		{
+			SharedPtr<TextureCube> texture;
+			unsigned format;
+			bool mips;
+			unsigned long long bytes;
+			unsigned lastUse;
+		};
+
+		bool IsFree(const Entry& entry) const { return entry.texture->Refs() == 1; }
+		void Evict(unsigned long long limit);
+		void SendPoolEvent(SpaceBoxPoolAction action, const Entry& entry);
+
+		Vector<Entry> entries_;
+		unsigned long long bytesHeld_{ 0 };
+		unsigned clock_{ 0 };
+		unsigned numAllocations_{ 0 };
+		unsigned numReuses_{ 0 };
+		unsigned numEvictions_{ 0 };
+	};
+}
@@ -0,0 +1,288 @@
+#include "SpaceBoxScheduler.h"
+#include "SpaceBoxGen.h"
+#include "ShaderWarmup.h"
+#include <Urho3D/Urho3DAll.h>
+
+namespace Urho3D
+{
+	/*the switches Generate() reads, so a request can be compared with the generation in flight*/
+	struct SpaceBoxSettings
+	{
+		bool point_star_enable;
+		bool bright_star_enable;
+		bool nebula_enable;
+		bool sun_enable;
+		int cubeSize;
+		bool cubeMips;
+		bool fitToBudget;
+		int memoryBudgetMB;
+		int previewSize;
+		float nebulaResolution;
+		int nebulaSteps;
+		bool animateNebula;
+		bool dynamicLayers;
+		bool liveMode;
+		int liveCacheSize;
+		SkyMapping skyOutput;
+	};
+
+	struct SpaceBoxJob
+	{
+		WeakPtr<SpaceBoxGen> gen;
+		SpaceBoxPriority priority;
+		bool newSeed;
+		unsigned seed;
+		/*save to this cache file when done*/
+		String bakeFile;
+		/*clock of the first request merged into the job*/
+		long long requested;
+		/*taken when the job starts*/
+		SpaceBoxSettings settings;
+	};
+
+	static SpaceBoxSettings GetSettings(const SpaceBoxGen* gen)
+	{
+		SpaceBoxSettings s;
+		s.point_star_enable = gen->point_star_enable;
+		s.bright_star_enable = gen->bright_star_enable;
+		s.nebula_enable = gen->nebula_enable;
+		s.sun_enable = gen->sun_enable;
+		s.cubeSize = gen->cubeSize;
+		s.cubeMips = gen->cubeMips;
+		s.fitToBudget = gen->fitToBudget;
+		s.memoryBudgetMB = gen->memoryBudgetMB;
+		s.previewSize = gen->previewSize;
+		s.nebulaResolution = gen->nebulaResolution;
+		s.nebulaSteps = gen->nebulaSteps;
+		s.animateNebula = gen->animateNebula;
+		s.dynamicLayers = gen->dynamicLayers;
+		s.liveMode = gen->liveMode;
+		s.liveCacheSize = gen->liveCacheSize;
+		s.skyOutput = gen->skyOutput;
+		return s;
+	}
+
+	static bool SameSettings(const SpaceBoxSettings& a, const SpaceBoxSettings& b)
+	{
+		return a.point_star_enable == b.point_star_enable && a.bright_star_enable == b.bright_star_enable &&
+			a.nebula_enable == b.nebula_enable && a.sun_enable == b.sun_enable && a.cubeSize == b.cubeSize &&
+			a.cubeMips == b.cubeMips && a.fitToBudget == b.fitToBudget && a.memoryBudgetMB == b.memoryBudgetMB &&
+			a.previewSize == b.previewSize && a.nebulaResolution == b.nebulaResolution && a.nebulaSteps == b.nebulaSteps &&
+			a.animateNebula == b.animateNebula && a.dynamicLayers == b.dynamicLayers && a.liveMode == b.liveMode &&
+			a.liveCacheSize == b.liveCacheSize && a.skyOutput == b.skyOutput;
+	}
+
+	SpaceBoxScheduler::SpaceBoxScheduler(Context* context) : Object(context) {}
+
+	SpaceBoxScheduler::~SpaceBoxScheduler()
+	{
+		for (unsigned ii = 0; ii < queue_.Size(); ++ii)
+			delete queue_[ii];
+		for (unsigned ii = 0; ii < inFlight_.Size(); ++ii)
+			delete inFlight_[ii];
+	}
+
+	void SpaceBoxScheduler::Request(SpaceBoxGen* gen, SpaceBoxPriority priority)
+	{
+		Enqueue(gen, true, 0, priority, String::EMPTY);
+	}
+
+	void SpaceBoxScheduler::Request(SpaceBoxGen* gen, unsigned seed, SpaceBoxPriority priority)
+	{
+		Enqueue(gen, false, seed, priority, String::EMPTY);
+	}
+
+	void SpaceBoxScheduler::Prebake(SpaceBoxGen* gen, unsigned seed, const String& fileName)
+	{
+		Enqueue(gen, false, seed, PRIORITY_BACKGROUND, fileName);
+	}
+
+	void SpaceBoxScheduler::Cancel(SpaceBoxGen* gen)
+	{
+		for (unsigned ii = queue_.Size(); ii-- > 0;)
+		{
+			if (queue_[ii]->gen.Get() == gen)
+			{
+				delete queue_[ii];
+				queue_.Erase(ii);
+			}
+		}
+		const int index = FindInFlight(gen);
+		if (index >= 0)
+			StopInFlight((unsigned)index, false);
+	}
+
+	void SpaceBoxScheduler::Enqueue(SpaceBoxGen* gen, bool newSeed, unsigned seed, SpaceBoxPriority priority, const String& bakeFile)
+	{
+		if (!gen)
+			return;
+		SubscribeToEvent(E_POSTUPDATE, URHO3D_HANDLER(SpaceBoxScheduler, HandlePostUpdate));
+
+		/*one job per generator: the latest request wins, the first one's time and the highest priority are kept*/
+		for (unsigned ii = 0; ii < queue_.Size(); ++ii)
+		{
+			SpaceBoxJob* job = queue_[ii];
+			if (job->gen.Get() != gen)
+				continue;
+			job->newSeed = newSeed;
+			job->seed = seed;
+			job->priority = Max(job->priority, priority);
+			job->bakeFile = bakeFile;
+			++numCoalesced_;
+			return;
+		}
+
+		auto* job = new SpaceBoxJob();
+		job->gen = gen;
+		job->priority = priority;
+		job->newSeed = newSeed;
+		job->seed = seed;
+		job->bakeFile = bakeFile;
+		job->requested = clock_.GetUSec(false);
+		queue_.Push(job);
+	}
+
+	int SpaceBoxScheduler::FindInFlight(SpaceBoxGen* gen) const
+	{
+		for (unsigned ii = 0; ii < inFlight_.Size(); ++ii)
+		{
+			if (inFlight_[ii]->gen.Get() == gen)
+				return (int)ii;
+		}
+		return -1;
+	}
+
+	bool SpaceBoxScheduler::VisibleBusy() const
+	{
+		for (unsigned ii = 0; ii < queue_.Size(); ++ii)
+		{
+			if (queue_[ii]->priority == PRIORITY_VISIBLE)
+				return true;
+		}
+		for (unsigned ii = 0; ii < inFlight_.Size(); ++ii)
+		{
+			if (inFlight_[ii]->priority == PRIORITY_VISIBLE)
+				return true;
+		}
+		return false;
+	}
+
+	void SpaceBoxScheduler::Start(SpaceBoxJob* job)
+	{
+		SpaceBoxGen* gen = job->gen;
+		const int index = FindInFlight(gen);
+		if (index >= 0)
+		{
+			/*the same sky is already on its way*/
+			if (!job->newSeed && job->seed == inFlight_[index]->seed && SameSettings(GetSettings(gen), inFlight_[index]->settings))
+			{
+				++numCoalesced_;
+				delete job;
+				return;
+			}
+			StopInFlight((unsigned)index, false);
+		}
+
+		job->settings = GetSettings(gen);
+		SubscribeToEvent(gen, E_SPACEBOXREADY, URHO3D_HANDLER(SpaceBoxScheduler, HandleReady));
+		inFlight_.Push(job);
+		if (job->newSeed)
+			gen->Generate();
+		else
+			gen->Generate(job->seed);
+		job->newSeed = false;
+		job->seed = gen->GetSeed();
+	}
+
+	void SpaceBoxScheduler::StopInFlight(unsigned index, bool requeue)
+	{
+		SpaceBoxJob* job = inFlight_[index];
+		inFlight_.Erase(index);
+		if (job->gen)
+			job->gen->Cancel();
+		++numCancelled_;
+		if (requeue)
+			queue_.Insert(0, job);
+		else
+			delete job;
+	}
+
+	void SpaceBoxScheduler::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
+	{
+		/*generators that were destroyed or stopped without finishing*/
+		for (unsigned ii = inFlight_.Size(); ii-- > 0;)
+		{
+			if (!inFlight_[ii]->gen || !inFlight_[ii]->gen->IsGenerating())
+			{
+				delete inFlight_[ii];
+				inFlight_.Erase(ii);
+				++numCancelled_;
+			}
+		}
+		for (unsigned ii = queue_.Size(); ii-- > 0;)
+		{
+			if (!queue_[ii]->gen)
+			{
+				delete queue_[ii];
+				queue_.Erase(ii);
+			}
+		}
+
+		/*nothing starts while shaders are still compiling, the current sky stays meanwhile*/
+		auto* warmup = GetSubsystem<ShaderWarmup>();
+		if (warmup && !warmup->IsComplete())
+			return;
+
+		/*visible requests in request order*/
+		for (unsigned ii = 0; ii < queue_.Size();)
+		{
+			if (queue_[ii]->priority != PRIORITY_VISIBLE)
+			{
+				++ii;
+				continue;
+			}
+			SpaceBoxJob* job = queue_[ii];
+			queue_.Erase(ii);
+			Start(job);
+		}
+
+		/*background work waits for the visible sky, one generation at a time*/
+		if (VisibleBusy())
+		{
+			for (unsigned ii = inFlight_.Size(); ii-- > 0;)
+			{
+				if (inFlight_[ii]->priority == PRIORITY_BACKGROUND)
+					StopInFlight(ii, true);
+			}
+		}
+		else if (inFlight_.Empty() && !queue_.Empty())
+		{
+			SpaceBoxJob* job = queue_.Front();
+			queue_.Erase(0);
+			Start(job);
+		}
+
+		if (queue_.Empty())
+			UnsubscribeFromEvent(E_POSTUPDATE);
+	}
+
+	void SpaceBoxScheduler::HandleReady(StringHash eventType, VariantMap& eventData)
+	{
+		if (!eventData[SpaceBoxReady::P_FINAL].GetBool())
+			return;
+		auto* gen = static_cast<SpaceBoxGen*>(GetEventSender());
+		const int index = FindInFlight(gen);
+		if (index < 0)
+			return;
+
+		SpaceBoxJob* job = inFlight_[index];
+		inFlight_.Erase((unsigned)index);
+		lastLatency_ = clock_.GetUSec(false) - job->requested;
+		maxLatency_ = Max(maxLatency_, lastLatency_);
+		totalLatency_ += lastLatency_;
+		++numCompleted_;
+		if (!job->bakeFile.Empty() && !gen->SaveToCache(job->bakeFile))
+			URHO3D_LOGWARNING("SpaceBoxScheduler: could not save " + job->bakeFile);
+		delete job;
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+
+namespace Urho3D
+{
+	class SpaceBoxGen;
+	struct SpaceBoxJob;
+
+	enum SpaceBoxPriority
+	{
+		/*pre-bakes, only run while no visible sky is queued or generating*/
+		PRIORITY_BACKGROUND = 0,
+		PRIORITY_VISIBLE
+	};
+
+	/*
+	Sits in front of SpaceBoxGen::Generate(). Requests only mark a generator; all requests of a frame are
+	merged and dispatched at E_POSTUPDATE, so dragging through a list or clicking several switches costs one
+	generation. A request replaces the generation in flight unless it would give the same sky (same seed and
+	switches). Visible requests go first and cancel a background generation in flight, which is queued again.
+	Set the generator's switches, then call Request().
+	*/
+	class SpaceBoxScheduler : public Object
+	{
+		URHO3D_OBJECT(SpaceBoxScheduler, Object);
+	public:
+		explicit SpaceBoxScheduler(Context* context);
+		~SpaceBoxScheduler();
+
+		/*regenerate with a new seed*/
+		void Request(SpaceBoxGen* gen, SpaceBoxPriority priority = PRIORITY_VISIBLE);
+		/*regenerate with the given seed*/
+		void Request(SpaceBoxGen* gen, unsigned seed, SpaceBoxPriority priority = PRIORITY_VISIBLE);
+		/*generate in the background and save to a cache file when done*/
+		void Prebake(SpaceBoxGen* gen, unsigned seed, const String& fileName);
+		/*drop queued requests of a generator and stop its generation*/
+		void Cancel(SpaceBoxGen* gen);
+
+		/*requests waiting for dispatch, and generations started and not finished*/
+		unsigned GetQueueDepth() const { return queue_.Size(); }
+		unsigned GetNumInFlight() const { return inFlight_.Size(); }
+		/*from the first request merged into a job until its final level was ready, milliseconds*/
+		float GetLastLatencyMs() const { return lastLatency_ / 1000.0f; }
+		float GetMaxLatencyMs() const { return maxLatency_ / 1000.0f; }
+		float GetAverageLatencyMs() const { return numCompleted_ ? (float)(totalLatency_ / numCompleted_) / 1000.0f : 0.0f; }
+		unsigned GetNumCompleted() const { return numCompleted_; }
+		/*requests merged into a queued job or matching the generation in flight*/
+		unsigned GetNumCoalesced() const { return numCoalesced_; }
+		/*generations stopped before they finished*/
+		unsigned GetNumCancelled() const { return numCancelled_; }
+
+	private:
+		void Enqueue(SpaceBoxGen* gen, bool newSeed, unsigned seed, SpaceBoxPriority priority, const String& bakeFile);
+		void Start(SpaceBoxJob* job);
+		void StopInFlight(unsigned index, bool requeue);
+		int FindInFlight(SpaceBoxGen* gen) const;
+		bool VisibleBusy() const;
+		void HandlePostUpdate(StringHash eventType, VariantMap& eventData);
+		void HandleReady(StringHash eventType, VariantMap& eventData);
+
+		PODVector<SpaceBoxJob*> queue_;
+		PODVector<SpaceBoxJob*> inFlight_;
+		HiresTimer clock_;
+		long long lastLatency_{ 0 };
+		long long maxLatency_{ 0 };
+		long long totalLatency_{ 0 };
+		unsigned numCompleted_{ 0 };
+		unsigned numCoalesced_{ 0 };
+		unsigned numCancelled_{ 0 };
+	};
+}
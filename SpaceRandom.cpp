@@ -0,0 +1,230 @@
+#include "SpaceRandom.h"
+
+#ifdef URHO3D_SSE
+#include <emmintrin.h>
+#endif
+
+namespace Urho3D
+{
+	/*xoshiro128 jump polynomials: 2^64 steps and 2^96 steps*/
+	static const unsigned JUMP[4] = { 0x8764000b, 0xf542d2d3, 0x6fa035c3, 0x77f2db5b };
+	static const unsigned LONG_JUMP[4] = { 0xb523952e, 0x0b6f099f, 0xccf5a0ef, 0x1c580662 };
+
+	static const float FLOAT_SCALE = 1.0f / 16777216.0f;
+
+	static inline unsigned Rotl(unsigned x, int k)
+	{
+		return (x << k) | (x >> (32 - k));
+	}
+
+	static inline float ToFloat(unsigned x)
+	{
+		return (float)(x >> 8) * FLOAT_SCALE;
+	}
+
+	static unsigned long long SplitMix64(unsigned long long& x)
+	{
+		unsigned long long z = (x += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	}
+
+	static void StepLane(unsigned s[4])
+	{
+		const unsigned t = s[1] << 9;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = Rotl(s[3], 11);
+	}
+
+	static void JumpLane(unsigned s[4], const unsigned poly[4])
+	{
+		unsigned j[4] = { 0, 0, 0, 0 };
+		for (unsigned i = 0; i < 4; ++i)
+		{
+			for (unsigned b = 0; b < 32; ++b)
+			{
+				if (poly[i] & (1u << b))
+				{
+					j[0] ^= s[0];
+					j[1] ^= s[1];
+					j[2] ^= s[2];
+					j[3] ^= s[3];
+				}
+				StepLane(s);
+			}
+		}
+		for (unsigned i = 0; i < 4; ++i)
+			s[i] = j[i];
+	}
+
+	SpaceRandom::SpaceRandom(unsigned seed, unsigned stream)
+	{
+		Seed(seed, stream);
+	}
+
+	void SpaceRandom::Seed(unsigned seed, unsigned stream)
+	{
+		unsigned long long x = ((unsigned long long)seed << 32) | stream;
+		unsigned lane[4];
+		do
+		{
+			unsigned long long a = SplitMix64(x);
+			unsigned long long b = SplitMix64(x);
+			lane[0] = (unsigned)a;
+			lane[1] = (unsigned)(a >> 32);
+			lane[2] = (unsigned)b;
+			lane[3] = (unsigned)(b >> 32);
+		} while ((lane[0] | lane[1] | lane[2] | lane[3]) == 0);
+
+		/*lanes are 2^96 steps apart, so Jump() (2^64) can be used 2^32 times without overlap*/
+		for (unsigned l = 0; l < 4; ++l)
+		{
+			for (unsigned w = 0; w < 4; ++w)
+				state_[w][l] = lane[w];
+			JumpLane(lane, LONG_JUMP);
+		}
+		next_ = 4;
+	}
+
+	void SpaceRandom::Jump()
+	{
+		for (unsigned l = 0; l < 4; ++l)
+		{
+			unsigned lane[4] = { state_[0][l], state_[1][l], state_[2][l], state_[3][l] };
+			JumpLane(lane, JUMP);
+			for (unsigned w = 0; w < 4; ++w)
+				state_[w][l] = lane[w];
+		}
+		next_ = 4;
+	}
+
+	void SpaceRandom::Step()
+	{
+#ifdef URHO3D_SSE
+		__m128i s0 = _mm_load_si128(reinterpret_cast<const __m128i*>(state_[0]));
+		__m128i s1 = _mm_load_si128(reinterpret_cast<const __m128i*>(state_[1]));
+		__m128i s2 = _mm_load_si128(reinterpret_cast<const __m128i*>(state_[2]));
+		__m128i s3 = _mm_load_si128(reinterpret_cast<const __m128i*>(state_[3]));
+
+		_mm_store_si128(reinterpret_cast<__m128i*>(output_), _mm_add_epi32(s0, s3));
+
+		const __m128i t = _mm_slli_epi32(s1, 9);
+		s2 = _mm_xor_si128(s2, s0);
+		s3 = _mm_xor_si128(s3, s1);
+		s1 = _mm_xor_si128(s1, s2);
+		s0 = _mm_xor_si128(s0, s3);
+		s2 = _mm_xor_si128(s2, t);
+		s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+
+		_mm_store_si128(reinterpret_cast<__m128i*>(state_[0]), s0);
+		_mm_store_si128(reinterpret_cast<__m128i*>(state_[1]), s1);
+		_mm_store_si128(reinterpret_cast<__m128i*>(state_[2]), s2);
+		_mm_store_si128(reinterpret_cast<__m128i*>(state_[3]), s3);
+#else
+		for (unsigned l = 0; l < 4; ++l)
+		{
+			unsigned lane[4] = { state_[0][l], state_[1][l], state_[2][l], state_[3][l] };
+			output_[l] = lane[0] + lane[3];
+			StepLane(lane);
+			for (unsigned w = 0; w < 4; ++w)
+				state_[w][l] = lane[w];
+		}
+#endif
+		next_ = 0;
+	}
+
+	unsigned SpaceRandom::NextUInt()
+	{
+		if (next_ == 4)
+			Step();
+		return output_[next_++];
+	}
+
+	float SpaceRandom::Next()
+	{
+		return ToFloat(NextUInt());
+	}
+
+	void SpaceRandom::FillUniform(float* out, unsigned count)
+	{
+		unsigned i = 0;
+		while (i < count && next_ < 4)
+			out[i++] = Next();
+
+		for (; i + 4 <= count; i += 4)
+		{
+			Step();
+#ifdef URHO3D_SSE
+			__m128i bits = _mm_srli_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(output_)), 8);
+			_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(bits), _mm_set1_ps(FLOAT_SCALE)));
+#else
+			for (unsigned l = 0; l < 4; ++l)
+				out[i + l] = ToFloat(output_[l]);
+#endif
+			next_ = 4;
+		}
+
+		while (i < count)
+			out[i++] = Next();
+	}
+
+	void SpaceRandom::FillUnitVectors(Vector3* out, unsigned count)
+	{
+		unsigned i = 0;
+		while (i < count && next_ < 4)
+		{
+			out[i] = Vector3(Next(-1.0f, 1.0f), Next(-1.0f, 1.0f), Next(-1.0f, 1.0f));
+			out[i++].Normalize();
+		}
+
+		alignas(16) unsigned bits[3][4];
+		alignas(16) float coords[3][4];
+		for (; i + 4 <= count; i += 4)
+		{
+			for (unsigned c = 0; c < 3; ++c)
+			{
+				Step();
+				for (unsigned l = 0; l < 4; ++l)
+					bits[c][l] = output_[l];
+			}
+			next_ = 4;
+
+#ifdef URHO3D_SSE
+			const __m128 scale = _mm_set1_ps(2.0f * FLOAT_SCALE);
+			const __m128 one = _mm_set1_ps(1.0f);
+			__m128 v[3];
+			for (unsigned c = 0; c < 3; ++c)
+			{
+				__m128i b = _mm_srli_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(bits[c])), 8);
+				v[c] = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(b), scale), one);
+			}
+			__m128 lenSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(v[0], v[0]), _mm_mul_ps(v[1], v[1])), _mm_mul_ps(v[2], v[2]));
+			__m128 invLen = _mm_div_ps(one, _mm_sqrt_ps(_mm_max_ps(lenSq, _mm_set1_ps(M_EPSILON))));
+			for (unsigned c = 0; c < 3; ++c)
+				_mm_store_ps(coords[c], _mm_mul_ps(v[c], invLen));
+#else
+			for (unsigned l = 0; l < 4; ++l)
+			{
+				Vector3 v(ToFloat(bits[0][l]) * 2.0f - 1.0f, ToFloat(bits[1][l]) * 2.0f - 1.0f, ToFloat(bits[2][l]) * 2.0f - 1.0f);
+				v *= 1.0f / sqrtf(Max(v.LengthSquared(), M_EPSILON));
+				coords[0][l] = v.x_;
+				coords[1][l] = v.y_;
+				coords[2][l] = v.z_;
+			}
+#endif
+			for (unsigned l = 0; l < 4; ++l)
+				out[i + l] = Vector3(coords[0][l], coords[1][l], coords[2][l]);
+		}
+
+		while (i < count)
+		{
+			out[i] = Vector3(Next(-1.0f, 1.0f), Next(-1.0f, 1.0f), Next(-1.0f, 1.0f));
+			out[i++].Normalize();
+		}
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <Urho3D/Urho3D.h>
+#include <Urho3D/Math/Vector3.h>
+
+namespace Urho3D
+{
+	/*
+	xoshiro128+ generator with private state, so every generator / worker thread can own one.
+	Four independent lanes are stepped together, which lets FillUniform / FillUnitVectors produce
+	4 values per step with SSE2. FillUniform returns exactly what the same number of Next() calls would;
+	FillUnitVectors advances the state as far as three Next() per vector, but see its order below.
+	*/
+	class SpaceRandom
+	{
+	public:
+		/*different streams of the same seed give unrelated sequences*/
+		explicit SpaceRandom(unsigned seed = 1, unsigned stream = 0);
+
+		void Seed(unsigned seed, unsigned stream = 0);
+		/*advance by 2^64 steps per lane; jump once per worker to split work without overlap*/
+		void Jump();
+
+		unsigned NextUInt();
+		/*uniform in [0, 1)*/
+		float Next();
+		/*uniform in [0, range)*/
+		float Next(float range) { return Next() * range; }
+		/*uniform in [min, max)*/
+		float Next(float min, float max) { return Next() * (max - min) + min; }
+
+		/*uniform floats in [0, 1)*/
+		void FillUniform(float* out, unsigned count);
+		/*random directions, a point in [-1, 1]^3 normalized. Blocks of four take x / y / z of lane l from the
+		outputs l, 4 + l and 8 + l, so they differ from normalized Next() triples; only a seed's sky depends on it*/
+		void FillUnitVectors(Vector3* out, unsigned count);
+
+	private:
+		void Step();
+
+		/*state_[word][lane], so one word of all lanes is one SSE register*/
+		alignas(16) unsigned state_[4][4];
+		alignas(16) unsigned output_[4];
+		unsigned next_;
+	};
+}
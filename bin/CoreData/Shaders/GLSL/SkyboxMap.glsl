@@ -0,0 +1,27 @@
+#include "Uniforms.glsl"
+#include "Samplers.glsl"
+#include "Transform.glsl"
+#include "octahedral.glsl"
+#include "equirect.glsl"
+
+varying vec3 vTexCoord;
+
+void VS()
+{
+    mat4 modelMatrix = iModelMatrix;
+    vec3 worldPos = GetWorldPos(modelMatrix);
+    gl_Position = GetClipPos(worldPos);
+    gl_Position.z = gl_Position.w;
+    vTexCoord = iPos.xyz;
+}
+
+void PS()
+{
+    // The sky as one 2D map, OCTAHEDRAL or EQUIRECT
+    #ifdef EQUIRECT
+        vec2 texCoord = equirectTexCoord(normalize(vTexCoord));
+    #else
+        vec2 texCoord = octTexCoord(normalize(vTexCoord));
+    #endif
+    gl_FragColor = cMatDiffColor * texture2D(sDiffMap, texCoord);
+}
@@ -0,0 +1,14 @@
+// Equirectangular map of directions: longitude atan2(x, z) along u, latitude from +y on row 0 to -y on the last row.
+
+#define EQUIRECT_PI 3.14159265
+
+vec2 equirectTexCoord(vec3 d) {
+    return vec2(0.5 + atan(d.x, d.z) * (0.5 / EQUIRECT_PI), 0.5 - asin(clamp(d.y, -1.0, 1.0)) * (1.0 / EQUIRECT_PI));
+}
+
+// p is the map position in [-1, 1]^2 with +y at the top
+vec3 equirectDecode(vec2 p) {
+    float lon = p.x * EQUIRECT_PI;
+    float lat = p.y * 0.5 * EQUIRECT_PI;
+    return vec3(cos(lat) * sin(lon), sin(lat), cos(lat) * cos(lon));
+}
@@ -2,21 +2,29 @@
 #include "Samplers.glsl"
 #include "Transform.glsl"
 #include "classicnoise4D.glsl"
+#include "octahedral.glsl"
 
 varying vec3 vPos;
 #ifdef COMPILEPS
+// Domain warp steps, set per quality tier by the technique (3..6). Each step costs 3 noise evaluations
+#ifndef NEBULA_STEPS
+#define NEBULA_STEPS 6
+#endif
+
 uniform vec3 cNebularColor;
 uniform vec3 cNebularOffset;
 uniform float cNebularScale;
 uniform float cNebularIntensity;
 uniform float cNebularFalloff;
+// Fourth noise dimension, advanced over time for a slow drift
+uniform float cNebularTime;
 
 float noise(vec3 p) {
-    return 0.5 * cnoise(vec4(p, 0)) + 0.5;
+    return 0.5 * cnoise(vec4(p, cNebularTime)) + 0.5;
 }
 
 float nebula(vec3 p) {
-    const int steps = 6;
+    const int steps = NEBULA_STEPS;
     float scale = pow(2.0, float(steps));
     vec3 displace = vec3(0.0);
     for (int i = 0; i < steps; i++) {
@@ -42,8 +50,17 @@ void VS()
 
 void PS()
 {
-	vec3 posn = normalize(vPos) * cNebularScale;
+	#ifdef OCTAHEDRAL
+		// drawn as a quad over the octahedral map, the position is the map coordinate
+		vec3 posn = octDecode(vPos.xy) * cNebularScale;
+	#else
+		vec3 posn = normalize(vPos) * cNebularScale;
+	#endif
     float c = min(1.0, nebula(posn + cNebularOffset) * cNebularIntensity);
     c = pow(c, cNebularFalloff);
-    gl_FragColor = vec4(cNebularColor, c);
+    #ifdef PREMULTIPLIED
+        gl_FragColor = vec4(cNebularColor * c, c);
+    #else
+        gl_FragColor = vec4(cNebularColor, c);
+    #endif
 }
@@ -0,0 +1,66 @@
+#include "Uniforms.glsl"
+#include "Samplers.glsl"
+#include "Transform.glsl"
+
+varying vec3 vPos;
+#ifdef COMPILEPS
+uniform float cNebulaSize;
+
+// Cubic B-spline through 4 bilinear taps. The taps are moved in the face plane and turned back into directions,
+// so near an edge they land on the neighbouring face instead of being clamped, and the upsample has no seams.
+vec4 sampleBicubic(vec3 dir) {
+    vec3 a = abs(dir);
+    vec3 major;
+    vec3 u;
+    vec3 v;
+    if (a.x >= a.y && a.x >= a.z) {
+        major = vec3(sign(dir.x), 0.0, 0.0);
+        u = vec3(0.0, 0.0, 1.0);
+        v = vec3(0.0, 1.0, 0.0);
+    } else if (a.y >= a.z) {
+        major = vec3(0.0, sign(dir.y), 0.0);
+        u = vec3(1.0, 0.0, 0.0);
+        v = vec3(0.0, 0.0, 1.0);
+    } else {
+        major = vec3(0.0, 0.0, sign(dir.z));
+        u = vec3(1.0, 0.0, 0.0);
+        v = vec3(0.0, 1.0, 0.0);
+    }
+    float m = max(a.x, max(a.y, a.z));
+    vec2 st = vec2(dot(dir, u), dot(dir, v)) / m;
+
+    vec2 texel = (st * 0.5 + 0.5) * cNebulaSize - 0.5;
+    vec2 i = floor(texel);
+    vec2 f = texel - i;
+    vec2 f2 = f * f;
+    vec2 f3 = f2 * f;
+    vec2 w0 = (-f3 + 3.0 * f2 - 3.0 * f + 1.0) / 6.0;
+    vec2 w1 = (3.0 * f3 - 6.0 * f2 + 4.0) / 6.0;
+    vec2 w2 = (-3.0 * f3 + 3.0 * f2 + 3.0 * f + 1.0) / 6.0;
+    vec2 w3 = f3 / 6.0;
+    vec2 g0 = w0 + w1;
+    vec2 g1 = w2 + w3;
+    vec2 h0 = ((i - 1.0 + w1 / g0 + 0.5) / cNebulaSize) * 2.0 - 1.0;
+    vec2 h1 = ((i + 1.0 + w3 / g1 + 0.5) / cNebulaSize) * 2.0 - 1.0;
+
+    return g0.y * (g0.x * textureCube(sDiffCubeMap, major + h0.x * u + h0.y * v) +
+                   g1.x * textureCube(sDiffCubeMap, major + h1.x * u + h0.y * v)) +
+           g1.y * (g0.x * textureCube(sDiffCubeMap, major + h0.x * u + h1.y * v) +
+                   g1.x * textureCube(sDiffCubeMap, major + h1.x * u + h1.y * v));
+}
+#endif
+
+void VS()
+{
+    mat4 modelMatrix = iModelMatrix;
+    vec3 worldPos = GetWorldPos(modelMatrix);
+    gl_Position = GetClipPos(worldPos);
+	
+    vPos = worldPos;
+}
+
+void PS()
+{
+    // Premultiplied color and coverage of all nebula layers
+    gl_FragColor = sampleBicubic(vPos);
+}
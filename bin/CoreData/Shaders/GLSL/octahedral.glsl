@@ -0,0 +1,27 @@
+// Octahedral map of directions: the upper half (z >= 0) fills the inner diamond of [-1, 1]^2,
+// the lower half is folded over its edges into the corners.
+
+vec2 octSign(vec2 v) {
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 octEncode(vec3 d) {
+    d /= abs(d.x) + abs(d.y) + abs(d.z);
+    vec2 p = d.xy;
+    if (d.z < 0.0)
+        p = (1.0 - abs(p.yx)) * octSign(p);
+    return p;
+}
+
+vec3 octDecode(vec2 p) {
+    vec3 d = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+    if (d.z < 0.0)
+        d.xy = (1.0 - abs(d.yx)) * octSign(d.xy);
+    return normalize(d);
+}
+
+// Texture coordinates of a direction. The map is rendered like any render target, so +y is row 0
+vec2 octTexCoord(vec3 d) {
+    vec2 p = octEncode(d);
+    return vec2(0.5 + 0.5 * p.x, 0.5 - 0.5 * p.y);
+}
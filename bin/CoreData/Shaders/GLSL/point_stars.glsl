@@ -1,6 +1,7 @@
 #include "Uniforms.glsl"
 #include "Samplers.glsl"
 #include "Transform.glsl"
+#include "octahedral.glsl"
 
 
 varying vec4 vColor;
@@ -10,7 +11,16 @@ void VS()
 {
     mat4 modelMatrix = iModelMatrix;
     vec3 worldPos = GetWorldPos(modelMatrix);
-    gl_Position = GetClipPos(worldPos);
+    #ifdef OCTAHEDRAL
+        // Project each corner into the octahedral map. Corners close to a fold of the lower half snap onto it,
+        // so a star crossing the fold is never stretched across the map
+        vec3 dir = normalize(worldPos);
+        if (dir.z < 0.0)
+            dir.xy = mix(dir.xy, vec2(0.0), step(abs(dir.xy), vec2(0.002)));
+        gl_Position = GetClipPos(vec3(octEncode(dir), 1.0));
+    #else
+        gl_Position = GetClipPos(worldPos);
+    #endif
 	
     vColor = iColor;
 }
@@ -0,0 +1,26 @@
+#include "Uniforms.glsl"
+#include "Samplers.glsl"
+#include "Transform.glsl"
+#include "octahedral.glsl"
+#include "equirect.glsl"
+
+varying vec3 vPos;
+
+void VS()
+{
+    mat4 modelMatrix = iModelMatrix;
+    vec3 worldPos = GetWorldPos(modelMatrix);
+    gl_Position = GetClipPos(worldPos);
+    vPos = worldPos;
+}
+
+void PS()
+{
+    // Drawn as a quad over the whole map, the position is the map coordinate. OCTAHEDRAL or EQUIRECT
+    #ifdef EQUIRECT
+        vec3 dir = equirectDecode(vPos.xy);
+    #else
+        vec3 dir = octDecode(vPos.xy);
+    #endif
+    gl_FragColor = textureCube(sDiffCubeMap, dir);
+}
@@ -1,6 +1,7 @@
 #include "Uniforms.glsl"
 #include "Samplers.glsl"
 #include "Transform.glsl"
+#include "octahedral.glsl"
 
 
 varying vec3 vPos;
@@ -21,7 +22,12 @@ void VS()
 
 void PS()
 {
-	vec3 posn = normalize(vPos);
+	#ifdef OCTAHEDRAL
+		// drawn as a quad over the octahedral map, the position is the map coordinate
+		vec3 posn = octDecode(vPos.xy);
+	#else
+		vec3 posn = normalize(vPos);
+	#endif
     float d = 1.0 - clamp(dot(posn, normalize(cStarPosition)), 0.0, 1.0);
     float i = exp(-(d - cStarSize) * cStarFalloff);
     float o = clamp(i, 0.0, 1.0);
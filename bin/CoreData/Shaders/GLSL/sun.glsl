@@ -1,6 +1,7 @@
 #include "Uniforms.glsl"
 #include "Samplers.glsl"
 #include "Transform.glsl"
+#include "octahedral.glsl"
 
 
 varying vec3 vPos;
@@ -22,7 +23,12 @@ void VS()
 
 void PS()
 {
-	vec3 posn = normalize(vPos);
+	#ifdef OCTAHEDRAL
+		// drawn as a quad over the octahedral map, the position is the map coordinate
+		vec3 posn = octDecode(vPos.xy);
+	#else
+		vec3 posn = normalize(vPos);
+	#endif
     float d = clamp(dot(posn, normalize(cSunPosition)), 0.0, 1.0);
     float c = smoothstep(1.0 - cSunSize * 32.0, 1.0 - cSunSize, d);
     c += pow(d, cSunFalloff) * 0.5;
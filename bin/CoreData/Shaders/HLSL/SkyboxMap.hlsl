@@ -0,0 +1,32 @@
+#include "Uniforms.hlsl"
+#include "Samplers.hlsl"
+#include "Transform.hlsl"
+#include "octahedral.hlsl"
+#include "equirect.hlsl"
+
+void VS(float4 iPos : POSITION,
+    #ifdef INSTANCED
+        float4x3 iModelInstance : TEXCOORD4,
+    #endif
+    out float3 oTexCoord : TEXCOORD0,
+    out float4 oPos : OUTPOSITION)
+{
+    float4x3 modelMatrix = iModelMatrix;
+    float3 worldPos = GetWorldPos(modelMatrix);
+    oPos = GetClipPos(worldPos);
+
+    oPos.z = oPos.w;
+    oTexCoord = iPos.xyz;
+}
+
+void PS(float3 iTexCoord : TEXCOORD0,
+    out float4 oColor : OUTCOLOR0)
+{
+    // The sky as one 2D map, OCTAHEDRAL or EQUIRECT
+    #ifdef EQUIRECT
+        float2 texCoord = equirectTexCoord(normalize(iTexCoord));
+    #else
+        float2 texCoord = octTexCoord(normalize(iTexCoord));
+    #endif
+    oColor = cMatDiffColor * Sample2D(DiffMap, texCoord);
+}
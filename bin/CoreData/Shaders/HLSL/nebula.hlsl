@@ -2,14 +2,21 @@
 #include "Samplers.hlsl"
 #include "Transform.hlsl"
 #include "classicnoise4D.hlsl"
+#include "octahedral.hlsl"
 
 #ifdef COMPILEPS
+	// Domain warp steps, set per quality tier by the technique (3..6). Each step costs 3 noise evaluations
+	#ifndef NEBULA_STEPS
+	#define NEBULA_STEPS 6
+	#endif
+
 	#ifndef D3D11
 	uniform float3 cNebularColor;
 	uniform float3 cNebularOffset;
 	uniform float cNebularScale;
 	uniform float cNebularIntensity;
 	uniform float cNebularFalloff;
+	uniform float cNebularTime;
 	#else
 	cbuffer CustomPS
 	{
@@ -18,14 +25,15 @@
 		float cNebularScale;
 		float cNebularIntensity;
 		float cNebularFalloff;
+		float cNebularTime;
 	}
 	#endif
 	float noise_nebula(float3 p) {
-		return 0.5 * cnoise(float4(p, 0)) + 0.5;
+		return 0.5 * cnoise(float4(p, cNebularTime)) + 0.5;
 	}
 
 	float nebula(float3 p) {
-		const int steps = 6;
+		const int steps = NEBULA_STEPS;
 		float scale = pow(2.0, float(steps));
 		float3 displace = (float3)0.0;
 		for (int i = 0; i < steps; i++) {
@@ -54,8 +62,17 @@ void PS(
     float3 vPos : TEXCOORD0,
     out float4 oColor : OUTCOLOR0)
 {	
-	float3 posn = normalize(vPos) * cNebularScale;
+	#ifdef OCTAHEDRAL
+		// drawn as a quad over the octahedral map, the position is the map coordinate
+		float3 posn = octDecode(vPos.xy) * cNebularScale;
+	#else
+		float3 posn = normalize(vPos) * cNebularScale;
+	#endif
 	float c = min(1.0, nebula(posn + cNebularOffset) * cNebularIntensity);
     c = pow(c, cNebularFalloff);
-	oColor = float4(cNebularColor, c);
+	#ifdef PREMULTIPLIED
+		oColor = float4(cNebularColor * c, c);
+	#else
+		oColor = float4(cNebularColor, c);
+	#endif
 }
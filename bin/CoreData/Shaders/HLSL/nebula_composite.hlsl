@@ -0,0 +1,75 @@
+#include "Uniforms.hlsl"
+#include "Samplers.hlsl"
+#include "Transform.hlsl"
+
+#ifdef COMPILEPS
+	#ifndef D3D11
+	uniform float cNebulaSize;
+	#else
+	cbuffer CustomPS
+	{
+		float cNebulaSize;
+	}
+	#endif
+
+	// Cubic B-spline through 4 bilinear taps. The taps are moved in the face plane and turned back into directions,
+	// so near an edge they land on the neighbouring face instead of being clamped, and the upsample has no seams.
+	float4 sampleBicubic(float3 dir) {
+		float3 a = abs(dir);
+		float3 major;
+		float3 u;
+		float3 v;
+		if (a.x >= a.y && a.x >= a.z) {
+			major = float3(sign(dir.x), 0.0, 0.0);
+			u = float3(0.0, 0.0, 1.0);
+			v = float3(0.0, 1.0, 0.0);
+		} else if (a.y >= a.z) {
+			major = float3(0.0, sign(dir.y), 0.0);
+			u = float3(1.0, 0.0, 0.0);
+			v = float3(0.0, 0.0, 1.0);
+		} else {
+			major = float3(0.0, 0.0, sign(dir.z));
+			u = float3(1.0, 0.0, 0.0);
+			v = float3(0.0, 1.0, 0.0);
+		}
+		float m = max(a.x, max(a.y, a.z));
+		float2 st = float2(dot(dir, u), dot(dir, v)) / m;
+
+		float2 texel = (st * 0.5 + 0.5) * cNebulaSize - 0.5;
+		float2 i = floor(texel);
+		float2 f = texel - i;
+		float2 f2 = f * f;
+		float2 f3 = f2 * f;
+		float2 w0 = (-f3 + 3.0 * f2 - 3.0 * f + 1.0) / 6.0;
+		float2 w1 = (3.0 * f3 - 6.0 * f2 + 4.0) / 6.0;
+		float2 w2 = (-3.0 * f3 + 3.0 * f2 + 3.0 * f + 1.0) / 6.0;
+		float2 w3 = f3 / 6.0;
+		float2 g0 = w0 + w1;
+		float2 g1 = w2 + w3;
+		float2 h0 = ((i - 1.0 + w1 / g0 + 0.5) / cNebulaSize) * 2.0 - 1.0;
+		float2 h1 = ((i + 1.0 + w3 / g1 + 0.5) / cNebulaSize) * 2.0 - 1.0;
+
+		return g0.y * (g0.x * SampleCube(DiffCubeMap, major + h0.x * u + h0.y * v) +
+		               g1.x * SampleCube(DiffCubeMap, major + h1.x * u + h0.y * v)) +
+		       g1.y * (g0.x * SampleCube(DiffCubeMap, major + h0.x * u + h1.y * v) +
+		               g1.x * SampleCube(DiffCubeMap, major + h1.x * u + h1.y * v));
+	}
+#endif
+
+void VS(float4 iPos : POSITION,
+    out float3 vPos : TEXCOORD0,    
+    out float4 oPos : OUTPOSITION)
+{
+    float4x3 modelMatrix = iModelMatrix;
+    float3 worldPos = GetWorldPos(modelMatrix);
+    oPos = GetClipPos(worldPos);
+	vPos = worldPos;
+}
+
+void PS(
+    float3 vPos : TEXCOORD0,
+    out float4 oColor : OUTCOLOR0)
+{
+	// Premultiplied color and coverage of all nebula layers
+	oColor = sampleBicubic(vPos);
+}
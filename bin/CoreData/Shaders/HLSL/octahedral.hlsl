@@ -0,0 +1,27 @@
+// Octahedral map of directions: the upper half (z >= 0) fills the inner diamond of [-1, 1]^2,
+// the lower half is folded over its edges into the corners.
+
+float2 octSign(float2 v) {
+    return float2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+float2 octEncode(float3 d) {
+    d /= abs(d.x) + abs(d.y) + abs(d.z);
+    float2 p = d.xy;
+    if (d.z < 0.0)
+        p = (1.0 - abs(p.yx)) * octSign(p);
+    return p;
+}
+
+float3 octDecode(float2 p) {
+    float3 d = float3(p, 1.0 - abs(p.x) - abs(p.y));
+    if (d.z < 0.0)
+        d.xy = (1.0 - abs(d.yx)) * octSign(d.xy);
+    return normalize(d);
+}
+
+// Texture coordinates of a direction. The map is rendered like any render target, so +y is row 0
+float2 octTexCoord(float3 d) {
+    float2 p = octEncode(d);
+    return float2(0.5 + 0.5 * p.x, 0.5 - 0.5 * p.y);
+}
@@ -1,6 +1,7 @@
 #include "Uniforms.hlsl"
 #include "Samplers.hlsl"
 #include "Transform.hlsl"
+#include "octahedral.hlsl"
 
 void VS(float4 iPos : POSITION,
     float4 iColor : COLOR0,    
@@ -9,7 +10,16 @@ void VS(float4 iPos : POSITION,
 {
     float4x3 modelMatrix = iModelMatrix;
     float3 worldPos = GetWorldPos(modelMatrix);
-    oPos = GetClipPos(worldPos);
+    #ifdef OCTAHEDRAL
+        // Project each corner into the octahedral map. Corners close to a fold of the lower half snap onto it,
+        // so a star crossing the fold is never stretched across the map
+        float3 dir = normalize(worldPos);
+        if (dir.z < 0.0)
+            dir.xy = lerp(dir.xy, (float2)0.0, step(abs(dir.xy), (float2)0.002));
+        oPos = GetClipPos(float3(octEncode(dir), 1.0));
+    #else
+        oPos = GetClipPos(worldPos);
+    #endif
 	oColor = iColor;
 }
 
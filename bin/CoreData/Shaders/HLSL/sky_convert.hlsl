@@ -0,0 +1,28 @@
+#include "Uniforms.hlsl"
+#include "Samplers.hlsl"
+#include "Transform.hlsl"
+#include "octahedral.hlsl"
+#include "equirect.hlsl"
+
+void VS(float4 iPos : POSITION,
+    out float3 vPos : TEXCOORD0,
+    out float4 oPos : OUTPOSITION)
+{
+    float4x3 modelMatrix = iModelMatrix;
+    float3 worldPos = GetWorldPos(modelMatrix);
+    oPos = GetClipPos(worldPos);
+    vPos = worldPos;
+}
+
+void PS(
+    float3 vPos : TEXCOORD0,
+    out float4 oColor : OUTCOLOR0)
+{
+    // Drawn as a quad over the whole map, the position is the map coordinate. OCTAHEDRAL or EQUIRECT
+    #ifdef EQUIRECT
+        float3 dir = equirectDecode(vPos.xy);
+    #else
+        float3 dir = octDecode(vPos.xy);
+    #endif
+    oColor = SampleCube(DiffCubeMap, dir);
+}
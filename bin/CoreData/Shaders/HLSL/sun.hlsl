@@ -1,6 +1,7 @@
 #include "Uniforms.hlsl"
 #include "Samplers.hlsl"
 #include "Transform.hlsl"
+#include "octahedral.hlsl"
 
 #ifdef COMPILEPS
 	#ifndef D3D11
@@ -33,7 +34,12 @@ void PS(
     float3 vPos : TEXCOORD0,
     out float4 oColor : OUTCOLOR0)
 {	
-	float3 posn = normalize(vPos);
+	#ifdef OCTAHEDRAL
+		// drawn as a quad over the octahedral map, the position is the map coordinate
+		float3 posn = octDecode(vPos.xy);
+	#else
+		float3 posn = normalize(vPos);
+	#endif
 	float d = clamp(dot(posn, normalize(cSunPosition)), 0.0, 1.0);
 	float c = smoothstep(1.0 - cSunSize * 32.0, 1.0 - cSunSize, d);
 	c += pow(d, cSunFalloff) * 0.5;
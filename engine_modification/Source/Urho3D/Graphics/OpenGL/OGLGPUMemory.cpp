@@ -0,0 +1,66 @@
+//
+// Copyright (c) 2008-2019 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../../Precompiled.h"
+
+#include "../../Graphics/Graphics.h"
+#include "../../Graphics/GraphicsImpl.h"
+#include "../../Graphics/OpenGL/OGLGPUMemory.h"
+
+#include "../../DebugNew.h"
+
+namespace Urho3D
+{
+
+bool QueryGPUMemory(GPUMemoryInfo& info)
+{
+    info = GPUMemoryInfo();
+
+#ifndef GL_ES_VERSION_2_0
+    if (GLEW_NVX_gpu_memory_info)
+    {
+        GLint kb = 0;
+        glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &kb);
+        info.free_ = (unsigned long long)kb * 1024;
+        kb = 0;
+        glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &kb);
+        info.total_ = (unsigned long long)kb * 1024;
+        info.source_ = "GL_NVX_gpu_memory_info";
+        return info.free_ > 0;
+    }
+
+    if (GLEW_ATI_meminfo)
+    {
+        // Free memory, largest free block, free auxiliary memory and its largest block, all in KB
+        GLint kb[4] = { 0, 0, 0, 0 };
+        glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, kb);
+        info.free_ = (unsigned long long)kb[0] * 1024;
+        info.source_ = "GL_ATI_meminfo";
+        return info.free_ > 0;
+    }
+#endif
+
+    return false;
+}
+
+}
@@ -0,0 +1,46 @@
+//
+// Copyright (c) 2008-2019 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../../Container/Str.h"
+
+namespace Urho3D
+{
+
+/// Video memory as reported by the driver, in bytes.
+struct GPUMemoryInfo
+{
+    /// Memory currently available for new allocations.
+    unsigned long long free_{};
+    /// Dedicated video memory, or 0 when the extension does not report it.
+    unsigned long long total_{};
+    /// Extension that answered.
+    String source_;
+};
+
+/// Query video memory through GL_NVX_gpu_memory_info or GL_ATI_meminfo. Needs the graphics context. Return false when
+/// neither extension is present, other drivers do not expose free memory.
+URHO3D_API bool QueryGPUMemory(GPUMemoryInfo& info);
+
+}
@@ -0,0 +1,343 @@
+//
+// Copyright (c) 2008-2019 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../../Precompiled.h"
+
+#include "../../Core/Context.h"
+#include "../../Graphics/Graphics.h"
+#include "../../Graphics/GraphicsEvents.h"
+#include "../../Graphics/GraphicsImpl.h"
+#include "../../Graphics/OpenGL/OGLGPUTimer.h"
+#include "../../IO/File.h"
+#include "../../IO/Log.h"
+
+#include <cstdio>
+
+#include "../../DebugNew.h"
+
+namespace Urho3D
+{
+
+/// Render path sendevent names that open and close a block.
+static const String RENDERPATH_BEGIN("GPUBegin:");
+static const String RENDERPATH_END("GPUEnd");
+
+/// Write text without the terminator WriteString() adds.
+static void WriteText(File* file, const String& text)
+{
+    file->Write(text.CString(), text.Length());
+}
+
+GPUTimer::GPUTimer(Context* context) :
+    Object(context),
+    current_(0),
+    recording_(false),
+    renderPathBlock_(false),
+    numDropped_(0),
+    supported_(false)
+{
+#ifndef GL_ES_VERSION_2_0
+    supported_ = Graphics::GetGL3Support() && (GLEW_VERSION_3_3 || GLEW_ARB_timer_query);
+#endif
+    if (!supported_)
+        URHO3D_LOGWARNING("GPU timer queries not supported, GPU times will not be measured");
+
+    SubscribeToEvent(E_BEGINRENDERING, URHO3D_HANDLER(GPUTimer, HandleBeginRendering));
+    SubscribeToEvent(E_ENDRENDERING, URHO3D_HANDLER(GPUTimer, HandleEndRendering));
+    SubscribeToEvent(E_RENDERPATHEVENT, URHO3D_HANDLER(GPUTimer, HandleRenderPathEvent));
+    SubscribeToEvent(E_DEVICELOST, URHO3D_HANDLER(GPUTimer, HandleDeviceLost));
+}
+
+GPUTimer::~GPUTimer()
+{
+    StopTrace();
+
+#ifndef GL_ES_VERSION_2_0
+    auto* graphics = GetSubsystem<Graphics>();
+    if (graphics && !graphics->IsDeviceLost())
+    {
+        for (auto& frame : frames_)
+        {
+            if (!frame.queries_.Empty())
+                glDeleteQueries(frame.queries_.Size(), frame.queries_.Buffer());
+        }
+    }
+#endif
+}
+
+void GPUTimer::BeginBlock(const String& name)
+{
+    if (!recording_)
+        return;
+
+    Frame& frame = frames_[current_];
+    unsigned begin = Timestamp();
+    if (begin == M_MAX_UNSIGNED)
+    {
+        // Keep the stack balanced for the matching EndBlock()
+        stack_.Push(M_MAX_UNSIGNED);
+        return;
+    }
+
+    PendingBlock block;
+    block.name_ = name;
+    block.depth_ = stack_.Size();
+    block.begin_ = begin;
+    block.end_ = M_MAX_UNSIGNED;
+    stack_.Push(frame.blocks_.Size());
+    frame.blocks_.Push(block);
+}
+
+void GPUTimer::EndBlock()
+{
+    if (!recording_ || stack_.Empty())
+        return;
+
+    unsigned index = stack_.Back();
+    stack_.Pop();
+    if (index != M_MAX_UNSIGNED)
+        frames_[current_].blocks_[index].end_ = Timestamp();
+}
+
+bool GPUTimer::StartTrace(const String& fileName)
+{
+    StopTrace();
+
+    SharedPtr<File> file(new File(context_, fileName, FILE_WRITE));
+    if (!file->IsOpen())
+    {
+        URHO3D_LOGERROR("Could not open GPU timer trace " + fileName);
+        return false;
+    }
+
+    trace_ = file;
+    WriteText(trace_, "{\"traceEvents\":[\n"
+        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU rendering\"}},\n"
+        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+    return true;
+}
+
+void GPUTimer::StopTrace()
+{
+    if (!trace_)
+        return;
+
+    WriteText(trace_, "\n]}\n");
+    trace_->Close();
+    trace_.Reset();
+}
+
+String GPUTimer::PrintData() const
+{
+    // Sum the blocks of the same name, e.g. a pass rendered for each cube face
+    Vector<GPUTimerBlock> totals;
+    PODVector<unsigned> counts;
+    HashMap<String, unsigned> indices;
+    for (unsigned i = 0; i < blocks_.Size(); ++i)
+    {
+        const GPUTimerBlock& block = blocks_[i];
+        HashMap<String, unsigned>::Iterator j = indices.Find(block.name_);
+        if (j == indices.End())
+        {
+            indices[block.name_] = totals.Size();
+            totals.Push(block);
+            counts.Push(1);
+        }
+        else
+        {
+            totals[j->second_].duration_ += block.duration_;
+            ++counts[j->second_];
+        }
+    }
+
+    String output;
+    char line[256];
+    for (unsigned i = 0; i < totals.Size(); ++i)
+    {
+        if (counts[i] > 1)
+            snprintf(line, sizeof line, "%*s%s %.3f ms (%u)\n", totals[i].depth_ * 2, "", totals[i].name_.CString(), totals[i].duration_,
+                counts[i]);
+        else
+            snprintf(line, sizeof line, "%*s%s %.3f ms\n", totals[i].depth_ * 2, "", totals[i].name_.CString(), totals[i].duration_);
+        output.Append(line);
+    }
+    return output;
+}
+
+unsigned GPUTimer::Timestamp()
+{
+#ifndef GL_ES_VERSION_2_0
+    Frame& frame = frames_[current_];
+    if (frame.numQueries_ >= maxBlocks_ * 2)
+        return M_MAX_UNSIGNED;
+
+    if (frame.numQueries_ == frame.queries_.Size())
+    {
+        unsigned query = 0;
+        glGenQueries(1, &query);
+        frame.queries_.Push(query);
+    }
+    glQueryCounter(frame.queries_[frame.numQueries_], GL_TIMESTAMP);
+    return frame.numQueries_++;
+#else
+    return M_MAX_UNSIGNED;
+#endif
+}
+
+void GPUTimer::Collect()
+{
+#ifndef GL_ES_VERSION_2_0
+    PODVector<unsigned long long> timestamps;
+
+    // Oldest first; queries complete in order, so a frame is done when its last query is
+    for (unsigned i = 1; i <= NUM_FRAMES; ++i)
+    {
+        Frame& frame = frames_[(current_ + i) % NUM_FRAMES];
+        if (!frame.pending_)
+            continue;
+
+        int available = 0;
+        glGetQueryObjectiv(frame.queries_[frame.numQueries_ - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+
+        timestamps.Resize(frame.numQueries_);
+        for (unsigned j = 0; j < frame.numQueries_; ++j)
+            glGetQueryObjectui64v(frame.queries_[j], GL_QUERY_RESULT, &timestamps[j]);
+
+        blocks_.Clear();
+        const unsigned long long frameStart = timestamps[0];
+        for (unsigned j = 0; j < frame.blocks_.Size(); ++j)
+        {
+            const PendingBlock& pending = frame.blocks_[j];
+            if (pending.end_ == M_MAX_UNSIGNED)
+                continue;
+
+            GPUTimerBlock block;
+            block.name_ = pending.name_;
+            block.depth_ = pending.depth_;
+            block.start_ = (float)((double)(timestamps[pending.begin_] - frameStart) * 1e-6);
+            block.duration_ = (float)((double)(timestamps[pending.end_] - timestamps[pending.begin_]) * 1e-6);
+            blocks_.Push(block);
+        }
+
+        if (trace_)
+            WriteTrace(frame);
+        frame.pending_ = false;
+    }
+#endif
+}
+
+void GPUTimer::WriteTrace(const Frame& frame)
+{
+    // The GPU clock is not the CPU clock: the blocks are placed from the CPU start of their frame's rendering
+    String events;
+    char event[512];
+    snprintf(event, sizeof event, ",\n{\"name\":\"Render\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%lld,\"dur\":%lld}", frame.cpuStart_,
+        frame.cpuDuration_);
+    events.Append(event);
+    for (unsigned i = 0; i < blocks_.Size(); ++i)
+    {
+        const GPUTimerBlock& block = blocks_[i];
+        snprintf(event, sizeof event, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":%.1f,\"dur\":%.1f}",
+            block.name_.Replaced("\"", "\\\"").CString(), (double)frame.cpuStart_ + block.start_ * 1000.0, block.duration_ * 1000.0);
+        events.Append(event);
+    }
+    WriteText(trace_, events);
+}
+
+void GPUTimer::HandleBeginRendering(StringHash eventType, VariantMap& eventData)
+{
+    if (!supported_)
+        return;
+
+    Collect();
+
+    current_ = (current_ + 1) % NUM_FRAMES;
+    Frame& frame = frames_[current_];
+    if (frame.pending_)
+    {
+        // Still not available after NUM_FRAMES frames; the queries are reused and the results lost
+        ++numDropped_;
+        frame.pending_ = false;
+    }
+    frame.numQueries_ = 0;
+    frame.blocks_.Clear();
+    frame.cpuStart_ = timer_.GetUSec(false);
+    stack_.Clear();
+    renderPathBlock_ = false;
+
+    recording_ = true;
+    BeginBlock("Frame");
+}
+
+void GPUTimer::HandleEndRendering(StringHash eventType, VariantMap& eventData)
+{
+    if (!recording_)
+        return;
+
+    // Blocks left open by render paths or unbalanced scopes end with the frame
+    while (!stack_.Empty())
+        EndBlock();
+
+    Frame& frame = frames_[current_];
+    frame.cpuDuration_ = timer_.GetUSec(false) - frame.cpuStart_;
+    frame.pending_ = frame.numQueries_ > 0;
+    recording_ = false;
+}
+
+void GPUTimer::HandleRenderPathEvent(StringHash eventType, VariantMap& eventData)
+{
+    using namespace RenderPathEvent;
+
+    const String& name = eventData[P_NAME].GetString();
+    if (name.StartsWith(RENDERPATH_BEGIN))
+    {
+        // A render path block ends where the next one begins
+        if (renderPathBlock_)
+            EndBlock();
+        BeginBlock(name.Substring(RENDERPATH_BEGIN.Length()));
+        renderPathBlock_ = true;
+    }
+    else if (name == RENDERPATH_END && renderPathBlock_)
+    {
+        EndBlock();
+        renderPathBlock_ = false;
+    }
+}
+
+void GPUTimer::HandleDeviceLost(StringHash eventType, VariantMap& eventData)
+{
+    // The queries went with the context
+    for (auto& frame : frames_)
+    {
+        frame.queries_.Clear();
+        frame.numQueries_ = 0;
+        frame.blocks_.Clear();
+        frame.pending_ = false;
+    }
+    stack_.Clear();
+    recording_ = false;
+}
+
+}
@@ -0,0 +1,181 @@
+//
+// Copyright (c) 2008-2019 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../../Container/Ptr.h"
+#include "../../Core/Object.h"
+#include "../../Core/Profiler.h"
+#include "../../Core/Timer.h"
+
+namespace Urho3D
+{
+
+class File;
+
+/// GPU time of a named block in one frame.
+struct GPUTimerBlock
+{
+    /// Block name.
+    String name_;
+    /// Nesting depth, 0 for the frame itself.
+    unsigned depth_;
+    /// Start from the beginning of the frame, and duration, in milliseconds.
+    float start_;
+    float duration_;
+};
+
+/// Scoped GPU timers from timestamp queries. Blocks are opened and closed around GL work with BeginBlock() and EndBlock(),
+/// URHO3D_PROFILE_GPU scopes, or render path commands like <command type="sendevent" name="GPUBegin:nebula" /> and
+/// <command type="sendevent" name="GPUEnd" />. Each frame of rendering is a block of its own. Queries are kept for
+/// NUM_FRAMES frames and read only once available, so the results are a few frames old and never stall the CPU. Needs
+/// OpenGL 3.3 or ARB_timer_query, otherwise nothing is measured.
+class URHO3D_API GPUTimer : public Object
+{
+    URHO3D_OBJECT(GPUTimer, Object);
+
+public:
+    /// Frames in flight.
+    static const unsigned NUM_FRAMES = 3;
+
+    /// Construct.
+    explicit GPUTimer(Context* context);
+    /// Destruct.
+    ~GPUTimer() override;
+
+    /// Begin a block. Ignored outside rendering.
+    void BeginBlock(const String& name);
+    /// End the innermost block.
+    void EndBlock();
+    /// Write each measured frame to a trace file in the Chrome trace event format (chrome://tracing, Perfetto), with the
+    /// CPU time of the frame's rendering alongside. Return true if the file could be opened.
+    bool StartTrace(const String& fileName);
+    /// Finish and close the trace file.
+    void StopTrace();
+
+    /// Return whether timestamp queries are supported.
+    bool IsSupported() const { return supported_; }
+    /// Return whether a trace is being written.
+    bool IsTracing() const { return trace_.NotNull(); }
+    /// Return the blocks of the newest measured frame in begin order.
+    const Vector<GPUTimerBlock>& GetBlocks() const { return blocks_; }
+    /// Return the blocks of the newest measured frame, one line per block name with its total time and count.
+    String PrintData() const;
+    /// Return number of frames whose queries were not available in time and were dropped.
+    unsigned GetNumDropped() const { return numDropped_; }
+
+    /// Maximum blocks per frame, further blocks are not measured.
+    unsigned maxBlocks_{ 256 };
+
+private:
+    /// Block being measured.
+    struct PendingBlock
+    {
+        String name_;
+        unsigned depth_;
+        /// Indices of the begin and end timestamp queries in the frame.
+        unsigned begin_;
+        unsigned end_;
+    };
+
+    /// Queries of one frame.
+    struct Frame
+    {
+        PODVector<unsigned> queries_;
+        unsigned numQueries_{};
+        Vector<PendingBlock> blocks_;
+        /// Start of the frame's rendering on the CPU and its duration, in microseconds since construction.
+        long long cpuStart_{};
+        long long cpuDuration_{};
+        bool pending_{};
+    };
+
+    /// Issue a timestamp query and return its index in the current frame, or M_MAX_UNSIGNED when out of blocks.
+    unsigned Timestamp();
+    /// Read the finished frames, oldest first.
+    void Collect();
+    /// Write a measured frame to the trace.
+    void WriteTrace(const Frame& frame);
+    /// Handle begin rendering event.
+    void HandleBeginRendering(StringHash eventType, VariantMap& eventData);
+    /// Handle end rendering event.
+    void HandleEndRendering(StringHash eventType, VariantMap& eventData);
+    /// Handle render path event.
+    void HandleRenderPathEvent(StringHash eventType, VariantMap& eventData);
+    /// Handle device lost event.
+    void HandleDeviceLost(StringHash eventType, VariantMap& eventData);
+
+    /// Frames of queries, used round robin.
+    Frame frames_[NUM_FRAMES];
+    /// Frame being recorded.
+    unsigned current_;
+    /// Whether between begin and end rendering.
+    bool recording_;
+    /// Open blocks of the current frame, innermost last.
+    PODVector<unsigned> stack_;
+    /// Whether the innermost render path block is open.
+    bool renderPathBlock_;
+    /// Results of the newest measured frame.
+    Vector<GPUTimerBlock> blocks_;
+    /// CPU clock of the trace and the frame timings.
+    HiresTimer timer_;
+    /// Trace file.
+    SharedPtr<File> trace_;
+    /// Frames dropped.
+    unsigned numDropped_;
+    /// Timestamp queries supported.
+    bool supported_;
+};
+
+/// GPU timer scope, see URHO3D_PROFILE_GPU.
+class URHO3D_API AutoGPUTimerBlock
+{
+public:
+    /// Construct. Begin a block if there is a GPU timer.
+    AutoGPUTimerBlock(GPUTimer* timer, const char* name) :
+        timer_(timer)
+    {
+        if (timer_)
+            timer_->BeginBlock(name);
+    }
+
+    /// Destruct. End the block.
+    ~AutoGPUTimerBlock()
+    {
+        if (timer_)
+            timer_->EndBlock();
+    }
+
+private:
+    /// GPU timer.
+    GPUTimer* timer_;
+};
+
+#ifdef URHO3D_PROFILING
+/// Profile a scope on the CPU and, if the GPUTimer subsystem is registered, on the GPU.
+#define URHO3D_PROFILE_GPU(name) URHO3D_PROFILE(name); Urho3D::AutoGPUTimerBlock gpuTimer_ ## name (GetSubsystem<Urho3D::GPUTimer>(), #name)
+#else
+#define URHO3D_PROFILE_GPU(name)
+#endif
+
+}
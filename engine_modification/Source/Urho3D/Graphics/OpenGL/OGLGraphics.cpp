@@ -22,6 +22,7 @@
 
 #include "../../Precompiled.h"
 
+#include "../../Container/Sort.h"
 #include "../../Core/Context.h"
 #include "../../Core/Mutex.h"
 #include "../../Core/ProcessUtils.h"
@@ -39,6 +40,12 @@
 #include "../../Graphics/Texture2D.h"
 #include "../../Graphics/TextureCube.h"
 #include "../../Graphics/VertexBuffer.h"
+#include "../../Graphics/OpenGL/OGLGPUTimer.h"
+#include "../../Graphics/OpenGL/OGLGraphicsStats.h"
+#include "../../Graphics/OpenGL/OGLProgramBinaryCache.h"
+#include "../../Graphics/OpenGL/OGLShaderCompile.h"
+#include "../../Graphics/OpenGL/OGLUniformRing.h"
+#include "../../Graphics/OpenGL/OGLVertexArrayCache.h"
 #include "../../IO/File.h"
 #include "../../IO/Log.h"
 #include "../../Resource/ResourceCache.h"
@@ -170,6 +177,567 @@ static const unsigned glElementComponents[] =
     4
 };
 
+// Note: like the extension string, the frame counters and the vertex array object cache are not multi-instance safe
+static GraphicsFrameStats frameStats;
+static GraphicsFrameStats lastFrameStats;
+static VertexArrayStats vertexArrayStats;
+static VertexArrayStats lastVertexArrayStats;
+static bool vertexArrayCacheEnabled = true;
+static bool vertexArrayCacheToggled = false;
+
+#ifndef GL_ES_VERSION_2_0
+/// Vertex array objects unused this many frames are deleted once the cache holds more than MAX_CACHED_VERTEX_ARRAYS.
+static const unsigned MAX_CACHED_VERTEX_ARRAYS = 1024;
+static const unsigned VERTEX_ARRAY_MAX_AGE = 60;
+
+/// A vertex array object and what it was specified from.
+struct VertexArrayEntry
+{
+    unsigned vao_{};
+    /// Sorted (semantic, index, location) of the shader program.
+    PODVector<unsigned> layout_;
+    /// Buffers as they were: a released and recreated buffer has a new name, a destroyed one expires.
+    WeakPtr<VertexBuffer> buffers_[MAX_VERTEX_STREAMS];
+    unsigned bufferNames_[MAX_VERTEX_STREAMS]{};
+    PODVector<VertexElement> elements_[MAX_VERTEX_STREAMS];
+    unsigned instanceOffset_{};
+    unsigned lastFrame_{};
+};
+
+static HashMap<unsigned long long, VertexArrayEntry> vertexArrays;
+/// Attribute layout of the current shader program.
+static PODVector<unsigned> vertexLayout;
+/// Vertex array object created with the context, used when the cache is disabled.
+static unsigned defaultVertexArray = 0;
+static unsigned boundVertexArray = 0;
+static unsigned vertexArrayFrame = 0;
+
+static void GetVertexLayout(const HashMap<Pair<unsigned char, unsigned char>, unsigned>* attributes, PODVector<unsigned>& layout)
+{
+    layout.Clear();
+    if (!attributes)
+        return;
+    for (HashMap<Pair<unsigned char, unsigned char>, unsigned>::ConstIterator i = attributes->Begin(); i != attributes->End(); ++i)
+        layout.Push((unsigned)i->first_.first_ << 24u | (unsigned)i->first_.second_ << 16u | i->second_);
+    // Map order depends on insertion, sort so that programs with the same locations share vertex array objects
+    Sort(layout.Begin(), layout.End());
+}
+
+static inline void HashCombine(unsigned long long& hash, unsigned value)
+{
+    hash ^= value;
+    hash *= 0x100000001b3ULL;
+}
+
+static VertexBuffer* GetUsableBuffer(VertexBuffer* buffer)
+{
+    // Buffers without an OpenGL object are skipped, same as when specifying attributes
+    return buffer && buffer->GetGPUObjectName() ? buffer : nullptr;
+}
+
+static unsigned long long HashVertexArray(VertexBuffer* const* buffers, unsigned instanceOffset)
+{
+    unsigned long long hash = 0xcbf29ce484222325ULL;
+    for (unsigned i = 0; i < vertexLayout.Size(); ++i)
+        HashCombine(hash, vertexLayout[i]);
+    HashCombine(hash, instanceOffset);
+    for (unsigned i = 0; i < MAX_VERTEX_STREAMS; ++i)
+    {
+        VertexBuffer* buffer = GetUsableBuffer(buffers[i]);
+        if (!buffer)
+        {
+            HashCombine(hash, 0);
+            continue;
+        }
+        HashCombine(hash, buffer->GetGPUObjectName());
+        const PODVector<VertexElement>& elements = buffer->GetElements();
+        for (unsigned j = 0; j < elements.Size(); ++j)
+        {
+            const VertexElement& element = elements[j];
+            HashCombine(hash, (unsigned)element.type_ | (unsigned)element.semantic_ << 8u | (unsigned)element.index_ << 16u |
+                (element.perInstance_ ? 1u << 24u : 0u));
+        }
+    }
+    return hash;
+}
+
+static bool IsSameVertexArray(const VertexArrayEntry& entry, VertexBuffer* const* buffers, unsigned instanceOffset)
+{
+    if (entry.instanceOffset_ != instanceOffset || entry.layout_ != vertexLayout)
+        return false;
+    for (unsigned i = 0; i < MAX_VERTEX_STREAMS; ++i)
+    {
+        VertexBuffer* buffer = GetUsableBuffer(buffers[i]);
+        if (entry.buffers_[i].Get() != buffer)
+            return false;
+        if (buffer && (entry.bufferNames_[i] != buffer->GetGPUObjectName() || entry.elements_[i] != buffer->GetElements()))
+            return false;
+    }
+    return true;
+}
+
+static void BindVertexArray(unsigned vao, IndexBuffer* indexBuffer)
+{
+    if (boundVertexArray == vao)
+        return;
+    glBindVertexArray(vao);
+    boundVertexArray = vao;
+    ++vertexArrayStats.vaoBinds_;
+    // The element array binding is part of the vertex array object; Graphics::SetIndexBuffer only binds on change
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer ? indexBuffer->GetGPUObjectName() : 0);
+}
+
+static void ClearVertexArrays(bool deleteObjects)
+{
+    if (deleteObjects)
+    {
+        for (HashMap<unsigned long long, VertexArrayEntry>::ConstIterator i = vertexArrays.Begin(); i != vertexArrays.End(); ++i)
+            glDeleteVertexArrays(1, &i->second_.vao_);
+    }
+    vertexArrays.Clear();
+    boundVertexArray = 0;
+}
+
+static void TrimVertexArrays()
+{
+    if (vertexArrays.Size() <= MAX_CACHED_VERTEX_ARRAYS)
+        return;
+    for (HashMap<unsigned long long, VertexArrayEntry>::Iterator i = vertexArrays.Begin(); i != vertexArrays.End();)
+    {
+        if (i->second_.vao_ != boundVertexArray && i->second_.lastFrame_ + VERTEX_ARRAY_MAX_AGE < vertexArrayFrame)
+        {
+            glDeleteVertexArrays(1, &i->second_.vao_);
+            i = vertexArrays.Erase(i);
+        }
+        else
+            ++i;
+    }
+}
+#endif
+
+void SetVertexArrayCacheEnabled(bool enable)
+{
+    if (enable != vertexArrayCacheEnabled)
+    {
+        vertexArrayCacheEnabled = enable;
+        vertexArrayCacheToggled = true;
+    }
+}
+
+bool IsVertexArrayCacheEnabled()
+{
+    return vertexArrayCacheEnabled;
+}
+
+const VertexArrayStats& GetVertexArrayStats()
+{
+    return lastVertexArrayStats;
+}
+
+const GraphicsFrameStats& GetGraphicsFrameStats()
+{
+    return lastFrameStats;
+}
+
+void AddBufferUploadBytes(unsigned bytes)
+{
+    frameStats.bufferUploadBytes_ += bytes;
+}
+
+// Note: like the vertex array object cache, the uniform ring is not multi-instance safe
+static UniformRingStats uniformRingStats;
+static UniformRingStats lastUniformRingStats;
+static bool uniformRingEnabled = true;
+static bool uniformRingActive = false;
+static unsigned uniformRingSize = 4 * 1024 * 1024;
+
+#ifndef GL_ES_VERSION_2_0
+/// CPU contents of a constant buffer while the ring is in use, ConstantBuffer keeps its shadow data private.
+struct UniformRingMirror
+{
+    PODVector<unsigned char> data_;
+    /// Ring position of the latest copy, counted from ring creation without wrapping.
+    unsigned long long position_{};
+    /// Binding points the buffer was applied to; may still hold points it has left since, those are checked once more.
+    unsigned slots_{};
+    bool copied_{};
+    bool dirty_{};
+};
+
+/// Fence inserted when the ring head was at position_.
+struct UniformRingFence
+{
+    GLsync fence_;
+    unsigned long long position_;
+};
+
+static HashMap<ConstantBuffer*, UniformRingMirror> uniformMirrors;
+static ConstantBuffer* lastMirrorBuffer = nullptr;
+static UniformRingMirror* lastMirror = nullptr;
+static unsigned uniformRingObject = 0;
+static unsigned char* uniformRingData = nullptr;
+static unsigned uniformRingCapacity = 0;
+static unsigned uniformRingAlignment = 1;
+static unsigned long long uniformRingHead = 0;
+/// Everything before this position is no longer read by the GPU.
+static unsigned long long uniformRingCompleted = 0;
+static PODVector<UniformRingFence> uniformRingFences;
+/// Ring position bound to each uniform buffer binding point.
+static const unsigned long long NO_UNIFORM_RANGE = ~0ULL;
+static unsigned long long boundUniformRanges[MAX_SHADER_PARAMETER_GROUPS * 2];
+/// Binding points ApplyUniformRing() checks before the next draw, one bit each.
+static const unsigned ALL_UNIFORM_SLOTS = (1u << (MAX_SHADER_PARAMETER_GROUPS * 2)) - 1;
+static unsigned pendingUniformSlots = ALL_UNIFORM_SLOTS;
+/// Head position at which the oldest bound copy goes stale, and every binding point is checked again.
+static unsigned long long uniformRingRefreshAt = 0;
+
+static void ResetUniformRanges()
+{
+    for (auto& range : boundUniformRanges)
+        range = NO_UNIFORM_RANGE;
+    pendingUniformSlots = ALL_UNIFORM_SLOTS;
+    uniformRingRefreshAt = 0;
+}
+
+static UniformRingMirror& GetUniformMirror(Graphics* graphics, ConstantBuffer* buffer)
+{
+    if (buffer == lastMirrorBuffer)
+        return *lastMirror;
+
+    HashMap<ConstantBuffer*, UniformRingMirror>::Iterator i = uniformMirrors.Find(buffer);
+    if (i == uniformMirrors.End())
+    {
+        // Start from what the buffer object holds; pending changes were applied when the ring was switched on
+        i = uniformMirrors.Insert(MakePair(buffer, UniformRingMirror()));
+        PODVector<unsigned char>& data = i->second_.data_;
+        data.Resize(buffer->GetSize());
+        memset(data.Buffer(), 0, data.Size());
+        if (buffer->GetGPUObjectName() && data.Size())
+        {
+            graphics->SetUBO(buffer->GetGPUObjectName());
+            glGetBufferSubData(GL_UNIFORM_BUFFER, 0, data.Size(), data.Buffer());
+        }
+        i->second_.dirty_ = true;
+    }
+
+    lastMirrorBuffer = buffer;
+    lastMirror = &i->second_;
+    return i->second_;
+}
+
+static bool CreateUniformRing(Graphics* graphics)
+{
+    int alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    uniformRingAlignment = (unsigned)Max(alignment, 1);
+    uniformRingCapacity = Max(uniformRingSize, 64u * 1024u);
+
+    glGenBuffers(1, &uniformRingObject);
+    if (!uniformRingObject)
+        return false;
+    graphics->SetUBO(uniformRingObject);
+
+    if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, uniformRingCapacity, nullptr, flags);
+        uniformRingData = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, uniformRingCapacity, flags);
+        if (!uniformRingData)
+        {
+            // Storage is immutable, start over with a plain buffer object
+            glDeleteBuffers(1, &uniformRingObject);
+            glGenBuffers(1, &uniformRingObject);
+            graphics->SetUBO(uniformRingObject);
+        }
+    }
+    if (!uniformRingData)
+        glBufferData(GL_UNIFORM_BUFFER, uniformRingCapacity, nullptr, GL_DYNAMIC_DRAW);
+
+    uniformRingHead = 0;
+    uniformRingCompleted = 0;
+    ResetUniformRanges();
+    return glGetError() == GL_NO_ERROR;
+}
+
+static void ReleaseUniformRing(Graphics* graphics, bool deleteObjects)
+{
+    if (deleteObjects)
+    {
+        if (uniformRingData)
+        {
+            graphics->SetUBO(uniformRingObject);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+        }
+        if (uniformRingObject)
+        {
+            graphics->SetUBO(0);
+            glDeleteBuffers(1, &uniformRingObject);
+        }
+        for (unsigned i = 0; i < uniformRingFences.Size(); ++i)
+            glDeleteSync(uniformRingFences[i].fence_);
+    }
+    uniformRingFences.Clear();
+    uniformRingObject = 0;
+    uniformRingData = nullptr;
+    uniformRingActive = false;
+
+    // The CPU contents stay valid, but have to be copied to the next ring
+    for (HashMap<ConstantBuffer*, UniformRingMirror>::Iterator i = uniformMirrors.Begin(); i != uniformMirrors.End(); ++i)
+        i->second_.copied_ = false;
+}
+
+static void ClearUniformMirrors()
+{
+    uniformMirrors.Clear();
+    lastMirrorBuffer = nullptr;
+    lastMirror = nullptr;
+    pendingUniformSlots = ALL_UNIFORM_SLOTS;
+}
+
+/// Wait until the GPU no longer reads the ring before position.
+static void WaitUniformRing(unsigned long long position)
+{
+    if (position <= uniformRingCompleted)
+        return;
+
+    // Fences are in submission order, the first one at or after the position covers everything read before it
+    unsigned i = 0;
+    while (i < uniformRingFences.Size() && uniformRingFences[i].position_ < position)
+        ++i;
+    if (i == uniformRingFences.Size())
+    {
+        // More than half the ring within a frame: fence what has been submitted so far
+        UniformRingFence fence{ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), uniformRingHead };
+        uniformRingFences.Push(fence);
+    }
+
+    GLsync fence = uniformRingFences[i].fence_;
+    GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (status == GL_TIMEOUT_EXPIRED)
+    {
+        ++uniformRingStats.waits_;
+        URHO3D_PROFILE(WaitUniformRing);
+        do
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        while (status == GL_TIMEOUT_EXPIRED);
+    }
+
+    uniformRingCompleted = uniformRingFences[i].position_;
+    for (unsigned j = 0; j <= i; ++j)
+        glDeleteSync(uniformRingFences[j].fence_);
+    uniformRingFences.Erase(0, i + 1);
+}
+
+/// Return the ring position for size bytes, waiting if the GPU still reads that space.
+static unsigned long long AllocateUniformRange(unsigned size)
+{
+    unsigned long long position = (uniformRingHead + uniformRingAlignment - 1) / uniformRingAlignment * uniformRingAlignment;
+    // A range never wraps around the end of the buffer
+    if (position % uniformRingCapacity + size > uniformRingCapacity)
+        position += uniformRingCapacity - position % uniformRingCapacity;
+    unsigned long long end = position + size;
+
+    // A copy stays bound for draws until the head is a quarter of the ring past it, see ApplyUniformRing(), so the previous
+    // lap of this space may be read by draws submitted until the head reached end - capacity / 2
+    if (end > uniformRingCapacity / 2)
+        WaitUniformRing(end - uniformRingCapacity / 2);
+
+    uniformRingHead = end;
+    return position;
+}
+
+/// Copy changed constant buffers to the ring and bind their ranges. Called before each draw; only looks at the binding
+/// points marked since the last draw, unless the oldest bound copy has gone stale.
+static void ApplyUniformRing(Graphics* graphics)
+{
+    if (uniformRingHead >= uniformRingRefreshAt)
+        pendingUniformSlots = ALL_UNIFORM_SLOTS;
+    if (!pendingUniformSlots)
+        return;
+
+    GraphicsImpl* impl = graphics->GetImpl();
+    if (pendingUniformSlots == ALL_UNIFORM_SLOTS)
+        uniformRingRefreshAt = NO_UNIFORM_RANGE;
+    for (unsigned i = 0; i < MAX_SHADER_PARAMETER_GROUPS * 2; ++i)
+    {
+        ConstantBuffer* buffer = impl->constantBuffers_[i];
+        if (!(pendingUniformSlots & (1u << i)) || !buffer)
+            continue;
+
+        ++uniformRingStats.slotChecks_;
+        UniformRingMirror& mirror = GetUniformMirror(graphics, buffer);
+        mirror.slots_ |= 1u << i;
+        const unsigned size = mirror.data_.Size();
+        if (!size)
+            continue;
+        if (mirror.dirty_ || !mirror.copied_ || uniformRingHead - mirror.position_ >= uniformRingCapacity / 4)
+        {
+            mirror.position_ = AllocateUniformRange(size);
+            const unsigned offset = (unsigned)(mirror.position_ % uniformRingCapacity);
+            if (uniformRingData)
+                memcpy(uniformRingData + offset, mirror.data_.Buffer(), size);
+            else
+            {
+                graphics->SetUBO(uniformRingObject);
+                glBufferSubData(GL_UNIFORM_BUFFER, offset, size, mirror.data_.Buffer());
+            }
+            mirror.copied_ = true;
+            mirror.dirty_ = false;
+            ++uniformRingStats.copies_;
+            uniformRingStats.bytes_ += size;
+            frameStats.constantBufferBytes_ += size;
+        }
+
+        if (boundUniformRanges[i] != mirror.position_)
+        {
+            glBindBufferRange(GL_UNIFORM_BUFFER, i, uniformRingObject, (GLintptr)(mirror.position_ % uniformRingCapacity), size);
+            // Like glBindBufferBase, this also sets the generic binding point
+            impl->boundUBO_ = uniformRingObject;
+            boundUniformRanges[i] = mirror.position_;
+            ++uniformRingStats.rangeBinds_;
+        }
+        uniformRingRefreshAt = Min(uniformRingRefreshAt, mirror.position_ + uniformRingCapacity / 4);
+    }
+    pendingUniformSlots = 0;
+}
+
+/// Fence the frame's ring use and forget fences the GPU has passed.
+static void FenceUniformRing()
+{
+    UniformRingFence fence{ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), uniformRingHead };
+    uniformRingFences.Push(fence);
+
+    while (uniformRingFences.Size() > 1)
+    {
+        GLenum status = glClientWaitSync(uniformRingFences[0].fence_, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+        uniformRingCompleted = uniformRingFences[0].position_;
+        glDeleteSync(uniformRingFences[0].fence_);
+        uniformRingFences.Erase(0);
+    }
+}
+
+/// Switch the ring on or off at the start of a frame.
+static void UpdateUniformRing(Graphics* graphics)
+{
+    GraphicsImpl* impl = graphics->GetImpl();
+    if (uniformRingEnabled && !uniformRingActive)
+    {
+        // Apply pending changes so that the buffer objects are current when their contents are read back
+        for (PODVector<ConstantBuffer*>::Iterator i = impl->dirtyConstantBuffers_.Begin(); i != impl->dirtyConstantBuffers_.End(); ++i)
+            (*i)->Apply();
+        impl->dirtyConstantBuffers_.Clear();
+
+        if (CreateUniformRing(graphics))
+            uniformRingActive = true;
+        else
+        {
+            URHO3D_LOGWARNING("Could not create the uniform ring buffer, using separate constant buffer objects");
+            ReleaseUniformRing(graphics, true);
+            uniformRingEnabled = false;
+        }
+    }
+    else if (!uniformRingEnabled && uniformRingActive)
+    {
+        // Hand the current contents back to the constant buffers, and bind their own objects again
+        for (HashMap<ConstantBuffer*, UniformRingMirror>::Iterator i = uniformMirrors.Begin(); i != uniformMirrors.End(); ++i)
+        {
+            ConstantBuffer* buffer = i->first_;
+            if (!buffer->IsDirty())
+                impl->dirtyConstantBuffers_.Push(buffer);
+            buffer->SetParameter(0, i->second_.data_.Size(), i->second_.data_.Buffer());
+        }
+        ReleaseUniformRing(graphics, true);
+        ClearUniformMirrors();
+
+        for (unsigned i = 0; i < MAX_SHADER_PARAMETER_GROUPS * 2; ++i)
+        {
+            ConstantBuffer* buffer = impl->constantBuffers_[i];
+            glBindBufferBase(GL_UNIFORM_BUFFER, i, buffer ? buffer->GetGPUObjectName() : 0);
+        }
+        impl->boundUBO_ = 0;
+    }
+}
+#endif
+
+void SetUniformRingEnabled(bool enable)
+{
+    uniformRingEnabled = enable;
+}
+
+bool IsUniformRingEnabled()
+{
+    return uniformRingEnabled;
+}
+
+bool IsUniformRingActive()
+{
+    return uniformRingActive;
+}
+
+bool IsUniformRingPersistent()
+{
+#ifndef GL_ES_VERSION_2_0
+    return uniformRingActive && uniformRingData;
+#else
+    return false;
+#endif
+}
+
+void SetUniformRingSize(unsigned size)
+{
+    uniformRingSize = size;
+}
+
+const UniformRingStats& GetUniformRingStats()
+{
+    return lastUniformRingStats;
+}
+
+void SetConstantBufferParameter(Graphics* graphics, ConstantBuffer* buffer, unsigned offset, unsigned size, const void* data)
+{
+#ifndef GL_ES_VERSION_2_0
+    if (uniformRingActive)
+    {
+        UniformRingMirror& mirror = GetUniformMirror(graphics, buffer);
+        if (offset + size > mirror.data_.Size())
+            return;
+        if (!memcmp(&mirror.data_[offset], data, size))
+        {
+            ++uniformRingStats.unchangedSets_;
+            return;
+        }
+        memcpy(&mirror.data_[offset], data, size);
+        mirror.dirty_ = true;
+        pendingUniformSlots |= mirror.slots_;
+        return;
+    }
+#endif
+
+    if (!buffer->IsDirty())
+        graphics->GetImpl()->dirtyConstantBuffers_.Push(buffer);
+    buffer->SetParameter(offset, size, data);
+}
+
+void SetConstantBufferVector3Array(Graphics* graphics, ConstantBuffer* buffer, unsigned offset, unsigned rows, const void* data)
+{
+#ifndef GL_ES_VERSION_2_0
+    if (uniformRingActive)
+    {
+        // Rows are 16 bytes apart and their w is left as it is, like ConstantBuffer::SetVector3ArrayParameter
+        const auto* src = (const float*)data;
+        for (unsigned i = 0; i < rows; ++i)
+            SetConstantBufferParameter(graphics, buffer, offset + i * 4 * sizeof(float), 3 * sizeof(float), src + i * 3);
+        return;
+    }
+#endif
+
+    if (!buffer->IsDirty())
+        graphics->GetImpl()->dirtyConstantBuffers_.Push(buffer);
+    buffer->SetVector3ArrayParameter(offset, rows, data);
+}
+
 #ifdef GL_ES_VERSION_2_0
 static unsigned glesDepthStencilFormat = GL_DEPTH_COMPONENT16;
 static unsigned glesReadableDepthFormat = GL_DEPTH_COMPONENT;
@@ -184,6 +752,102 @@ bool CheckExtension(const String& name)
     return extensions.Contains(name);
 }
 
+typedef HashMap<Pair<ShaderVariation*, ShaderVariation*>, SharedPtr<ShaderProgram> > PreparedProgramMap;
+
+/// Programs BeginShaderProgram() started linking, until SetShaders() finishes them.
+static PreparedProgramMap preparedPrograms;
+static bool parallelShaderCompile = false;
+
+bool IsParallelShaderCompileEnabled()
+{
+    return parallelShaderCompile;
+}
+
+/// Return whether a shader pair can do without compiling its shaders: it is in the program cache already, or a binary
+/// stored for it will be restored instead of linking. ShaderProgram::BeginLink() compiles them if there is none after all.
+static bool IsCompileDeferred(Graphics* graphics, const ShaderProgramMap& programs, ShaderVariation* vs, ShaderVariation* ps)
+{
+    if (!vs || !ps || (vs->GetGPUObjectName() && ps->GetGPUObjectName()))
+        return false;
+    // A failed compile is not retried, not even behind a binary
+    if (!vs->GetCompilerOutput().Empty() || !ps->GetCompilerOutput().Empty())
+        return false;
+    if (programs.Contains(Pair<ShaderVariation*, ShaderVariation*>(vs, ps)))
+        return true;
+    auto* binaryCache = graphics->GetSubsystem<ProgramBinaryCache>();
+    return binaryCache && binaryCache->HasBinary(vs, ps);
+}
+
+SharedPtr<ShaderProgram> BeginShaderProgram(Graphics* graphics, ShaderVariation* vs, ShaderVariation* ps)
+{
+    if (!graphics || !vs || !ps)
+        return SharedPtr<ShaderProgram>();
+
+    // Compile as SetShaders() does: a failed compile is logged once and not retried
+    const bool deferCompile = IsCompileDeferred(graphics, graphics->GetImpl()->shaderPrograms_, vs, ps);
+    ShaderVariation* shaders[] = {vs, ps};
+    for (ShaderVariation* shader : shaders)
+    {
+        if (shader->GetGPUObjectName() || deferCompile)
+            continue;
+        if (!shader->GetCompilerOutput().Empty())
+            return SharedPtr<ShaderProgram>();
+
+        URHO3D_PROFILE(CompileShader);
+
+        if (!shader->Create())
+        {
+            URHO3D_LOGERROR("Failed to compile shader " + shader->GetFullName() + ":\n" + shader->GetCompilerOutput());
+            return SharedPtr<ShaderProgram>();
+        }
+        URHO3D_LOGDEBUG("Compiled shader " + shader->GetFullName());
+    }
+
+    Pair<ShaderVariation*, ShaderVariation*> combination(vs, ps);
+    PreparedProgramMap::Iterator i = preparedPrograms.Find(combination);
+    if (i != preparedPrograms.End())
+        return i->second_;
+
+    SharedPtr<ShaderProgram> program(new ShaderProgram(graphics, vs, ps));
+    if (!program->BeginLink())
+    {
+        URHO3D_LOGERROR("Failed to link vertex shader " + vs->GetFullName() + " and pixel shader " + ps->GetFullName() + ":\n" +
+                 program->GetLinkerOutput());
+        return SharedPtr<ShaderProgram>();
+    }
+
+    preparedPrograms[combination] = program;
+    return program;
+}
+
+#ifndef GL_ES_VERSION_2_0
+typedef void (APIENTRY* MaxShaderCompilerThreadsFunc)(GLuint count);
+
+/// Let the driver compile and link on its own threads. Shaders then skip the compile status query, which would wait, and
+/// programs started with BeginShaderProgram() can be polled with ShaderProgram::IsLinkComplete().
+static void EnableParallelShaderCompile()
+{
+    parallelShaderCompile = false;
+
+    const char* entry = nullptr;
+    if (CheckExtension("GL_KHR_parallel_shader_compile"))
+        entry = "glMaxShaderCompilerThreadsKHR";
+    else if (CheckExtension("GL_ARB_parallel_shader_compile"))
+        entry = "glMaxShaderCompilerThreadsARB";
+    if (!entry)
+        return;
+
+    auto maxThreads = (MaxShaderCompilerThreadsFunc)SDL_GL_GetProcAddress(entry);
+    if (maxThreads)
+    {
+        // All ones lets the implementation choose
+        maxThreads(0xffffffff);
+        parallelShaderCompile = true;
+        URHO3D_LOGDEBUG("Enabled parallel shader compile");
+    }
+}
+#endif
+
 static void GetGLPrimitiveType(unsigned elementCount, PrimitiveType type, unsigned& primitiveCount, GLenum& glPrimitiveType)
 {
     switch (type)
@@ -501,6 +1165,9 @@ bool Graphics::SetMode(int width, int height, bool fullscreen, bool borderless,
     SDL_GL_SwapWindow(window_);
 
     CheckFeatureSupport();
+#ifndef GL_ES_VERSION_2_0
+    EnableParallelShaderCompile();
+#endif
 
 #ifdef URHO3D_LOGGING
     URHO3D_LOGINFOF("Adapter used %s %s", (const char *) glGetString(GL_VENDOR), (const char *) glGetString(GL_RENDERER));
@@ -641,9 +1308,28 @@ bool Graphics::BeginFrame()
     SetColorWrite(true);
     SetDepthWrite(true);
 
+    frameStats.batches_ = numBatches_;
+    frameStats.primitives_ = numPrimitives_;
+    lastFrameStats = frameStats;
+    frameStats = GraphicsFrameStats();
     numPrimitives_ = 0;
     numBatches_ = 0;
 
+    lastVertexArrayStats = vertexArrayStats;
+    vertexArrayStats = VertexArrayStats();
+#ifndef GL_ES_VERSION_2_0
+    lastVertexArrayStats.numCached_ = vertexArrays.Size();
+    ++vertexArrayFrame;
+    TrimVertexArrays();
+#endif
+
+    lastUniformRingStats = uniformRingStats;
+    uniformRingStats = UniformRingStats();
+#ifndef GL_ES_VERSION_2_0
+    if (gl3Support)
+        UpdateUniformRing(this);
+#endif
+
     SendEvent(E_BEGINRENDERING);
 
     return true;
@@ -658,6 +1344,11 @@ void Graphics::EndFrame()
 
     SendEvent(E_ENDRENDERING);
 
+#ifndef GL_ES_VERSION_2_0
+    if (uniformRingActive)
+        FenceUniformRing();
+#endif
+
     SDL_GL_SwapWindow(window_);
 
     // Clean up too large scratch buffers
@@ -721,7 +1412,7 @@ bool Graphics::ResolveToTexture(Texture2D* destination, const IntRect& viewport)
     if (!destination || !destination->GetRenderSurface())
         return false;
 
-    URHO3D_PROFILE(ResolveToTexture);
+    URHO3D_PROFILE_GPU(ResolveToTexture);
 
     IntRect vpCopy = viewport;
     if (vpCopy.right_ <= vpCopy.left_)
@@ -753,7 +1444,7 @@ bool Graphics::ResolveToTexture(Texture2D* texture)
     if (!surface || !surface->GetRenderBuffer())
         return false;
 
-    URHO3D_PROFILE(ResolveToTexture);
+    URHO3D_PROFILE_GPU(ResolveToTexture);
 
     texture->SetResolveDirty(false);
     surface->SetResolveDirty(false);
@@ -804,7 +1495,7 @@ bool Graphics::ResolveToTexture(TextureCube* texture)
     if (!texture)
         return false;
 
-    URHO3D_PROFILE(ResolveToTexture);
+    URHO3D_PROFILE_GPU(ResolveToTexture);
 
     texture->SetResolveDirty(false);
 
@@ -1041,8 +1732,11 @@ void Graphics::SetShaders(ShaderVariation* vs, ShaderVariation* ps)
     if (vs == vertexShader_ && ps == pixelShader_)
         return;
 
-    // Compile the shaders now if not yet compiled. If already attempted, do not retry
-    if (vs && !vs->GetGPUObjectName())
+    ++frameStats.shaderChanges_;
+
+    // Compile the shaders now if not yet compiled, unless the pair does without. If already attempted, do not retry
+    const bool deferCompile = IsCompileDeferred(this, impl_->shaderPrograms_, vs, ps);
+    if (vs && !vs->GetGPUObjectName() && !deferCompile)
     {
         if (vs->GetCompilerOutput().Empty())
         {
@@ -1061,7 +1755,7 @@ void Graphics::SetShaders(ShaderVariation* vs, ShaderVariation* ps)
             vs = nullptr;
     }
 
-    if (ps && !ps->GetGPUObjectName())
+    if (ps && !ps->GetGPUObjectName() && !deferCompile)
     {
         if (ps->GetCompilerOutput().Empty())
         {
@@ -1097,6 +1791,10 @@ void Graphics::SetShaders(ShaderVariation* vs, ShaderVariation* ps)
 
         if (i != impl_->shaderPrograms_.End())
         {
+            // A pair linked before BeginShaderProgram() was called for it does not need the second program
+            if (!preparedPrograms.Empty())
+                preparedPrograms.Erase(combination);
+
             // Use the existing linked program
             if (i->second_->GetGPUObjectName())
             {
@@ -1111,14 +1809,32 @@ void Graphics::SetShaders(ShaderVariation* vs, ShaderVariation* ps)
         }
         else
         {
-            // Link a new combination
-            URHO3D_PROFILE(LinkShaders);
+            SharedPtr<ShaderProgram> newProgram;
+            bool linked;
 
-            SharedPtr<ShaderProgram> newProgram(new ShaderProgram(this, vs, ps));
-            if (newProgram->Link())
+            PreparedProgramMap::Iterator j = preparedPrograms.Find(combination);
+            if (j != preparedPrograms.End())
+            {
+                // Finish the link BeginShaderProgram() started; waits only if the driver is not done yet
+                URHO3D_PROFILE(FinishLinkShaders);
+
+                newProgram = j->second_;
+                preparedPrograms.Erase(j);
+                linked = newProgram->EndLink();
+            }
+            else
+            {
+                // Link a new combination
+                URHO3D_PROFILE(LinkShaders);
+
+                newProgram = new ShaderProgram(this, vs, ps);
+                linked = newProgram->Link();
+            }
+
+            if (linked)
             {
                 URHO3D_LOGDEBUG("Linked vertex shader " + vs->GetFullName() + " and pixel shader " + ps->GetFullName());
-                // Note: Link() calls glUseProgram() to set the texture sampler uniforms,
+                // Note: Link() and EndLink() call glUseProgram() to set the texture sampler uniforms,
                 // so it is not necessary to call it again
                 impl_->shaderProgram_ = newProgram;
             }
@@ -1144,10 +1860,19 @@ void Graphics::SetShaders(ShaderVariation* vs, ShaderVariation* ps)
             ConstantBuffer* buffer = constantBuffers[i].Get();
             if (buffer != impl_->constantBuffers_[i])
             {
-                unsigned object = buffer ? buffer->GetGPUObjectName() : 0;
-                glBindBufferBase(GL_UNIFORM_BUFFER, i, object);
-                // Calling glBindBufferBase also affects the generic buffer binding point
-                impl_->boundUBO_ = object;
+                // With the uniform ring, PrepareDraw binds the range of the buffer's latest copy
+                if (uniformRingActive)
+                {
+                    boundUniformRanges[i] = NO_UNIFORM_RANGE;
+                    pendingUniformSlots |= 1u << i;
+                }
+                else
+                {
+                    unsigned object = buffer ? buffer->GetGPUObjectName() : 0;
+                    glBindBufferBase(GL_UNIFORM_BUFFER, i, object);
+                    // Calling glBindBufferBase also affects the generic buffer binding point
+                    impl_->boundUBO_ = object;
+                }
                 impl_->constantBuffers_[i] = buffer;
                 ShaderProgram::ClearGlobalParameterSource((ShaderParameterGroup)(i % MAX_SHADER_PARAMETER_GROUPS));
             }
@@ -1165,11 +1890,18 @@ void Graphics::SetShaders(ShaderVariation* vs, ShaderVariation* ps)
     {
         impl_->usedVertexAttributes_ = impl_->shaderProgram_->GetUsedVertexAttributes();
         impl_->vertexAttributes_ = &impl_->shaderProgram_->GetVertexAttributes();
+#ifndef GL_ES_VERSION_2_0
+        if (gl3Support)
+            GetVertexLayout(impl_->vertexAttributes_, vertexLayout);
+#endif
     }
     else
     {
         impl_->usedVertexAttributes_ = 0;
         impl_->vertexAttributes_ = nullptr;
+#ifndef GL_ES_VERSION_2_0
+        vertexLayout.Clear();
+#endif
     }
 
     impl_->vertexBuffersDirty_ = true;
@@ -1184,13 +1916,11 @@ void Graphics::SetShaderParameter(StringHash param, const float* data, unsigned
         {
             if (info->bufferPtr_)
             {
-                ConstantBuffer* buffer = info->bufferPtr_;
-                if (!buffer->IsDirty())
-                    impl_->dirtyConstantBuffers_.Push(buffer);
-                buffer->SetParameter(info->offset_, (unsigned)(count * sizeof(float)), data);
+                SetConstantBufferParameter(this, info->bufferPtr_, info->offset_, (unsigned)(count * sizeof(float)), data);
                 return;
             }
 
+            frameStats.uniformBytes_ += (unsigned)(count * sizeof(float));
             switch (info->glType_)
             {
             case GL_FLOAT:
@@ -1232,13 +1962,11 @@ void Graphics::SetShaderParameter(StringHash param, float value)
         {
             if (info->bufferPtr_)
             {
-                ConstantBuffer* buffer = info->bufferPtr_;
-                if (!buffer->IsDirty())
-                    impl_->dirtyConstantBuffers_.Push(buffer);
-                buffer->SetParameter(info->offset_, sizeof(float), &value);
+                SetConstantBufferParameter(this, info->bufferPtr_, info->offset_, sizeof(float), &value);
                 return;
             }
 
+            frameStats.uniformBytes_ += sizeof(float);
             glUniform1fv(info->location_, 1, &value);
         }
     }
@@ -1253,13 +1981,11 @@ void Graphics::SetShaderParameter(StringHash param, int value)
         {
             if (info->bufferPtr_)
             {
-                ConstantBuffer* buffer = info->bufferPtr_;
-                if (!buffer->IsDirty())
-                    impl_->dirtyConstantBuffers_.Push(buffer);
-                buffer->SetParameter(info->offset_, sizeof(int), &value);
+                SetConstantBufferParameter(this, info->bufferPtr_, info->offset_, sizeof(int), &value);
                 return;
             }
 
+            frameStats.uniformBytes_ += sizeof(int);
             glUniform1i(info->location_, value);
         }
     }
@@ -1275,13 +2001,11 @@ void Graphics::SetShaderParameter(StringHash param, bool value)
         {
             if (info->bufferPtr_)
             {
-                ConstantBuffer* buffer = info->bufferPtr_;
-                if (!buffer->IsDirty())
-                    impl_->dirtyConstantBuffers_.Push(buffer);
-                buffer->SetParameter(info->offset_, sizeof(bool), &value);
+                SetConstantBufferParameter(this, info->bufferPtr_, info->offset_, sizeof(bool), &value);
                 return;
             }
 
+            frameStats.uniformBytes_ += sizeof(int);
             glUniform1i(info->location_, (int)value);
         }
     }
@@ -1301,13 +2025,11 @@ void Graphics::SetShaderParameter(StringHash param, const Vector2& vector)
         {
             if (info->bufferPtr_)
             {
-                ConstantBuffer* buffer = info->bufferPtr_;
-                if (!buffer->IsDirty())
-                    impl_->dirtyConstantBuffers_.Push(buffer);
-                buffer->SetParameter(info->offset_, sizeof(Vector2), &vector);
+                SetConstantBufferParameter(this, info->bufferPtr_, info->offset_, sizeof(Vector2), &vector);
                 return;
             }
 
+            frameStats.uniformBytes_ += sizeof(Vector2);
             // Check the uniform type to avoid mismatch
             switch (info->glType_)
             {
@@ -1334,13 +2056,11 @@ void Graphics::SetShaderParameter(StringHash param, const Matrix3& matrix)
         {
             if (info->bufferPtr_)
             {
-                ConstantBuffer* buffer = info->bufferPtr_;
-                if (!buffer->IsDirty())
-                    impl_->dirtyConstantBuffers_.Push(buffer);
-                buffer->SetVector3ArrayParameter(info->offset_, 3, &matrix);
+                SetConstantBufferVector3Array(this, info->bufferPtr_, info->offset_, 3, &matrix);
                 return;
             }
 
+            frameStats.uniformBytes_ += sizeof(Matrix3);
             glUniformMatrix3fv(info->location_, 1, GL_FALSE, matrix.Data());
         }
     }
@@ -1355,13 +2075,11 @@ void Graphics::SetShaderParameter(StringHash param, const Vector3& vector)
         {
             if (info->bufferPtr_)
             {
-                ConstantBuffer* buffer = info->bufferPtr_;
-                if (!buffer->IsDirty())
-                    impl_->dirtyConstantBuffers_.Push(buffer);
-                buffer->SetParameter(info->offset_, sizeof(Vector3), &vector);
+                SetConstantBufferParameter(this, info->bufferPtr_, info->offset_, sizeof(Vector3), &vector);
                 return;
             }
 
+            frameStats.uniformBytes_ += sizeof(Vector3);
             // Check the uniform type to avoid mismatch
             switch (info->glType_)
             {
@@ -1392,13 +2110,11 @@ void Graphics::SetShaderParameter(StringHash param, const Matrix4& matrix)
         {
             if (info->bufferPtr_)
             {
-                ConstantBuffer* buffer = info->bufferPtr_;
-                if (!buffer->IsDirty())
-                    impl_->dirtyConstantBuffers_.Push(buffer);
-                buffer->SetParameter(info->offset_, sizeof(Matrix4), &matrix);
+                SetConstantBufferParameter(this, info->bufferPtr_, info->offset_, sizeof(Matrix4), &matrix);
                 return;
             }
 
+            frameStats.uniformBytes_ += sizeof(Matrix4);
             glUniformMatrix4fv(info->location_, 1, GL_FALSE, matrix.Data());
         }
     }
@@ -1413,13 +2129,11 @@ void Graphics::SetShaderParameter(StringHash param, const Vector4& vector)
         {
             if (info->bufferPtr_)
             {
-                ConstantBuffer* buffer = info->bufferPtr_;
-                if (!buffer->IsDirty())
-                    impl_->dirtyConstantBuffers_.Push(buffer);
-                buffer->SetParameter(info->offset_, sizeof(Vector4), &vector);
+                SetConstantBufferParameter(this, info->bufferPtr_, info->offset_, sizeof(Vector4), &vector);
                 return;
             }
 
+            frameStats.uniformBytes_ += sizeof(Vector4);
             // Check the uniform type to avoid mismatch
             switch (info->glType_)
             {
@@ -1469,13 +2183,11 @@ void Graphics::SetShaderParameter(StringHash param, const Matrix3x4& matrix)
 
             if (info->bufferPtr_)
             {
-                ConstantBuffer* buffer = info->bufferPtr_;
-                if (!buffer->IsDirty())
-                    impl_->dirtyConstantBuffers_.Push(buffer);
-                buffer->SetParameter(info->offset_, sizeof(Matrix4), &fullMatrix);
+                SetConstantBufferParameter(this, info->bufferPtr_, info->offset_, sizeof(Matrix4), &fullMatrix);
                 return;
             }
 
+            frameStats.uniformBytes_ += sizeof(Matrix4);
             glUniformMatrix4fv(info->location_, 1, GL_FALSE, fullMatrix.Data());
         }
     }
@@ -1555,6 +2267,7 @@ void Graphics::SetTexture(unsigned index, Texture* texture)
                 glBindTexture(impl_->textureTypes_[index], 0);
             glBindTexture(glType, texture->GetGPUObjectName());
             impl_->textureTypes_[index] = glType;
+            ++frameStats.textureBinds_;
 
             if (texture->GetParametersDirty())
                 texture->UpdateParameters();
@@ -1580,6 +2293,7 @@ void Graphics::SetTexture(unsigned index, Texture* texture)
             }
 
             glBindTexture(texture->GetTarget(), texture->GetGPUObjectName());
+            ++frameStats.textureBinds_;
             if (texture->GetParametersDirty())
                 texture->UpdateParameters();
             if (texture->GetLevelsDirty())
@@ -1603,6 +2317,7 @@ void Graphics::SetTextureForUpdate(Texture* texture)
     glBindTexture(glType, texture->GetGPUObjectName());
     impl_->textureTypes_[0] = glType;
     textures_[0] = texture;
+    ++frameStats.textureBinds_;
 }
 
 void Graphics::SetDefaultTextureFilterMode(TextureFilterMode mode)
@@ -1774,6 +2489,7 @@ void Graphics::SetBlendMode(BlendMode mode, bool alphaToCoverage)
 {
     if (mode != blendMode_)
     {
+        ++frameStats.blendChanges_;
         if (mode == BLEND_REPLACE)
             glDisable(GL_BLEND);
 		else if (mode == BLEND_ALPHARGB)
@@ -1820,6 +2536,7 @@ void Graphics::SetCullMode(CullMode mode)
 {
     if (mode != cullMode_)
     {
+        ++frameStats.cullChanges_;
         if (mode == CULL_NONE)
             glDisable(GL_CULL_FACE);
         else
@@ -1861,6 +2578,7 @@ void Graphics::SetDepthTest(CompareMode mode)
     {
         glDepthFunc(glCmpFunc[mode]);
         depthTestMode_ = mode;
+        ++frameStats.depthChanges_;
     }
 }
 
@@ -1870,6 +2588,7 @@ void Graphics::SetDepthWrite(bool enable)
     {
         glDepthMask(enable ? GL_TRUE : GL_FALSE);
         depthWrite_ = enable;
+        ++frameStats.depthChanges_;
     }
 }
 
@@ -2350,6 +3069,14 @@ void Graphics::CleanupShaderPrograms(ShaderVariation* variation)
             ++i;
     }
 
+    for (PreparedProgramMap::Iterator i = preparedPrograms.Begin(); i != preparedPrograms.End();)
+    {
+        if (i->first_.first_ == variation || i->first_.second_ == variation)
+            i = preparedPrograms.Erase(i);
+        else
+            ++i;
+    }
+
     if (vertexShader_ == variation || pixelShader_ == variation)
         impl_->shaderProgram_ = nullptr;
 }
@@ -2382,6 +3109,7 @@ void Graphics::Release(bool clearGPUObjects, bool closeWindow)
             // Shutting down: release all GPU objects that still exist
             // Shader programs are also GPU objects; clear them first to avoid list modification during iteration
             impl_->shaderPrograms_.Clear();
+            preparedPrograms.Clear();
 
             for (PODVector<GPUObject*>::Iterator i = gpuObjects_.Begin(); i != gpuObjects_.End(); ++i)
                 (*i)->Release();
@@ -2396,6 +3124,7 @@ void Graphics::Release(bool clearGPUObjects, bool closeWindow)
             // In this case clear shader programs last so that they do not attempt to delete their OpenGL program
             // from a context that may no longer exist
             impl_->shaderPrograms_.Clear();
+            preparedPrograms.Clear();
 
             SendEvent(E_DEVICELOST);
         }
@@ -2416,6 +3145,15 @@ void Graphics::Release(bool clearGPUObjects, bool closeWindow)
         if (!clearGPUObjects)
             URHO3D_LOGINFO("OpenGL context lost");
 
+#ifndef GL_ES_VERSION_2_0
+        // Vertex array objects are not shared between contexts
+        ClearVertexArrays(clearGPUObjects);
+        defaultVertexArray = 0;
+        // Neither are sync objects; the ring is recreated at the next BeginFrame, the constant buffer contents are kept
+        ReleaseUniformRing(this, clearGPUObjects);
+        if (clearGPUObjects)
+            ClearUniformMirrors();
+#endif
         SDL_GL_DeleteContext(impl_->context_);
         impl_->context_ = nullptr;
     }
@@ -2493,10 +3231,13 @@ void Graphics::Restore()
             gl3Support = true;
             apiName_ = "GL3";
 
-            // Create and bind a vertex array object that will stay in use throughout
+            // Create and bind a vertex array object that will stay in use throughout, unless the vertex array cache
+            // binds its own
             unsigned vertexArrayObject;
             glGenVertexArrays(1, &vertexArrayObject);
             glBindVertexArray(vertexArrayObject);
+            defaultVertexArray = vertexArrayObject;
+            boundVertexArray = vertexArrayObject;
         }
         else if (GLEW_VERSION_2_0)
         {
@@ -2847,9 +3588,17 @@ void Graphics::PrepareDraw()
 #ifndef GL_ES_VERSION_2_0
     if (gl3Support)
     {
-        for (PODVector<ConstantBuffer*>::Iterator i = impl_->dirtyConstantBuffers_.Begin(); i != impl_->dirtyConstantBuffers_.End(); ++i)
-            (*i)->Apply();
-        impl_->dirtyConstantBuffers_.Clear();
+        if (uniformRingActive)
+            ApplyUniformRing(this);
+        else
+        {
+            for (PODVector<ConstantBuffer*>::Iterator i = impl_->dirtyConstantBuffers_.Begin(); i != impl_->dirtyConstantBuffers_.End(); ++i)
+            {
+                (*i)->Apply();
+                frameStats.constantBufferBytes_ += (*i)->GetSize();
+            }
+            impl_->dirtyConstantBuffers_.Clear();
+        }
     }
 #endif
 
@@ -3071,6 +3820,96 @@ void Graphics::PrepareDraw()
 #endif
     }
 
+#ifndef GL_ES_VERSION_2_0
+    if (vertexArrayCacheToggled)
+    {
+        // Switching to or from the cache: the default vertex array object still has its attributes, respecify anyway
+        vertexArrayCacheToggled = false;
+        if (gl3Support && !vertexArrayCacheEnabled && defaultVertexArray)
+            BindVertexArray(defaultVertexArray, indexBuffer_);
+        impl_->vertexBuffersDirty_ = true;
+    }
+
+    if (impl_->vertexBuffersDirty_ && gl3Support && vertexArrayCacheEnabled)
+    {
+        // Without a shader program nothing can be drawn, and the bound cached vertex array object must not be touched
+        if (impl_->vertexAttributes_)
+        {
+            const unsigned long long key = HashVertexArray(vertexBuffers_, impl_->lastInstanceOffset_);
+            HashMap<unsigned long long, VertexArrayEntry>::Iterator i = vertexArrays.Find(key);
+            if (i != vertexArrays.End() && IsSameVertexArray(i->second_, vertexBuffers_, impl_->lastInstanceOffset_))
+            {
+                ++vertexArrayStats.cacheHits_;
+                i->second_.lastFrame_ = vertexArrayFrame;
+                BindVertexArray(i->second_.vao_, indexBuffer_);
+            }
+            else
+            {
+                // New combination, or a hash collision / stale entry that is replaced
+                if (i != vertexArrays.End())
+                {
+                    if (boundVertexArray == i->second_.vao_)
+                        BindVertexArray(defaultVertexArray, indexBuffer_);
+                    glDeleteVertexArrays(1, &i->second_.vao_);
+                }
+                VertexArrayEntry& entry = vertexArrays[key];
+                entry = VertexArrayEntry();
+                glGenVertexArrays(1, &entry.vao_);
+                ++vertexArrayStats.vaoCreated_;
+                BindVertexArray(entry.vao_, indexBuffer_);
+                entry.layout_ = vertexLayout;
+                entry.instanceOffset_ = impl_->lastInstanceOffset_;
+                entry.lastFrame_ = vertexArrayFrame;
+
+                // Same assignment as below, on a fresh object: everything starts disabled and without divisors
+                unsigned assignedLocations = 0;
+                for (unsigned j = MAX_VERTEX_STREAMS - 1; j < MAX_VERTEX_STREAMS; --j)
+                {
+                    VertexBuffer* buffer = GetUsableBuffer(vertexBuffers_[j]);
+                    if (!buffer)
+                        continue;
+                    entry.buffers_[j] = buffer;
+                    entry.bufferNames_[j] = buffer->GetGPUObjectName();
+                    entry.elements_[j] = buffer->GetElements();
+
+                    const PODVector<VertexElement>& elements = buffer->GetElements();
+                    for (PODVector<VertexElement>::ConstIterator k = elements.Begin(); k != elements.End(); ++k)
+                    {
+                        const VertexElement& element = *k;
+                        HashMap<Pair<unsigned char, unsigned char>, unsigned>::ConstIterator l =
+                            impl_->vertexAttributes_->Find(MakePair((unsigned char)element.semantic_, element.index_));
+                        if (l == impl_->vertexAttributes_->End())
+                            continue;
+
+                        unsigned location = l->second_;
+                        unsigned locationMask = 1u << location;
+                        if (assignedLocations & locationMask)
+                            continue;
+                        assignedLocations |= locationMask;
+
+                        glEnableVertexAttribArray(location);
+                        ++vertexArrayStats.attributeCalls_;
+                        unsigned dataStart = element.offset_;
+                        if (element.perInstance_)
+                        {
+                            dataStart += impl_->lastInstanceOffset_ * buffer->GetVertexSize();
+                            SetVertexAttribDivisor(location, 1);
+                            ++vertexArrayStats.attributeCalls_;
+                        }
+
+                        SetVBO(buffer->GetGPUObjectName());
+                        glVertexAttribPointer(location, glElementComponents[element.type_], glElementTypes[element.type_],
+                            element.type_ == TYPE_UBYTE4_NORM ? GL_TRUE : GL_FALSE, (unsigned)buffer->GetVertexSize(),
+                            (const void *)(size_t)dataStart);
+                        ++vertexArrayStats.attributeCalls_;
+                    }
+                }
+            }
+        }
+        impl_->vertexBuffersDirty_ = false;
+    }
+#endif
+
     if (impl_->vertexBuffersDirty_)
     {
         // Go through currently bound vertex buffers and set the attribute pointers that are available & required
@@ -3106,6 +3945,7 @@ void Graphics::PrepareDraw()
                     {
                         glEnableVertexAttribArray(location);
                         impl_->enabledVertexAttributes_ |= locationMask;
+                        ++vertexArrayStats.attributeCalls_;
                     }
 
                     // Enable/disable instancing divisor as necessary
@@ -3117,6 +3957,7 @@ void Graphics::PrepareDraw()
                         {
                             SetVertexAttribDivisor(location, 1);
                             impl_->instancingVertexAttributes_ |= locationMask;
+                            ++vertexArrayStats.attributeCalls_;
                         }
                     }
                     else
@@ -3125,6 +3966,7 @@ void Graphics::PrepareDraw()
                         {
                             SetVertexAttribDivisor(location, 0);
                             impl_->instancingVertexAttributes_ &= ~locationMask;
+                            ++vertexArrayStats.attributeCalls_;
                         }
                     }
 
@@ -3132,6 +3974,7 @@ void Graphics::PrepareDraw()
                     glVertexAttribPointer(location, glElementComponents[element.type_], glElementTypes[element.type_],
                         element.type_ == TYPE_UBYTE4_NORM ? GL_TRUE : GL_FALSE, (unsigned)buffer->GetVertexSize(),
                         (const void *)(size_t)dataStart);
+                    ++vertexArrayStats.attributeCalls_;
                 }
             }
         }
@@ -3145,6 +3988,7 @@ void Graphics::PrepareDraw()
             {
                 glDisableVertexAttribArray(location);
                 impl_->enabledVertexAttributes_ &= ~(1u << location);
+                ++vertexArrayStats.attributeCalls_;
             }
             ++location;
             disableVertexAttributes >>= 1;
@@ -3243,6 +4087,9 @@ void Graphics::ResetCachedState()
     for (auto& constantBuffer : impl_->constantBuffers_)
         constantBuffer = nullptr;
     impl_->dirtyConstantBuffers_.Clear();
+#ifndef GL_ES_VERSION_2_0
+    ResetUniformRanges();
+#endif
 }
 
 void Graphics::SetTextureUnitMappings()
@@ -3295,6 +4142,7 @@ void Graphics::DeleteFramebuffer(unsigned fbo)
 
 void Graphics::BindFramebuffer(unsigned fbo)
 {
+    ++frameStats.framebufferBinds_;
 #ifndef GL_ES_VERSION_2_0
     if (!gl3Support)
         glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo);
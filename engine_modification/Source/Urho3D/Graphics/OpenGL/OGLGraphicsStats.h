@@ -0,0 +1,62 @@
+//
+// Copyright (c) 2008-2019 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../../Urho3D.h"
+
+namespace Urho3D
+{
+
+/// Work of the OpenGL renderer during one frame. State changes are counted where Graphics makes the GL call, so setters
+/// that find the state already set do not count.
+struct GraphicsFrameStats
+{
+    /// Same as Graphics::GetNumBatches() and GetNumPrimitives() at the end of the frame.
+    unsigned batches_{};
+    unsigned primitives_{};
+    /// Shader program changes.
+    unsigned shaderChanges_{};
+    /// Texture unit binds, including binds for updating a texture.
+    unsigned textureBinds_{};
+    /// Framebuffer object binds, not counting the resolve blits.
+    unsigned framebufferBinds_{};
+    /// Blend mode, depth test or depth write, and cull mode changes.
+    unsigned blendChanges_{};
+    unsigned depthChanges_{};
+    unsigned cullChanges_{};
+    /// Bytes of shader parameters set with glUniform.
+    unsigned uniformBytes_{};
+    /// Bytes of constant buffers uploaded to their own buffer objects or copied to the uniform ring.
+    unsigned constantBufferBytes_{};
+    /// Bytes of vertex and index buffer data uploaded with SetData() and SetDataRange(), including the unlocks that go
+    /// through them and data restored after a lost device.
+    unsigned bufferUploadBytes_{};
+};
+
+/// Return the counters of the last finished frame.
+URHO3D_API const GraphicsFrameStats& GetGraphicsFrameStats();
+/// Count vertex or index buffer bytes uploaded in the current frame. Called by VertexBuffer and IndexBuffer.
+URHO3D_API void AddBufferUploadBytes(unsigned bytes);
+
+}
@@ -0,0 +1,310 @@
+//
+// Copyright (c) 2008-2019 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../../Precompiled.h"
+
+#include "../../Core/Context.h"
+#include "../../Core/CoreEvents.h"
+#include "../../Core/Timer.h"
+#include "../../Core/WorkQueue.h"
+#include "../../Graphics/Graphics.h"
+#include "../../Graphics/GraphicsImpl.h"
+#include "../../Graphics/Shader.h"
+#include "../../Graphics/ShaderProgram.h"
+#include "../../Graphics/ShaderVariation.h"
+#include "../../Graphics/OpenGL/OGLProgramBinaryCache.h"
+#include "../../IO/File.h"
+#include "../../IO/FileSystem.h"
+#include "../../IO/Log.h"
+
+#include "../../DebugNew.h"
+
+namespace Urho3D
+{
+
+static const char* BINARY_FILE_ID = "UPBC";
+/// Binaries read back per frame; each read is a copy out of the driver.
+static const unsigned MAX_STORES_PER_FRAME = 4;
+
+/// A binary read back on the main thread, written to disk on a worker.
+struct ProgramBinaryStore
+{
+    ProgramBinaryCache* owner_;
+    Context* context_;
+    String fileName_;
+    String programName_;
+    unsigned format_;
+    PODVector<unsigned char> binary_;
+    long long linkTime_;
+    bool success_;
+};
+
+/// Runs on a worker thread. File is created and destroyed here, no reference is shared with the main thread.
+static void StoreWork(const WorkItem* item, unsigned threadIndex)
+{
+    auto* store = static_cast<ProgramBinaryStore*>(item->aux_);
+    store->success_ = false;
+
+    File file(store->context_, store->fileName_, FILE_WRITE);
+    if (!file.IsOpen())
+        return;
+    file.WriteFileID(BINARY_FILE_ID);
+    file.WriteUInt(store->format_);
+    file.WriteUInt(store->binary_.Size());
+    store->success_ = file.Write(&store->binary_[0], store->binary_.Size()) == store->binary_.Size();
+}
+
+/// 64-bit FNV-1a, StringHash is too short to name files by.
+static void HashString(unsigned long long& hash, const String& str)
+{
+    for (unsigned i = 0; i < str.Length(); ++i)
+    {
+        hash ^= (unsigned char)str[i];
+        hash *= 0x100000001b3ULL;
+    }
+    // Separator, so that moving text between the parts changes the hash
+    hash ^= 0xff;
+    hash *= 0x100000001b3ULL;
+}
+
+ProgramBinaryCache::ProgramBinaryCache(Context* context, const String& directory) :
+    Object(context),
+    directory_(AddTrailingSlash(directory))
+{
+    auto* fileSystem = GetSubsystem<FileSystem>();
+    if (fileSystem && !fileSystem->DirExists(directory_))
+        fileSystem->CreateDir(directory_);
+
+    SubscribeToEvent(E_WORKITEMCOMPLETED, URHO3D_HANDLER(ProgramBinaryCache, HandleWorkItemCompleted));
+}
+
+ProgramBinaryCache::~ProgramBinaryCache()
+{
+    // Complete() delivers the completion events while we are still subscribed; free whatever they did not
+    if (jobs_.Empty())
+        return;
+    GetSubsystem<WorkQueue>()->Complete(0);
+    for (unsigned i = 0; i < jobs_.Size(); ++i)
+        delete static_cast<ProgramBinaryStore*>(jobs_[i]);
+}
+
+bool ProgramBinaryCache::IsSupported() const
+{
+#ifndef GL_ES_VERSION_2_0
+    if (supported_ < 0)
+    {
+        supported_ = 0;
+        if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+        {
+            // Some drivers expose the entry points but no format
+            GLint numFormats = 0;
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+            supported_ = numFormats > 0 ? 1 : 0;
+        }
+    }
+    return supported_ > 0;
+#else
+    return false;
+#endif
+}
+
+const String& ProgramBinaryCache::GetDriverString() const
+{
+    if (driver_.Empty())
+    {
+        driver_ = String((const char*)glGetString(GL_VENDOR)) + "|" + String((const char*)glGetString(GL_RENDERER)) + "|" +
+            String((const char*)glGetString(GL_VERSION)) + "|" + String(Graphics::GetGL3Support());
+    }
+    return driver_;
+}
+
+String ProgramBinaryCache::GetKey(ShaderVariation* vs, ShaderVariation* ps) const
+{
+    unsigned long long hash = 0xcbf29ce484222325ULL;
+    HashString(hash, vs->GetOwner() ? vs->GetOwner()->GetSourceCode(VS) : String::EMPTY);
+    HashString(hash, vs->GetDefines());
+    HashString(hash, ps->GetOwner() ? ps->GetOwner()->GetSourceCode(PS) : String::EMPTY);
+    HashString(hash, ps->GetDefines());
+    HashString(hash, GetDriverString());
+    return ToStringHex((unsigned)(hash >> 32)) + ToStringHex((unsigned)hash) + ".bin";
+}
+
+bool ProgramBinaryCache::HasBinary(ShaderVariation* vs, ShaderVariation* ps) const
+{
+    if (!vs || !ps || !IsSupported())
+        return false;
+    return GetSubsystem<FileSystem>()->FileExists(directory_ + GetKey(vs, ps));
+}
+
+bool ProgramBinaryCache::Restore(unsigned program, ShaderVariation* vs, ShaderVariation* ps)
+{
+#ifndef GL_ES_VERSION_2_0
+    if (!program || !vs || !ps || !IsSupported())
+        return false;
+
+    auto* fileSystem = GetSubsystem<FileSystem>();
+    const String fileName = directory_ + GetKey(vs, ps);
+    if (!fileSystem->FileExists(fileName))
+        return false;
+
+    HiresTimer timer;
+    PODVector<unsigned char> binary;
+    unsigned format = 0;
+    {
+        File file(context_, fileName);
+        if (file.IsOpen() && file.ReadFileID() == BINARY_FILE_ID)
+        {
+            format = file.ReadUInt();
+            binary.Resize(file.ReadUInt());
+            if (binary.Empty() || file.Read(&binary[0], binary.Size()) != binary.Size())
+                binary.Clear();
+        }
+    }
+
+    GLint linked = GL_FALSE;
+    if (!binary.Empty())
+    {
+        glProgramBinary(program, format, &binary[0], binary.Size());
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    }
+    if (!linked)
+    {
+        // A truncated file, or the driver changed its format without changing its version string
+        URHO3D_LOGWARNING("Program binary " + fileName + " was rejected, relinking " + vs->GetFullName() + " and " +
+            ps->GetFullName());
+        fileSystem->Delete(fileName);
+        ++numRejected_;
+        return false;
+    }
+
+    restoreTime_ += timer.GetUSec(false);
+    ++numRestored_;
+    URHO3D_LOGDEBUG("Restored program binary of " + vs->GetFullName() + " and " + ps->GetFullName());
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ProgramBinaryCache::QueueStore(ShaderProgram* program, long long linkTime)
+{
+    if (!program)
+        return;
+
+    PendingStore store;
+    store.program_ = program;
+    store.linkTime_ = linkTime;
+    pendingStores_.Push(store);
+    SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(ProgramBinaryCache, HandleEndFrame));
+}
+
+void ProgramBinaryCache::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+#ifndef GL_ES_VERSION_2_0
+    auto* graphics = GetSubsystem<Graphics>();
+    auto* queue = GetSubsystem<WorkQueue>();
+    if (!graphics || graphics->IsDeviceLost())
+        return;
+
+    unsigned done = 0;
+    unsigned stored = 0;
+    while (done < pendingStores_.Size() && stored < MAX_STORES_PER_FRAME)
+    {
+        const PendingStore& pending = pendingStores_[done++];
+        // Released, or lost with the device, since it was linked
+        ShaderProgram* program = pending.program_;
+        if (!program || !program->GetGPUObjectName() || !program->GetVertexShader() || !program->GetPixelShader())
+            continue;
+
+        // Drivers may return nothing when GL_PROGRAM_BINARY_RETRIEVABLE_HINT was not set before the link
+        GLint length = 0;
+        glGetProgramiv(program->GetGPUObjectName(), GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            continue;
+
+        auto* store = new ProgramBinaryStore();
+        store->binary_.Resize((unsigned)length);
+        GLsizei written = 0;
+        GLenum format = 0;
+        glGetProgramBinary(program->GetGPUObjectName(), length, &written, &format, &store->binary_[0]);
+        if (written <= 0)
+        {
+            delete store;
+            continue;
+        }
+        store->binary_.Resize((unsigned)written);
+        store->owner_ = this;
+        store->context_ = context_;
+        store->fileName_ = directory_ + GetKey(program->GetVertexShader(), program->GetPixelShader());
+        store->programName_ = program->GetVertexShader()->GetFullName() + " and " + program->GetPixelShader()->GetFullName();
+        store->format_ = format;
+        store->linkTime_ = pending.linkTime_;
+        store->success_ = false;
+
+        SharedPtr<WorkItem> item = queue->GetFreeItem();
+        item->priority_ = 0;
+        item->workFunction_ = StoreWork;
+        item->aux_ = store;
+        item->sendEvent_ = true;
+        jobs_.Push(store);
+        queue->AddWorkItem(item);
+        ++stored;
+    }
+
+    pendingStores_.Erase(0, done);
+#else
+    pendingStores_.Clear();
+#endif
+    if (pendingStores_.Empty())
+        UnsubscribeFromEvent(E_ENDFRAME);
+}
+
+void ProgramBinaryCache::HandleWorkItemCompleted(StringHash eventType, VariantMap& eventData)
+{
+    using namespace WorkItemCompleted;
+
+    auto* item = static_cast<WorkItem*>(eventData[P_ITEM].GetPtr());
+    // Another cache may have freed its store already, so look only inside the stores this one handed out
+    if (item->workFunction_ != StoreWork || !jobs_.Contains(item->aux_))
+        return;
+
+    auto* store = static_cast<ProgramBinaryStore*>(item->aux_);
+    if (store->success_)
+    {
+        linkTime_ += store->linkTime_;
+        ++numStored_;
+        URHO3D_LOGDEBUG("Stored program binary of " + store->programName_ + ", " + String(store->binary_.Size() / 1024) + " KB");
+    }
+    else
+    {
+        // Do not leave a truncated file behind; Restore() would reject it anyway
+        GetSubsystem<FileSystem>()->Delete(store->fileName_);
+        URHO3D_LOGWARNING("Could not write program binary " + store->fileName_);
+    }
+
+    jobs_.Remove(store);
+    delete store;
+    item->aux_ = nullptr;
+}
+
+}
@@ -0,0 +1,111 @@
+//
+// Copyright (c) 2008-2019 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../../Core/Object.h"
+
+namespace Urho3D
+{
+
+class ShaderProgram;
+class ShaderVariation;
+
+/// Linked shader programs saved to disk with glGetProgramBinary and restored with glProgramBinary on later runs
+/// (OpenGL 4.1 or GL_ARB_get_program_binary, not on OpenGL ES 2 or WebGL). A binary is keyed by the hash of both shader
+/// sources, their defines, the GL3 path and the driver (vendor, renderer, version), so an edited shader or an updated
+/// driver simply misses. Register it as a subsystem: Graphics::SetShaders() then does not compile the shaders of a pair that
+/// has a binary, ShaderProgram::Link() restores the program from it instead of linking, and queues the programs it does
+/// link. The shaders are compiled only when the driver rejects the binary. Queued binaries are read back at E_ENDFRAME and written to disk on a
+/// WorkQueue thread, so nothing is read back or written inside the link.
+class URHO3D_API ProgramBinaryCache : public Object
+{
+    URHO3D_OBJECT(ProgramBinaryCache, Object);
+
+public:
+    /// Construct with the directory binaries are kept in, created when missing.
+    ProgramBinaryCache(Context* context, const String& directory);
+    /// Destruct. Finishes the file writes in progress.
+    ~ProgramBinaryCache() override;
+
+    /// Return whether the driver can return binaries. Needs the graphics context.
+    bool IsSupported() const;
+    /// Return the file name for a shader pair.
+    String GetKey(ShaderVariation* vs, ShaderVariation* ps) const;
+    /// Return whether a binary is stored for a shader pair. Only checks that the file exists.
+    bool HasBinary(ShaderVariation* vs, ShaderVariation* ps) const;
+    /// Load the binary of a shader pair into a program object without a link. Return false on a miss, or when the driver
+    /// rejects the binary; a rejected file is deleted and stored again after the normal link.
+    bool Restore(unsigned program, ShaderVariation* vs, ShaderVariation* ps);
+    /// Queue a program linked from source to be saved after the frame. linkTime is its link time in microseconds, for the
+    /// statistics.
+    void QueueStore(ShaderProgram* program, long long linkTime);
+
+    /// Return the directory.
+    const String& GetDirectory() const { return directory_; }
+    /// Return number of programs restored from disk.
+    unsigned GetNumRestored() const { return numRestored_; }
+    /// Return number of binaries the driver rejected.
+    unsigned GetNumRejected() const { return numRejected_; }
+    /// Return number of binaries written.
+    unsigned GetNumStored() const { return numStored_; }
+    /// Return number of binaries queued or being written.
+    unsigned GetNumPending() const { return pendingStores_.Size() + jobs_.Size(); }
+    /// Return microseconds spent linking the stored programs (cold) and restoring programs (warm).
+    long long GetLinkTime() const { return linkTime_; }
+    long long GetRestoreTime() const { return restoreTime_; }
+
+private:
+    /// A program waiting for its binary to be read back.
+    struct PendingStore
+    {
+        WeakPtr<ShaderProgram> program_;
+        long long linkTime_;
+    };
+
+    /// Return the driver part of the key, queried once.
+    const String& GetDriverString() const;
+    /// Read back the queued binaries and hand them to the WorkQueue.
+    void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+    /// Count a finished file write.
+    void HandleWorkItemCompleted(StringHash eventType, VariantMap& eventData);
+
+    /// Cache directory with a trailing slash.
+    String directory_;
+    /// Vendor, renderer, version and GL3 flag.
+    mutable String driver_;
+    /// Whether the driver returns binaries; -1 until queried.
+    mutable int supported_{-1};
+    /// Programs waiting for the end of the frame.
+    Vector<PendingStore> pendingStores_;
+    /// File writes handed to the WorkQueue.
+    PODVector<void*> jobs_;
+    /// Statistics.
+    unsigned numRestored_{};
+    unsigned numRejected_{};
+    unsigned numStored_{};
+    long long linkTime_{};
+    long long restoreTime_{};
+};
+
+}
@@ -0,0 +1,43 @@
+//
+// Copyright (c) 2008-2019 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../../Container/Ptr.h"
+
+namespace Urho3D
+{
+
+class Graphics;
+class ShaderProgram;
+class ShaderVariation;
+
+/// Return whether GL_KHR_parallel_shader_compile (or the ARB version) was enabled with the graphics context. When it is,
+/// ShaderVariation::Create() does not wait for the compile status and ShaderProgram::IsLinkComplete() polls
+/// GL_COMPLETION_STATUS_KHR. Never enabled on OpenGL ES.
+URHO3D_API bool IsParallelShaderCompileEnabled();
+/// Compile a shader pair if needed and start linking it without waiting for the driver. The first Graphics::SetShaders()
+/// with the pair finishes the link and takes the program into its cache, waiting only for what the driver has not done
+/// yet. Return null when a shader failed to compile or the program could not be created.
+URHO3D_API SharedPtr<ShaderProgram> BeginShaderProgram(Graphics* graphics, ShaderVariation* vs, ShaderVariation* ps);
+
+}
@@ -0,0 +1,440 @@
+//
+// Copyright (c) 2008-2019 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../../Precompiled.h"
+
+#include "../../Core/Context.h"
+#include "../../Core/CoreEvents.h"
+#include "../../Core/Profiler.h"
+#include "../../Graphics/Graphics.h"
+#include "../../Graphics/GraphicsEvents.h"
+#include "../../Graphics/GraphicsImpl.h"
+#include "../../Graphics/Texture2D.h"
+#include "../../Graphics/TextureCube.h"
+#include "../../Graphics/OpenGL/OGLTextureReadback.h"
+#include "../../IO/Log.h"
+
+#include "../../DebugNew.h"
+
+namespace Urho3D
+{
+
+TextureReadback::TextureReadback(Context* context) :
+    Object(context),
+    readFBO_(0),
+    nextId_(1)
+{
+    SubscribeToEvent(E_ENDRENDERING, URHO3D_HANDLER(TextureReadback, HandleEndRendering));
+    SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(TextureReadback, HandleBeginFrame));
+    SubscribeToEvent(E_DEVICELOST, URHO3D_HANDLER(TextureReadback, HandleDeviceLost));
+}
+
+TextureReadback::~TextureReadback()
+{
+    for (unsigned i = 0; i < inFlight_.Size(); ++i)
+        ReleaseRequest(inFlight_[i]);
+    inFlight_.Clear();
+    queued_.Clear();
+
+#ifndef GL_ES_VERSION_2_0
+    auto* graphics = GetSubsystem<Graphics>();
+    if (graphics && !graphics->IsDeviceLost())
+    {
+        for (unsigned i = 0; i < freeBuffers_.Size(); ++i)
+            glDeleteBuffers(1, &freeBuffers_[i].first_);
+        if (readFBO_)
+            glDeleteFramebuffers(1, &readFBO_);
+    }
+#endif
+}
+
+unsigned TextureReadback::Request(Texture2D* texture, const TextureReadbackCallback& callback, unsigned level)
+{
+    if (!texture)
+    {
+        URHO3D_LOGERROR("Null texture for readback");
+        return 0;
+    }
+
+    return Queue(texture, GL_TEXTURE_2D, FACE_POSITIVE_X, level, callback);
+}
+
+unsigned TextureReadback::Request(TextureCube* texture, CubeMapFace face, const TextureReadbackCallback& callback, unsigned level)
+{
+    if (!texture)
+    {
+        URHO3D_LOGERROR("Null texture for readback");
+        return 0;
+    }
+    if (face >= MAX_CUBEMAP_FACES)
+    {
+        URHO3D_LOGERROR("Illegal cube map face for readback");
+        return 0;
+    }
+
+    return Queue(texture, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, face, level, callback);
+}
+
+unsigned TextureReadback::RequestBackbuffer(const TextureReadbackCallback& callback)
+{
+    auto* graphics = GetSubsystem<Graphics>();
+    if (!graphics || !graphics->IsInitialized())
+    {
+        URHO3D_LOGERROR("No backbuffer for readback");
+        return 0;
+    }
+
+    ReadbackRequest request;
+    request.id_ = nextId_++;
+    if (!nextId_)
+        nextId_ = 1;
+    request.target_ = 0;
+    request.face_ = FACE_POSITIVE_X;
+    request.level_ = 0;
+    request.width_ = graphics->GetWidth();
+    request.height_ = graphics->GetHeight();
+    request.components_ = 3;
+    request.buffer_ = 0;
+    request.fence_ = nullptr;
+    request.callback_ = callback;
+    queued_.Push(request);
+
+    return request.id_;
+}
+
+void TextureReadback::Cancel(unsigned id)
+{
+    for (Vector<ReadbackRequest>::Iterator i = queued_.Begin(); i != queued_.End(); ++i)
+    {
+        if (i->id_ == id)
+        {
+            queued_.Erase(i);
+            return;
+        }
+    }
+
+    for (Vector<ReadbackRequest>::Iterator i = inFlight_.Begin(); i != inFlight_.End(); ++i)
+    {
+        if (i->id_ == id)
+        {
+            ReleaseRequest(*i);
+            inFlight_.Erase(i);
+            return;
+        }
+    }
+}
+
+void TextureReadback::Update()
+{
+    if (inFlight_.Empty())
+        return;
+
+    URHO3D_PROFILE(DeliverTextureReadbacks);
+
+    // Collect finished requests first, as the callbacks are free to queue new requests
+    Vector<ReadbackRequest> finished;
+
+    for (unsigned i = 0; i < inFlight_.Size();)
+    {
+        ReadbackRequest& request = inFlight_[i];
+
+#ifndef GL_ES_VERSION_2_0
+        if (request.fence_)
+        {
+            GLenum status = glClientWaitSync((GLsync)request.fence_, 0, 0);
+            if (status == GL_TIMEOUT_EXPIRED)
+            {
+                ++i;
+                continue;
+            }
+
+            if (status != GL_WAIT_FAILED)
+            {
+                unsigned size = (unsigned)(request.width_ * request.height_ * request.components_);
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, request.buffer_);
+                void* src = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+                if (src)
+                {
+                    CopyMapped(request, static_cast<const unsigned char*>(src));
+                    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                }
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            }
+        }
+#endif
+
+        ReleaseRequest(request);
+        finished.Push(request);
+        inFlight_.Erase(i);
+    }
+
+    for (unsigned i = 0; i < finished.Size(); ++i)
+    {
+        if (!finished[i].image_)
+            URHO3D_LOGWARNING("Texture readback " + String(finished[i].id_) + " failed");
+        if (finished[i].callback_)
+            finished[i].callback_(finished[i].image_);
+    }
+}
+
+unsigned TextureReadback::Queue(Texture* texture, unsigned target, CubeMapFace face, unsigned level,
+    const TextureReadbackCallback& callback)
+{
+    if (level >= texture->GetLevels())
+    {
+        URHO3D_LOGERROR("Illegal mip level for readback");
+        return 0;
+    }
+
+    ReadbackRequest request;
+    request.id_ = nextId_++;
+    if (!nextId_)
+        nextId_ = 1;
+    request.texture_ = texture;
+    request.target_ = target;
+    request.face_ = face;
+    request.level_ = level;
+    request.width_ = texture->GetLevelWidth(level);
+    request.height_ = texture->GetLevelHeight(level);
+    request.components_ = 4;
+    request.buffer_ = 0;
+    request.fence_ = nullptr;
+    request.callback_ = callback;
+    queued_.Push(request);
+
+    return request.id_;
+}
+
+void TextureReadback::IssueReads()
+{
+    if (queued_.Empty())
+        return;
+
+    auto* graphics = GetSubsystem<Graphics>();
+    if (!graphics || graphics->IsDeviceLost())
+        return;
+
+    URHO3D_PROFILE(IssueTextureReadbacks);
+
+#ifndef GL_ES_VERSION_2_0
+    if (Graphics::GetGL3Support())
+    {
+        if (!readFBO_)
+            glGenFramebuffers(1, &readFBO_);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, readFBO_);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+        for (unsigned i = 0; i < queued_.Size(); ++i)
+        {
+            ReadbackRequest& request = queued_[i];
+            Texture* texture = request.texture_;
+            if (!request.target_)
+            {
+                request.buffer_ = AcquireBuffer((unsigned)(request.width_ * request.height_ * 3));
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, graphics->GetImpl()->systemFBO_);
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, request.buffer_);
+                glReadPixels(0, 0, request.width_, request.height_, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+                request.fence_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, readFBO_);
+            }
+            else if (texture && texture->GetGPUObjectName())
+            {
+                // Multisampled rendertargets must be resolved before they can be attached for reading
+                if (texture->IsResolveDirty())
+                {
+                    if (texture->GetType() == TextureCube::GetTypeStatic())
+                        graphics->ResolveToTexture(static_cast<TextureCube*>(texture));
+                    else
+                        graphics->ResolveToTexture(static_cast<Texture2D*>(texture));
+                    glBindFramebuffer(GL_READ_FRAMEBUFFER, readFBO_);
+                }
+
+                request.buffer_ = AcquireBuffer((unsigned)(request.width_ * request.height_ * 4));
+                glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, request.target_, texture->GetGPUObjectName(),
+                    request.level_);
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, request.buffer_);
+                glReadPixels(0, 0, request.width_, request.height_, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+                request.fence_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            }
+
+            inFlight_.Push(request);
+        }
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+        // Graphics binds its framebuffers to both targets, so restore the read binding it expects
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, graphics->GetImpl()->boundFBO_);
+        queued_.Clear();
+        return;
+    }
+#endif
+
+    for (unsigned i = 0; i < queued_.Size(); ++i)
+    {
+        ReadImmediate(queued_[i]);
+        inFlight_.Push(queued_[i]);
+    }
+    queued_.Clear();
+}
+
+void TextureReadback::ReadImmediate(ReadbackRequest& request)
+{
+    if (!request.target_)
+    {
+        // Blocking path, same as Graphics::TakeScreenShot()
+        SharedPtr<Image> image(new Image(context_));
+        if (GetSubsystem<Graphics>()->TakeScreenShot(*image))
+            request.image_ = image;
+        return;
+    }
+
+    Texture* texture = request.texture_;
+    if (!texture)
+        return;
+
+    unsigned format = texture->GetFormat();
+    unsigned components;
+    if (format == Graphics::GetRGBAFormat())
+        components = 4;
+    else if (format == Graphics::GetRGBFormat())
+        components = 3;
+    else
+    {
+        URHO3D_LOGERROR("Texture readback without OpenGL 3 supports only RGB and RGBA textures");
+        return;
+    }
+
+    SharedPtr<Image> image(new Image(context_));
+    image->SetSize(request.width_, request.height_, components);
+
+    bool success;
+    if (texture->GetType() == TextureCube::GetTypeStatic())
+        success = static_cast<TextureCube*>(texture)->GetData(request.face_, request.level_, image->GetData());
+    else
+        success = static_cast<Texture2D*>(texture)->GetData(request.level_, image->GetData());
+
+    if (success)
+        request.image_ = image;
+}
+
+void TextureReadback::CopyMapped(ReadbackRequest& request, const unsigned char* src)
+{
+    request.image_ = new Image(context_);
+    request.image_->SetSize(request.width_, request.height_, request.components_);
+    unsigned char* dest = request.image_->GetData();
+    unsigned rowSize = (unsigned)request.width_ * request.components_;
+
+    if (request.target_)
+    {
+        memcpy(dest, src, rowSize * request.height_);
+        return;
+    }
+
+    // The backbuffer is read bottom-up. Flip while copying instead of a separate pass over the image
+    for (int y = 0; y < request.height_; ++y)
+        memcpy(dest + (request.height_ - 1 - y) * rowSize, src + y * rowSize, rowSize);
+}
+
+unsigned TextureReadback::AcquireBuffer(unsigned size)
+{
+    unsigned buffer = 0;
+
+#ifndef GL_ES_VERSION_2_0
+    for (unsigned i = 0; i < freeBuffers_.Size(); ++i)
+    {
+        if (freeBuffers_[i].second_ >= size)
+        {
+            buffer = freeBuffers_[i].first_;
+            size = freeBuffers_[i].second_;
+            freeBuffers_.EraseSwap(i);
+            break;
+        }
+    }
+
+    if (!buffer)
+    {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    }
+
+    bufferSizes_[buffer] = size;
+#endif
+
+    return buffer;
+}
+
+void TextureReadback::ReleaseBuffer(unsigned buffer)
+{
+    HashMap<unsigned, unsigned>::Iterator i = bufferSizes_.Find(buffer);
+    if (i == bufferSizes_.End())
+        return;
+
+    freeBuffers_.Push(MakePair(buffer, i->second_));
+    bufferSizes_.Erase(i);
+}
+
+void TextureReadback::ReleaseRequest(ReadbackRequest& request)
+{
+#ifndef GL_ES_VERSION_2_0
+    if (request.fence_)
+    {
+        auto* graphics = GetSubsystem<Graphics>();
+        if (graphics && !graphics->IsDeviceLost())
+            glDeleteSync((GLsync)request.fence_);
+        request.fence_ = nullptr;
+    }
+#endif
+
+    if (request.buffer_)
+    {
+        ReleaseBuffer(request.buffer_);
+        request.buffer_ = 0;
+    }
+}
+
+void TextureReadback::HandleEndRendering(StringHash eventType, VariantMap& eventData)
+{
+    IssueReads();
+}
+
+void TextureReadback::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+    Update();
+}
+
+void TextureReadback::HandleDeviceLost(StringHash eventType, VariantMap& eventData)
+{
+    // The context is gone along with the fences and buffers. Fail the requests in flight on the next update
+    for (unsigned i = 0; i < inFlight_.Size(); ++i)
+    {
+        inFlight_[i].fence_ = nullptr;
+        inFlight_[i].buffer_ = 0;
+    }
+
+    freeBuffers_.Clear();
+    bufferSizes_.Clear();
+    readFBO_ = 0;
+}
+
+}
@@ -0,0 +1,136 @@
+//
+// Copyright (c) 2008-2019 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../../Container/Ptr.h"
+#include "../../Core/Object.h"
+#include "../../Graphics/GraphicsDefs.h"
+#include "../../Resource/Image.h"
+
+#include <functional>
+
+namespace Urho3D
+{
+
+class Texture;
+class Texture2D;
+class TextureCube;
+
+/// Texture readback completion callback. The image is null if the readback failed.
+using TextureReadbackCallback = std::function<void(Image* image)>;
+
+/// Non-blocking texture readback through pixel pack buffers and fences. Reads are issued at the end of rendering, so the
+/// result reflects everything rendered in the frame of the request, and are delivered on a later frame once the fence has
+/// passed. Without OpenGL 3 the data is read synchronously and still delivered on the next frame.
+class URHO3D_API TextureReadback : public Object
+{
+    URHO3D_OBJECT(TextureReadback, Object);
+
+public:
+    /// Construct.
+    explicit TextureReadback(Context* context);
+    /// Destruct. Pending requests are dropped without calling their callbacks.
+    ~TextureReadback() override;
+
+    /// Request readback of a 2D texture mip level as RGBA. Return a request id, or 0 on failure.
+    unsigned Request(Texture2D* texture, const TextureReadbackCallback& callback, unsigned level = 0);
+    /// Request readback of a cube map face mip level as RGBA. Return a request id, or 0 on failure.
+    unsigned Request(TextureCube* texture, CubeMapFace face, const TextureReadbackCallback& callback, unsigned level = 0);
+    /// Request readback of the backbuffer as RGB at the end of this frame's rendering. Rows are flipped to top-down order
+    /// while copying out of the pixel pack buffer. Return a request id, or 0 on failure.
+    unsigned RequestBackbuffer(const TextureReadbackCallback& callback);
+    /// Cancel a request. Its callback will not be called.
+    void Cancel(unsigned id);
+    /// Deliver all finished requests. Called automatically at the beginning of each frame.
+    void Update();
+
+    /// Return number of requests not yet delivered.
+    unsigned GetNumPending() const { return queued_.Size() + inFlight_.Size(); }
+
+private:
+    /// Readback request.
+    struct ReadbackRequest
+    {
+        /// Request id.
+        unsigned id_;
+        /// Source texture.
+        WeakPtr<Texture> texture_;
+        /// OpenGL texture target, a cube face target for cube maps, or 0 for the backbuffer.
+        unsigned target_;
+        /// Cube map face, or 0 for 2D textures.
+        CubeMapFace face_;
+        /// Mip level.
+        unsigned level_;
+        /// Width of the mip level.
+        int width_;
+        /// Height of the mip level.
+        int height_;
+        /// Components per pixel, 4 for textures and 3 for the backbuffer.
+        unsigned components_;
+        /// Pixel pack buffer.
+        unsigned buffer_;
+        /// Fence after the read, or null.
+        void* fence_;
+        /// Synchronously read result when pixel pack buffers are not available.
+        SharedPtr<Image> image_;
+        /// Completion callback.
+        TextureReadbackCallback callback_;
+    };
+
+    /// Queue a validated request.
+    unsigned Queue(Texture* texture, unsigned target, CubeMapFace face, unsigned level, const TextureReadbackCallback& callback);
+    /// Issue the reads of the queued requests.
+    void IssueReads();
+    /// Read a request synchronously when pixel pack buffers are not available.
+    void ReadImmediate(ReadbackRequest& request);
+    /// Copy a mapped pixel pack buffer to the request's image.
+    void CopyMapped(ReadbackRequest& request, const unsigned char* src);
+    /// Return a pixel pack buffer of at least the given size.
+    unsigned AcquireBuffer(unsigned size);
+    /// Return a pixel pack buffer to the free list.
+    void ReleaseBuffer(unsigned buffer);
+    /// Release the fence and buffer of a request.
+    void ReleaseRequest(ReadbackRequest& request);
+    /// Handle end of rendering: issue reads.
+    void HandleEndRendering(StringHash eventType, VariantMap& eventData);
+    /// Handle beginning of frame: deliver results.
+    void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+    /// Handle device loss: the GL objects are gone, fail everything in flight.
+    void HandleDeviceLost(StringHash eventType, VariantMap& eventData);
+
+    /// Requests waiting for the end of rendering.
+    Vector<ReadbackRequest> queued_;
+    /// Requests read and waiting for their fence.
+    Vector<ReadbackRequest> inFlight_;
+    /// Free pixel pack buffers as (object, size) pairs.
+    PODVector<Pair<unsigned, unsigned> > freeBuffers_;
+    /// Sizes of buffers in use.
+    HashMap<unsigned, unsigned> bufferSizes_;
+    /// Framebuffer used as the read source.
+    unsigned readFBO_;
+    /// Next request id.
+    unsigned nextId_;
+};
+
+}
@@ -0,0 +1,259 @@
+//
+// Copyright (c) 2008-2019 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../../Precompiled.h"
+
+#include "../../Core/Context.h"
+#include "../../Core/Profiler.h"
+#include "../../Graphics/Graphics.h"
+#include "../../Graphics/GraphicsEvents.h"
+#include "../../Graphics/GraphicsImpl.h"
+#include "../../Graphics/Texture2D.h"
+#include "../../Graphics/TextureCube.h"
+#include "../../Graphics/OpenGL/OGLTextureUploader.h"
+#include "../../IO/Log.h"
+
+#include "../../DebugNew.h"
+
+namespace Urho3D
+{
+
+TextureUploader::TextureUploader(Context* context) :
+    Object(context),
+    nextHandle_(1)
+{
+    SubscribeToEvent(E_DEVICELOST, URHO3D_HANDLER(TextureUploader, HandleDeviceLost));
+}
+
+TextureUploader::~TextureUploader()
+{
+    for (HashMap<unsigned, MappedUpload>::Iterator i = mapped_.Begin(); i != mapped_.End(); ++i)
+        Unmap(i->second_);
+    mapped_.Clear();
+
+#ifndef GL_ES_VERSION_2_0
+    auto* graphics = GetSubsystem<Graphics>();
+    if (graphics && !graphics->IsDeviceLost())
+    {
+        for (unsigned i = 0; i < freeBuffers_.Size(); ++i)
+            glDeleteBuffers(1, &freeBuffers_[i].first_);
+    }
+#endif
+    freeBuffers_.Clear();
+}
+
+unsigned TextureUploader::Map(unsigned size)
+{
+    auto* graphics = GetSubsystem<Graphics>();
+    if (!size || !graphics || graphics->IsDeviceLost())
+        return 0;
+
+    MappedUpload upload;
+    upload.buffer_ = 0;
+    upload.size_ = size;
+    upload.data_ = nullptr;
+
+#ifndef GL_ES_VERSION_2_0
+    if (Graphics::GetGL3Support())
+    {
+        URHO3D_PROFILE(MapUploadBuffer);
+
+        for (unsigned i = 0; i < freeBuffers_.Size(); ++i)
+        {
+            if (freeBuffers_[i].second_ >= size)
+            {
+                upload.buffer_ = freeBuffers_[i].first_;
+                upload.size_ = freeBuffers_[i].second_;
+                freeBuffers_.EraseSwap(i);
+                break;
+            }
+        }
+
+        if (!upload.buffer_)
+        {
+            glGenBuffers(1, &upload.buffer_);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.buffer_);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        }
+        else
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.buffer_);
+
+        // Invalidate so that the driver can orphan a buffer that an earlier transfer is still reading from
+        upload.data_ = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        if (!upload.data_)
+        {
+            URHO3D_LOGERROR("Failed to map pixel unpack buffer");
+            freeBuffers_.Push(MakePair(upload.buffer_, upload.size_));
+            return 0;
+        }
+    }
+    else
+#endif
+    {
+        upload.staging_ = new unsigned char[size];
+        upload.data_ = upload.staging_.Get();
+    }
+
+    unsigned handle = nextHandle_++;
+    if (!nextHandle_)
+        nextHandle_ = 1;
+    mapped_[handle] = upload;
+    return handle;
+}
+
+unsigned char* TextureUploader::GetData(unsigned handle) const
+{
+    HashMap<unsigned, MappedUpload>::ConstIterator i = mapped_.Find(handle);
+    return i != mapped_.End() ? i->second_.data_ : nullptr;
+}
+
+bool TextureUploader::Upload(unsigned handle, Texture2D* texture, unsigned level)
+{
+    return Transfer(handle, texture, GL_TEXTURE_2D, FACE_POSITIVE_X, level);
+}
+
+bool TextureUploader::Upload(unsigned handle, TextureCube* texture, CubeMapFace face, unsigned level)
+{
+    if (face >= MAX_CUBEMAP_FACES)
+    {
+        URHO3D_LOGERROR("Illegal cube map face for upload");
+        Abort(handle);
+        return false;
+    }
+
+    return Transfer(handle, texture, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, face, level);
+}
+
+void TextureUploader::Abort(unsigned handle)
+{
+    HashMap<unsigned, MappedUpload>::Iterator i = mapped_.Find(handle);
+    if (i == mapped_.End())
+        return;
+
+    Unmap(i->second_);
+    mapped_.Erase(i);
+}
+
+bool TextureUploader::Transfer(unsigned handle, Texture* texture, unsigned target, CubeMapFace face, unsigned level)
+{
+    HashMap<unsigned, MappedUpload>::Iterator i = mapped_.Find(handle);
+    if (i == mapped_.End())
+    {
+        URHO3D_LOGERROR("Unknown texture upload handle");
+        return false;
+    }
+
+    MappedUpload upload = i->second_;
+    mapped_.Erase(i);
+
+    if (!upload.data_)
+    {
+        URHO3D_LOGERROR("Texture upload was lost with the device");
+        return false;
+    }
+
+    if (!texture || !texture->GetGPUObjectName() || level >= texture->GetLevels() ||
+        texture->GetFormat() != Graphics::GetRGBAFormat())
+    {
+        URHO3D_LOGERROR("Texture upload needs an existing RGBA texture and mip level");
+        Unmap(upload);
+        return false;
+    }
+
+    int width = texture->GetLevelWidth(level);
+    int height = texture->GetLevelHeight(level);
+    if ((unsigned)(width * height * 4) > upload.size_)
+    {
+        URHO3D_LOGERROR("Texture upload is smaller than the mip level");
+        Unmap(upload);
+        return false;
+    }
+
+    URHO3D_PROFILE(UploadTexture);
+
+    if (!upload.buffer_)
+    {
+        bool success;
+        if (target == GL_TEXTURE_2D)
+            success = static_cast<Texture2D*>(texture)->SetData(level, 0, 0, width, height, upload.data_);
+        else
+            success = static_cast<TextureCube*>(texture)->SetData(face, level, 0, 0, width, height, upload.data_);
+        return success;
+    }
+
+#ifndef GL_ES_VERSION_2_0
+    auto* graphics = GetSubsystem<Graphics>();
+    graphics->SetTextureForUpdate(texture);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.buffer_);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    // With an unpack buffer bound the data pointer is an offset into it, and the copy is performed by the GPU
+    glTexSubImage2D(target, level, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    graphics->SetTexture(0, nullptr);
+
+    freeBuffers_.Push(MakePair(upload.buffer_, upload.size_));
+#endif
+
+    return true;
+}
+
+void TextureUploader::Unmap(MappedUpload& upload)
+{
+#ifndef GL_ES_VERSION_2_0
+    if (upload.buffer_)
+    {
+        auto* graphics = GetSubsystem<Graphics>();
+        if (graphics && !graphics->IsDeviceLost())
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.buffer_);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            freeBuffers_.Push(MakePair(upload.buffer_, upload.size_));
+        }
+    }
+#endif
+
+    upload.buffer_ = 0;
+    upload.data_ = nullptr;
+    upload.staging_.Reset();
+}
+
+void TextureUploader::HandleDeviceLost(StringHash eventType, VariantMap& eventData)
+{
+    // Buffers went away with the context. Mapped handles stay known so that Upload() fails cleanly
+    for (HashMap<unsigned, MappedUpload>::Iterator i = mapped_.Begin(); i != mapped_.End(); ++i)
+    {
+        if (i->second_.buffer_)
+        {
+            i->second_.buffer_ = 0;
+            i->second_.data_ = nullptr;
+        }
+    }
+
+    freeBuffers_.Clear();
+}
+
+}
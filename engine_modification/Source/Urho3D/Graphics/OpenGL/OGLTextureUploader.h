@@ -0,0 +1,95 @@
+//
+// Copyright (c) 2008-2019 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../../Container/ArrayPtr.h"
+#include "../../Container/HashMap.h"
+#include "../../Core/Object.h"
+#include "../../Graphics/GraphicsDefs.h"
+
+namespace Urho3D
+{
+
+class Texture;
+class Texture2D;
+class TextureCube;
+
+/// Texture upload through pixel unpack buffers. Map() returns memory that any thread may fill, and Upload() on the main
+/// thread unmaps it and starts the transfer, which the GPU performs asynchronously. Data must be RGBA with 8 bits per
+/// component. Without OpenGL 3 the memory is a CPU staging buffer and Upload() falls back to Texture SetData().
+/// Mapped memory is invalidated by device loss, so do not keep writing to it across a screen mode change.
+class URHO3D_API TextureUploader : public Object
+{
+    URHO3D_OBJECT(TextureUploader, Object);
+
+public:
+    /// Construct.
+    explicit TextureUploader(Context* context);
+    /// Destruct. Mapped uploads are aborted.
+    ~TextureUploader() override;
+
+    /// Map memory for an upload of the given size in bytes. Return a handle, or 0 on failure.
+    unsigned Map(unsigned size);
+    /// Return the writable memory of a mapped upload, or null if the handle is not mapped.
+    unsigned char* GetData(unsigned handle) const;
+    /// Unmap and transfer to a 2D texture mip level. Return true on success.
+    bool Upload(unsigned handle, Texture2D* texture, unsigned level = 0);
+    /// Unmap and transfer to a cube map face mip level. Return true on success.
+    bool Upload(unsigned handle, TextureCube* texture, CubeMapFace face, unsigned level = 0);
+    /// Unmap without transferring.
+    void Abort(unsigned handle);
+
+    /// Return number of mapped uploads.
+    unsigned GetNumMapped() const { return mapped_.Size(); }
+
+private:
+    /// Mapped upload.
+    struct MappedUpload
+    {
+        /// Pixel unpack buffer, or 0 when using a staging buffer.
+        unsigned buffer_;
+        /// Size in bytes.
+        unsigned size_;
+        /// Writable memory.
+        unsigned char* data_;
+        /// CPU staging buffer when pixel unpack buffers are not available.
+        SharedArrayPtr<unsigned char> staging_;
+    };
+
+    /// Unmap an upload and transfer it to a texture target. Return true on success.
+    bool Transfer(unsigned handle, Texture* texture, unsigned target, CubeMapFace face, unsigned level);
+    /// Unmap the buffer of an upload and return it to the free list.
+    void Unmap(MappedUpload& upload);
+    /// Handle device loss: the buffers are gone.
+    void HandleDeviceLost(StringHash eventType, VariantMap& eventData);
+
+    /// Mapped uploads by handle.
+    HashMap<unsigned, MappedUpload> mapped_;
+    /// Free pixel unpack buffers as (object, size) pairs.
+    PODVector<Pair<unsigned, unsigned> > freeBuffers_;
+    /// Next handle.
+    unsigned nextHandle_;
+};
+
+}
@@ -0,0 +1,71 @@
+//
+// Copyright (c) 2008-2019 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../../Urho3D.h"
+
+namespace Urho3D
+{
+
+class ConstantBuffer;
+class Graphics;
+
+/// Constant buffer streaming through the uniform ring during one frame.
+struct UniformRingStats
+{
+    /// Constant buffer copies written to the ring, and their bytes.
+    unsigned copies_{};
+    unsigned bytes_{};
+    /// glBindBufferRange calls.
+    unsigned rangeBinds_{};
+    /// Binding points examined before draws: only those whose buffer changed, was rebound or went stale.
+    unsigned slotChecks_{};
+    /// Parameter sets skipped because the buffer already held the value.
+    unsigned unchangedSets_{};
+    /// Allocations that had to wait for the GPU to finish reading the space they reuse.
+    unsigned waits_{};
+};
+
+/// Enable or disable the uniform ring of the GL3 path. Enabled by default, takes effect at the next BeginFrame. With it,
+/// constant buffer contents are kept on the CPU and each changed buffer is copied to one shared ring buffer before a
+/// draw and bound with glBindBufferRange, instead of re-uploading its own buffer object with glBufferData. The ring is
+/// persistently mapped when ARB_buffer_storage is available, otherwise written with glBufferSubData; space is reused
+/// only after a fence shows the GPU is done with it. Has no effect on GL2 and OpenGL ES.
+URHO3D_API void SetUniformRingEnabled(bool enable);
+/// Return whether the uniform ring is enabled.
+URHO3D_API bool IsUniformRingEnabled();
+/// Return whether the uniform ring is in use, and whether it is persistently mapped.
+URHO3D_API bool IsUniformRingActive();
+URHO3D_API bool IsUniformRingPersistent();
+/// Set the ring size in bytes, 4 MB by default. Applies when the ring is next created.
+URHO3D_API void SetUniformRingSize(unsigned size);
+/// Return the counters of the last finished frame.
+URHO3D_API const UniformRingStats& GetUniformRingStats();
+
+/// Set part of a constant buffer, through the ring when it is in use. Used instead of ConstantBuffer::SetParameter.
+URHO3D_API void SetConstantBufferParameter(Graphics* graphics, ConstantBuffer* buffer, unsigned offset, unsigned size, const void* data);
+/// Set rows of 3 floats padded to 4, like ConstantBuffer::SetVector3ArrayParameter.
+URHO3D_API void SetConstantBufferVector3Array(Graphics* graphics, ConstantBuffer* buffer, unsigned offset, unsigned rows, const void* data);
+
+}
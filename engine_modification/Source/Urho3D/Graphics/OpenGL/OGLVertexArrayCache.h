@@ -0,0 +1,54 @@
+//
+// Copyright (c) 2008-2019 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../../Urho3D.h"
+
+namespace Urho3D
+{
+
+/// Vertex attribute setup of the OpenGL renderer during one frame.
+struct VertexArrayStats
+{
+    /// glEnableVertexAttribArray, glDisableVertexAttribArray, glVertexAttribPointer and divisor calls.
+    unsigned attributeCalls_{};
+    /// Vertex buffer set or shader layout changes that found their vertex array object in the cache.
+    unsigned cacheHits_{};
+    /// Vertex array objects bound, and created.
+    unsigned vaoBinds_{};
+    unsigned vaoCreated_{};
+    /// Vertex array objects alive at the end of the frame.
+    unsigned numCached_{};
+};
+
+/// Enable or disable the vertex array object cache of the GL3 path. Enabled by default. With it, each combination of
+/// shader attribute layout, vertex buffers and instance offset gets its own vertex array object, so switching back to
+/// it is a single glBindVertexArray instead of re-specifying every attribute. Has no effect on GL2 and OpenGL ES.
+URHO3D_API void SetVertexArrayCacheEnabled(bool enable);
+/// Return whether the vertex array object cache is enabled.
+URHO3D_API bool IsVertexArrayCacheEnabled();
+/// Return the counters of the last finished frame.
+URHO3D_API const VertexArrayStats& GetVertexArrayStats();
+
+}
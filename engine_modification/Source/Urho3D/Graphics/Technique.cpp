@@ -23,15 +23,20 @@
 #include "../Precompiled.h"
 
 #include "../Core/Context.h"
+#include "../Core/Mutex.h"
 #include "../Core/ProcessUtils.h"
 #include "../Core/Profiler.h"
 #include "../Graphics/Graphics.h"
 #include "../Graphics/Technique.h"
 #include "../Graphics/ShaderVariation.h"
 #include "../IO/Log.h"
+#include "../Math/ConstStringHash.h"
 #include "../Resource/ResourceCache.h"
 #include "../Resource/XMLFile.h"
 
+#include <atomic>
+#include <memory>
+
 #include "../DebugNew.h"
 
 namespace Urho3D
@@ -227,16 +232,134 @@ Vector<SharedPtr<ShaderVariation> >& Pass::GetPixelShaders(const StringHash& ext
         return extraPixelShaders_[extraDefinesHash];
 }
 
+/// Built-in pass name with its StringHash, computed at compile time.
+struct BuiltinPassName
+{
+    const char* name_;
+    unsigned hash_;
+};
+
+/// Built-in passes, in index order. Their indices are valid before the first GetPassIndex() call.
+static constexpr BuiltinPassName builtinPassNames[] =
+{
+    {"base", ConstStringHashValue("base")},
+    {"alpha", ConstStringHashValue("alpha")},
+    {"material", ConstStringHashValue("material")},
+    {"deferred", ConstStringHashValue("deferred")},
+    {"light", ConstStringHashValue("light")},
+    {"litbase", ConstStringHashValue("litbase")},
+    {"litalpha", ConstStringHashValue("litalpha")},
+    {"shadow", ConstStringHashValue("shadow")}
+};
+
 unsigned Technique::basePassIndex = 0;
-unsigned Technique::alphaPassIndex = 0;
-unsigned Technique::materialPassIndex = 0;
-unsigned Technique::deferredPassIndex = 0;
-unsigned Technique::lightPassIndex = 0;
-unsigned Technique::litBasePassIndex = 0;
-unsigned Technique::litAlphaPassIndex = 0;
-unsigned Technique::shadowPassIndex = 0;
+unsigned Technique::alphaPassIndex = 1;
+unsigned Technique::materialPassIndex = 2;
+unsigned Technique::deferredPassIndex = 3;
+unsigned Technique::lightPassIndex = 4;
+unsigned Technique::litBasePassIndex = 5;
+unsigned Technique::litAlphaPassIndex = 6;
+unsigned Technique::shadowPassIndex = 7;
+
+/// Initial capacity of the pass name registry, a power of two.
+static const unsigned MIN_PASS_NAMES = 64;
+
+/// Registered pass name. A slot is published by storing index + 1 last, after the name and hash.
+struct PassName
+{
+    unsigned hash_{};
+    String name_;
+    std::atomic<unsigned> published_{};
+};
+
+/// Pass names by case-insensitive StringHash, open addressing. Kept at most half full.
+struct PassNameTable
+{
+    explicit PassNameTable(unsigned capacity) :
+        capacity_(capacity),
+        slots_(new PassName[capacity])
+    {
+    }
+
+    /// Number of slots, a power of two.
+    unsigned capacity_;
+    /// Slots.
+    std::unique_ptr<PassName[]> slots_;
+    /// The table this one replaced. Lookups that started before the replacement may still be reading it.
+    std::unique_ptr<PassNameTable> previous_;
+};
+
+/// Lookups load the current table and take no lock nor allocate, so techniques can load on worker threads. Registering a
+/// new name takes passNamesMutex, and publishes a table of twice the size when the current one is half full. Names are
+/// never removed.
+static std::unique_ptr<PassNameTable> passNameTable;
+static std::atomic<PassNameTable*> passNames{nullptr};
+static unsigned numPassNames = 0;
+static Mutex passNamesMutex;
+
+/// Return the index of a registered pass name in any case, or M_MAX_UNSIGNED. hash is its StringHash.
+static unsigned FindPassIndex(const String& name, unsigned hash)
+{
+    PassNameTable* table = passNames.load(std::memory_order_acquire);
+    if (!table)
+        return M_MAX_UNSIGNED;
+
+    for (unsigned i = 0; i < table->capacity_; ++i)
+    {
+        PassName& slot = table->slots_[(hash + i) & (table->capacity_ - 1)];
+        unsigned published = slot.published_.load(std::memory_order_acquire);
+        if (!published)
+            break;
+        if (slot.hash_ == hash && !slot.name_.Compare(name, false))
+            return published - 1;
+    }
+    return M_MAX_UNSIGNED;
+}
 
-HashMap<String, unsigned> Technique::passIndices;
+static unsigned FindPassIndex(const String& name)
+{
+    return FindPassIndex(name, StringHash(name).Value());
+}
+
+/// Store a name in the first free slot after its hash.
+static void InsertPassName(PassNameTable& table, unsigned hash, const String& name, unsigned index)
+{
+    unsigned i = hash;
+    while (table.slots_[i & (table.capacity_ - 1)].published_.load(std::memory_order_relaxed))
+        ++i;
+
+    PassName& slot = table.slots_[i & (table.capacity_ - 1)];
+    slot.hash_ = hash;
+    slot.name_ = name;
+    slot.published_.store(index + 1, std::memory_order_release);
+}
+
+/// Register a lowercase name and its StringHash with the next free index. Call with passNamesMutex held.
+static unsigned AddPassName(const String& name, unsigned hash)
+{
+    PassNameTable* table = passNameTable.get();
+    if (!table || numPassNames >= table->capacity_ / 2)
+    {
+        // Fill a larger table, then publish it; the old one stays allocated for the lookups still reading it
+        std::unique_ptr<PassNameTable> grown(new PassNameTable(table ? table->capacity_ * 2 : MIN_PASS_NAMES));
+        for (unsigned i = 0; table && i < table->capacity_; ++i)
+        {
+            PassName& slot = table->slots_[i];
+            unsigned published = slot.published_.load(std::memory_order_relaxed);
+            if (published)
+                InsertPassName(*grown, slot.hash_, slot.name_, published - 1);
+        }
+
+        grown->previous_ = std::move(passNameTable);
+        passNameTable = std::move(grown);
+        table = passNameTable.get();
+        passNames.store(table, std::memory_order_release);
+    }
+
+    unsigned index = numPassNames++;
+    InsertPassName(*table, hash, name, index);
+    return index;
+}
 
 Technique::Technique(Context* context) :
     Resource(context),
@@ -425,32 +548,32 @@ Pass* Technique::CreatePass(const String& name)
 
 void Technique::RemovePass(const String& name)
 {
-    HashMap<String, unsigned>::ConstIterator i = passIndices.Find(name.ToLower());
-    if (i == passIndices.End())
+    unsigned index = FindPassIndex(name);
+    if (index == M_MAX_UNSIGNED)
         return;
-    else if (i->second_ < passes_.Size() && passes_[i->second_].Get())
+    else if (index < passes_.Size() && passes_[index].Get())
     {
-        passes_[i->second_].Reset();
+        passes_[index].Reset();
         SetMemoryUse((unsigned)(sizeof(Technique) + GetNumPasses() * sizeof(Pass)));
     }
 }
 
 bool Technique::HasPass(const String& name) const
 {
-    HashMap<String, unsigned>::ConstIterator i = passIndices.Find(name.ToLower());
-    return i != passIndices.End() ? HasPass(i->second_) : false;
+    unsigned index = FindPassIndex(name);
+    return index != M_MAX_UNSIGNED ? HasPass(index) : false;
 }
 
 Pass* Technique::GetPass(const String& name) const
 {
-    HashMap<String, unsigned>::ConstIterator i = passIndices.Find(name.ToLower());
-    return i != passIndices.End() ? GetPass(i->second_) : nullptr;
+    unsigned index = FindPassIndex(name);
+    return index != M_MAX_UNSIGNED ? GetPass(index) : nullptr;
 }
 
 Pass* Technique::GetSupportedPass(const String& name) const
 {
-    HashMap<String, unsigned>::ConstIterator i = passIndices.Find(name.ToLower());
-    return i != passIndices.End() ? GetSupportedPass(i->second_) : nullptr;
+    unsigned index = FindPassIndex(name);
+    return index != M_MAX_UNSIGNED ? GetSupportedPass(index) : nullptr;
 }
 
 unsigned Technique::GetNumPasses() const
@@ -528,29 +651,23 @@ SharedPtr<Technique> Technique::CloneWithDefines(const String& vsDefines, const
 
 unsigned Technique::GetPassIndex(const String& passName)
 {
-    // Initialize built-in pass indices on first call
-    if (passIndices.Empty())
-    {
-        basePassIndex = passIndices["base"] = 0;
-        alphaPassIndex = passIndices["alpha"] = 1;
-        materialPassIndex = passIndices["material"] = 2;
-        deferredPassIndex = passIndices["deferred"] = 3;
-        lightPassIndex = passIndices["light"] = 4;
-        litBasePassIndex = passIndices["litbase"] = 5;
-        litAlphaPassIndex = passIndices["litalpha"] = 6;
-        shadowPassIndex = passIndices["shadow"] = 7;
-    }
+    // Case-insensitive, so it is also the hash of the lowercase name registered below
+    const unsigned hash = StringHash(passName).Value();
+    unsigned index = FindPassIndex(passName, hash);
+    if (index != M_MAX_UNSIGNED)
+        return index;
 
-    String nameLower = passName.ToLower();
-    HashMap<String, unsigned>::Iterator i = passIndices.Find(nameLower);
-    if (i != passIndices.End())
-        return i->second_;
-    else
+    MutexLock lock(passNamesMutex);
+    // Register the built-in passes on first call, with the hashes computed at compile time
+    if (!numPassNames)
     {
-        unsigned newPassIndex = passIndices.Size();
-        passIndices[nameLower] = newPassIndex;
-        return newPassIndex;
+        for (const BuiltinPassName& builtin : builtinPassNames)
+            AddPassName(builtin.name_, builtin.hash_);
     }
+
+    // Another thread may have registered the name meanwhile
+    index = FindPassIndex(passName, hash);
+    return index != M_MAX_UNSIGNED ? index : AddPassName(passName.ToLower(), hash);
 }
 
 }
@@ -0,0 +1,48 @@
+//
+// Copyright (c) 2008-2019 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Math/StringHash.h"
+
+#include <type_traits>
+
+namespace Urho3D
+{
+
+/// Lowercase an ASCII character like tolower() in the "C" locale.
+constexpr unsigned char ConstHashLower(char c)
+{
+    return (unsigned char)(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+}
+
+/// Compile-time StringHash::Calculate of a literal: case-insensitive SDBM, the same value as StringHash(str).
+constexpr unsigned ConstStringHashValue(const char* str, unsigned hash = 0)
+{
+    return *str ? ConstStringHashValue(str + 1, ConstHashLower(*str) + (hash << 6u) + (hash << 16u) - hash) : hash;
+}
+
+}
+
+/// StringHash of a string literal without hashing at runtime, e.g. URHO3D_HASH("MatDiffColor").
+#define URHO3D_HASH(literal) Urho3D::StringHash(std::integral_constant<unsigned, Urho3D::ConstStringHashValue(literal)>::value)